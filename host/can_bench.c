@@ -0,0 +1,405 @@
+// Host benchmark: runs the firmware capture pipeline on the simulated bus and
+// reports sustained throughput, losses at each stage, CPU cost per frame and
+// peak memory. Each consumer mirrors a firmware task:
+//
+//   rx        twai_receive_task      driver -> filter -> ring/monitor/stats/triggers
+//   history   can_message_task       ring -> add_can_messages
+//   stream    ws_broadcast_task      ring -> can_wire / text batches, DBC decoding
+//   client    websocket_handler      history export in 1 KB chunks, per-ID query, monitor JSON
+//
+// With -B the network bridge also runs, for can_bridge_client to connect to.
+// With -T the periodic transmitter runs and its timing is reported.
+#include "can_driver_sim.h"
+#include "can_pipeline.h"
+#include "can_ring.h"
+#include "can_format.h"
+#include "can_history.h"
+#include "can_wire.h"
+#include "can_monitor.h"
+#include "can_stats.h"
+#include "can_metrics.h"
+#include "can_dbc.h"
+#include "can_trigger.h"
+#include "can_bridge.h"
+#include "can_tx.h"
+#include "esp_timer.h"
+#include "freertos/task.h"
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <time.h>
+#include <unistd.h>
+
+#define RX_TASK_INTERVAL_MS 10
+#define HISTORY_BATCH 32
+#define HISTORY_INTERVAL_MS 10
+#define STREAM_INTERVAL_MS 30
+#define STREAM_MAX_BATCH_FRAMES 256
+#define STREAM_FRAME_TEXT_MAX 112
+#define CLIENT_INTERVAL_MS 1000
+#define MONITOR_JSON_SIZE (CAN_MONITOR_MAX_IDS * 64)
+
+static atomic_bool running = true;
+static uint64_t history_frames;
+static uint64_t history_dropped;
+static uint64_t stream_frames;
+static uint64_t stream_dropped;
+static uint64_t stream_bytes;
+static uint64_t decoded_bytes;
+static uint64_t client_requests;
+static uint64_t query_frames;
+static int64_t query_us;
+
+static void *rx_thread(void *arg) {
+    while (atomic_load(&running)) {
+        size_t frames = 0;
+        can_pipeline_drain(&can_driver_sim, RX_TASK_INTERVAL_MS, &frames);
+    }
+    return NULL;
+}
+
+static void *history_thread(void *arg) {
+    static can_frame_record_t batch[HISTORY_BATCH];
+    can_ring_cursor_t cursor;
+
+    can_ring_cursor_init(&cursor);
+    while (atomic_load(&running)) {
+        size_t count = can_ring_read(&cursor, batch, HISTORY_BATCH, NULL);
+        if (count > 0) {
+            add_can_messages(batch, count);
+        }
+        history_frames += count;
+        if (count < HISTORY_BATCH) {
+            vTaskDelay(pdMS_TO_TICKS(HISTORY_INTERVAL_MS));
+        }
+    }
+    history_dropped = cursor.dropped;
+    return NULL;
+}
+
+static void *stream_thread(void *arg) {
+    static can_frame_record_t batch[STREAM_MAX_BATCH_FRAMES];
+    static uint8_t wire[CAN_WIRE_HEADER_SIZE + STREAM_MAX_BATCH_FRAMES * CAN_WIRE_RECORD_SIZE];
+    static char text[STREAM_MAX_BATCH_FRAMES * (STREAM_FRAME_TEXT_MAX + 8)];
+    static char decoded[4096];
+    can_ring_cursor_t cursor;
+
+    can_ring_cursor_init(&cursor);
+    while (atomic_load(&running)) {
+        vTaskDelay(pdMS_TO_TICKS(STREAM_INTERVAL_MS));
+
+        // Same catch-up policy as push_to_client()
+        uint32_t lag = can_ring_head() - cursor.next_seq;
+        if (lag > STREAM_MAX_BATCH_FRAMES) {
+            cursor.next_seq += lag - STREAM_MAX_BATCH_FRAMES;
+            cursor.dropped += lag - STREAM_MAX_BATCH_FRAMES;
+        }
+
+        size_t count = can_ring_read(&cursor, batch, STREAM_MAX_BATCH_FRAMES, NULL);
+        if (count > 0) {
+            can_metrics_observe(CAN_HIST_BATCH_WAIT, esp_timer_get_time() - batch[0].timestamp_us);
+        }
+        stream_bytes += can_wire_encode_batch(wire, batch, count, 0);
+        char *p = text;
+        for (size_t i = 0; i < count; i++) {
+            p += can_format_message(p, STREAM_FRAME_TEXT_MAX, &batch[i].msg);
+            memcpy(p, "<br><br>", 8);
+            p += 8;
+        }
+        stream_bytes += p - text;
+        decoded_bytes += can_dbc_format_batch_json(batch, count, decoded, sizeof(decoded));
+        stream_frames += count;
+    }
+    stream_dropped = cursor.dropped;
+    return NULL;
+}
+
+static void *client_thread(void *arg) {
+    static char json[MONITOR_JSON_SIZE];
+    static char chunk[1024];
+
+    while (atomic_load(&running)) {
+        vTaskDelay(pdMS_TO_TICKS(CLIENT_INTERVAL_MS));
+        can_history_cursor_t history;
+        can_history_cursor_init(&history);
+        size_t n, len = 0;
+        while ((n = can_history_read(&history, "<br><br>", chunk, sizeof(chunk))) > 0) {
+            len += n;
+        }
+
+        // GET /history?id= for the identifier of the oldest frame held
+        can_frame_record_t frames[16];
+        can_history_cursor_init(&history);
+        if (can_history_read_frames(&history, frames, 1) == 1) {
+            int64_t start_us = esp_timer_get_time();
+            can_history_cursor_init_query(&history, frames[0].msg.identifier, frames[0].msg.extd, 0);
+            while ((n = can_history_read_frames(&history, frames, 16)) > 0) {
+                query_frames += n;
+            }
+            query_us += esp_timer_get_time() - start_us;
+        }
+        len += can_monitor_format_json(json, sizeof(json), esp_timer_get_time());
+        client_requests++;
+        (void)len;
+    }
+    return NULL;
+}
+
+static int64_t cpu_time_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+    return (int64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static esp_err_t load_dbc(const char *path) {
+    FILE *file = fopen(path, "r");
+    if (file == NULL) {
+        fprintf(stderr, "Cannot open %s\n", path);
+        return ESP_ERR_NOT_FOUND;
+    }
+
+    char chunk[1024];
+    size_t n;
+    esp_err_t ret = ESP_OK;
+    can_dbc_parser_t *parser = can_dbc_parser_new();
+    while (ret == ESP_OK && (n = fread(chunk, 1, sizeof(chunk), file)) > 0) {
+        ret = can_dbc_parser_feed(parser, chunk, n);
+    }
+    fclose(file);
+
+    can_dbc_table_t *table = NULL;
+    if (ret == ESP_OK) {
+        ret = can_dbc_parser_finish(parser, &table);
+    }
+    if (ret != ESP_OK) {
+        char reason[80];
+        can_dbc_parser_error(parser, reason, sizeof(reason));
+        fprintf(stderr, "%s: %s\n", path, reason);
+    } else {
+        can_dbc_install(table, false);
+    }
+    can_dbc_parser_free(parser);
+    return ret;
+}
+
+static void usage(const char *prog) {
+    fprintf(stderr,
+            "usage: %s [-r rate] [-d seconds] [-n ids] [-x ext%%] [-q rx_queue_len] [-s seed] [-f candump.log] [-b file.dbc] [-t trigger]... [-T tx]... [-B]\n"
+            "  -r  frames per second put on the simulated bus (default 2000)\n"
+            "  -d  run time in seconds (default 5)\n"
+            "  -n  distinct identifiers in the synthetic mix (default 64)\n"
+            "  -x  percentage of extended identifiers (default 10)\n"
+            "  -q  driver receive queue depth (default 32)\n"
+            "  -s  generator seed\n"
+            "  -f  replay a candump -l log in a loop instead of the synthetic mix\n"
+            "  -b  decode the stream batches with this DBC file\n"
+            "  -t  arm a capture trigger, e.g. 123#..FF,pre=100,post=100 (repeatable)\n"
+            "  -T  transmit periodically, e.g. 100#0011223344556677,period=1ms,counter=0 (repeatable)\n"
+            "  -B  serve slcan on TCP 3333 and cannelloni on UDP 20000\n",
+            prog);
+}
+
+int main(int argc, char **argv) {
+    can_sim_config_t config = CAN_SIM_CONFIG_DEFAULT();
+    unsigned duration_s = 5;
+    const char *dbc_path = NULL;
+    const char *triggers[CAN_TRIGGER_SLOTS];
+    int trigger_count = 0;
+    const char *transmits[CAN_TX_MAX_PERIODIC];
+    int transmit_count = 0;
+    bool bridge = false;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "r:d:n:x:q:s:f:b:t:T:Bh")) != -1) {
+        switch (opt) {
+        case 'r': config.rate = strtoul(optarg, NULL, 0); break;
+        case 'd': duration_s = strtoul(optarg, NULL, 0); break;
+        case 'n': config.id_count = strtoul(optarg, NULL, 0); break;
+        case 'x': config.ext_percent = strtoul(optarg, NULL, 0); break;
+        case 'q': config.rx_queue_len = strtoul(optarg, NULL, 0); break;
+        case 's': config.seed = strtoul(optarg, NULL, 0); break;
+        case 'f': config.replay_path = optarg; break;
+        case 'b': dbc_path = optarg; break;
+        case 'B': bridge = true; break;
+        case 't':
+            if (trigger_count == CAN_TRIGGER_SLOTS) {
+                fprintf(stderr, "At most %d triggers\n", CAN_TRIGGER_SLOTS);
+                return 2;
+            }
+            triggers[trigger_count++] = optarg;
+            break;
+        case 'T':
+            if (transmit_count == CAN_TX_MAX_PERIODIC) {
+                fprintf(stderr, "At most %d periodic messages\n", CAN_TX_MAX_PERIODIC);
+                return 2;
+            }
+            transmits[transmit_count++] = optarg;
+            break;
+        default:
+            usage(argv[0]);
+            return opt == 'h' ? 0 : 2;
+        }
+    }
+
+    if (can_sim_configure(&config) != ESP_OK || can_history_init() != ESP_OK) {
+        return 1;
+    }
+    can_dbc_init();
+    if (dbc_path != NULL && load_dbc(dbc_path) != ESP_OK) {
+        return 1;
+    }
+
+    for (int i = 0; i < trigger_count; i++) {
+        can_trigger_config_t trigger;
+        int slot;
+        esp_err_t err = can_trigger_parse(triggers[i], &trigger);
+        if (err == ESP_OK) {
+            err = can_trigger_arm(&trigger, &slot);
+        }
+        if (err != ESP_OK) {
+            fprintf(stderr, "%s: %s\n", triggers[i], esp_err_to_name(err));
+            return 1;
+        }
+    }
+
+    twai_filter_config_t f_config = TWAI_FILTER_CONFIG_ACCEPT_ALL();
+    if (can_driver_sim.start(&f_config) != ESP_OK) {
+        fprintf(stderr, "Failed to start simulated driver\n");
+        return 1;
+    }
+
+    can_bridge_config_t bridge_config = CAN_BRIDGE_CONFIG_DEFAULT();
+    if (bridge && can_bridge_start(&bridge_config, &can_driver_sim) != ESP_OK) {
+        return 1;
+    }
+
+    can_tx_init(&can_driver_sim);
+    for (int i = 0; i < transmit_count; i++) {
+        can_tx_config_t tx;
+        int slot;
+        esp_err_t err = can_tx_parse(transmits[i], &tx);
+        if (err == ESP_OK) {
+            err = can_tx_request(&tx, &slot);
+        }
+        if (err != ESP_OK) {
+            fprintf(stderr, "%s: %s\n", transmits[i], esp_err_to_name(err));
+            return 1;
+        }
+    }
+
+    pthread_t threads[4];
+    void *(*bodies[4])(void *) = { rx_thread, history_thread, stream_thread, client_thread };
+    int64_t cpu_start = cpu_time_ns();
+    int64_t wall_start = esp_timer_get_time();
+    for (int i = 0; i < 4; i++) {
+        pthread_create(&threads[i], NULL, bodies[i], NULL);
+    }
+
+    sleep(duration_s);
+
+    // Rates are taken here; the consumers may take a while to notice the stop
+    int64_t wall_us = esp_timer_get_time() - wall_start;
+    int64_t cpu_ns = cpu_time_ns() - cpu_start;
+    uint64_t generated = can_sim_generated();
+    uint64_t received = can_stats_total_frames();
+    uint32_t bus_load = can_stats_bus_load_x100(esp_timer_get_time());
+    twai_status_info_t status;
+    can_driver_sim.get_status(&status);
+    can_tx_config_t tx_configs[CAN_TX_MAX_PERIODIC];
+    can_tx_stats_t tx_stats[CAN_TX_MAX_PERIODIC];
+    bool tx_active[CAN_TX_MAX_PERIODIC];
+    for (int i = 0; i < CAN_TX_MAX_PERIODIC; i++) {
+        tx_active[i] = can_tx_get(i, &tx_configs[i], &tx_stats[i]);
+    }
+    can_tx_stop_all();
+
+    atomic_store(&running, false);
+    for (int i = 0; i < 4; i++) {
+        pthread_join(threads[i], NULL);
+    }
+    can_driver_sim.stop();
+
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+
+    double seconds = wall_us / 1e6;
+
+    printf("source            %s\n", config.replay_path ? config.replay_path : "synthetic");
+    printf("duration_s        %.2f\n", seconds);
+    printf("offered_fps       %.0f\n", generated / seconds);
+    printf("sustained_fps     %.0f\n", received / seconds);
+    printf("generated         %llu\n", (unsigned long long)generated);
+    printf("received          %llu\n", (unsigned long long)received);
+    printf("driver_dropped    %lu\n", (unsigned long)status.rx_missed_count);
+    printf("filtered          %lu\n", (unsigned long)can_pipeline_filtered_count());
+    printf("history_frames    %llu\n", (unsigned long long)history_frames);
+    printf("history_dropped   %llu\n", (unsigned long long)history_dropped);
+    printf("stream_frames     %llu\n", (unsigned long long)stream_frames);
+    printf("stream_dropped    %llu\n", (unsigned long long)stream_dropped);
+    printf("stream_bytes      %llu\n", (unsigned long long)stream_bytes);
+    printf("decoded_bytes     %llu\n", (unsigned long long)decoded_bytes);
+    printf("client_requests   %llu\n", (unsigned long long)client_requests);
+    can_history_usage_t history;
+    can_history_get_usage(&history);
+    printf("history_held      %lu frames in %lu/%lu bytes, %.2f bytes/frame, %lu ids\n",
+           (unsigned long)history.frames, (unsigned long)history.bytes, (unsigned long)history.capacity,
+           history.frames ? (double)history.bytes / history.frames : 0.0, (unsigned long)history.identifiers);
+    // Against the previous store, 100-byte text lines in the same RAM
+    printf("history_ram       %lu bytes with index, dictionary and reference frames, %.2f bytes/frame, %.1fx the text store\n",
+           (unsigned long)history.ram, history.frames ? (double)history.ram / history.frames : 0.0,
+           history.ram ? history.frames * 100.0 / history.ram : 0.0);
+    printf("history_query     %.1f frames in %.0fus per request\n",
+           client_requests ? (double)query_frames / client_requests : 0.0,
+           client_requests ? (double)query_us / client_requests : 0.0);
+    printf("monitor_overflow  %lu\n", (unsigned long)can_monitor_overflow_count());
+    printf("bus_load_pct      %.2f\n", bus_load / 100.0);
+    printf("cpu_ns_per_frame  %.0f\n", received ? (double)cpu_ns / received : 0.0);
+    printf("max_rss_kb        %ld\n", usage.ru_maxrss);
+    if (bridge) {
+        printf("bridge_frames     %lu\n", (unsigned long)can_metrics_counter(CAN_METRIC_BRIDGE_FRAMES));
+        printf("bridge_datagrams  %lu\n", (unsigned long)can_metrics_counter(CAN_METRIC_BRIDGE_DATAGRAMS));
+        printf("bridge_dropped    %lu\n", (unsigned long)can_metrics_counter(CAN_METRIC_BRIDGE_DROPPED));
+        printf("bridge_tx         %lu\n", (unsigned long)can_metrics_counter(CAN_METRIC_BRIDGE_TX));
+        printf("bus_transmitted   %llu\n", (unsigned long long)can_sim_transmitted());
+    }
+
+    static const char *trigger_states[] = { "free", "armed", "capturing", "done" };
+    for (int i = 0; i < CAN_TRIGGER_SLOTS; i++) {
+        can_trigger_info_t info;
+        char condition[CAN_TRIGGER_TEXT_MAX];
+        if (!can_trigger_get(i, &info)) {
+            continue;
+        }
+        can_trigger_format(&info.config, condition, sizeof(condition));
+        printf("trigger_%d         %s %s frames=%lu at=%lu\n", i, condition, trigger_states[info.state],
+               (unsigned long)info.frames, (unsigned long)info.trigger_index);
+    }
+
+    for (int i = 0; i < CAN_TX_MAX_PERIODIC; i++) {
+        char spec[CAN_TX_TEXT_MAX];
+        if (!tx_active[i]) {
+            continue;
+        }
+        can_tx_format(&tx_configs[i], spec, sizeof(spec));
+        printf("tx_%-14d %s sent=%lu errors=%lu period=%lu..%luus jitter avg=%luus max=%luus\n", i, spec,
+               (unsigned long)tx_stats[i].sent, (unsigned long)tx_stats[i].errors,
+               (unsigned long)tx_stats[i].period_min_us, (unsigned long)tx_stats[i].period_max_us,
+               (unsigned long)tx_stats[i].jitter_avg_us, (unsigned long)tx_stats[i].jitter_max_us);
+    }
+
+    for (int i = 0; i < CAN_HIST_COUNT; i++) {
+        can_hist_snapshot_t snap;
+        can_metrics_snapshot(i, &snap);
+        if (snap.count == 0) {
+            continue;
+        }
+        printf("%-17s p50<=%luus p99<=%luus mean=%.1fus\n", can_metrics_hist_name(i),
+               (unsigned long)can_metrics_quantile_us(&snap, 500), (unsigned long)can_metrics_quantile_us(&snap, 990),
+               (double)snap.sum_us / snap.count);
+    }
+    return 0;
+}
\ No newline at end of file
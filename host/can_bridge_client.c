@@ -0,0 +1,249 @@
+// Stand-in for the PC side of the network bridge: talks slcan over TCP the
+// way slcand does and cannelloni over UDP the way the cannelloni tool does,
+// checks every line and packet it receives, optionally transmits frames, and
+// reports what arrived. Runs against the firmware or against can_bench -B.
+#include "can_slcan.h"
+#include "can_cannelloni.h"
+#include "esp_timer.h"
+#include <arpa/inet.h>
+#include <errno.h>
+#include <netinet/in.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+#define UDP_PACKET_MAX 1500
+#define TX_FRAME_ID 0x7A0
+
+typedef struct {
+    uint64_t frames;
+    uint64_t bytes;
+    uint64_t packets;           // Datagrams, or replies for slcan
+    uint64_t errors;            // Malformed lines or packets
+    uint64_t seq_gaps;          // Missing cannelloni sequence numbers
+    uint64_t tx;
+} transport_stats_t;
+
+static const char *address = "127.0.0.1";
+static uint16_t slcan_port = 3333;
+static uint16_t cannelloni_port = 20000;
+static unsigned tx_rate;
+static atomic_bool running = true;
+static transport_stats_t slcan_stats;
+static transport_stats_t udp_stats;
+
+static struct sockaddr_in server_addr(uint16_t port) {
+    struct sockaddr_in addr = {
+        .sin_family = AF_INET,
+        .sin_port = htons(port),
+    };
+    inet_pton(AF_INET, address, &addr.sin_addr);
+    return addr;
+}
+
+static void set_timeout(int fd, int ms) {
+    struct timeval tv = { .tv_sec = ms / 1000, .tv_usec = (ms % 1000) * 1000 };
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+}
+
+// Frames due since start at tx_rate per second
+static uint64_t tx_due(int64_t start_us) {
+    return (uint64_t)(esp_timer_get_time() - start_us) * tx_rate / 1000000;
+}
+
+static twai_message_t tx_frame(uint64_t n) {
+    twai_message_t msg = { .identifier = TX_FRAME_ID, .data_length_code = 8 };
+    memcpy(msg.data, &n, sizeof(n));
+    return msg;
+}
+
+static void slcan_line(const char *line, size_t len) {
+    can_slcan_request_t req;
+    if (len == 0 || line[0] == 'z' || line[0] == 'Z') {
+        slcan_stats.packets++;
+    } else if (can_slcan_parse(line, len, &req) == ESP_OK && req.command == CAN_SLCAN_FRAME) {
+        slcan_stats.frames++;
+    } else {
+        slcan_stats.errors++;
+    }
+}
+
+static void *slcan_thread(void *arg) {
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    struct sockaddr_in addr = server_addr(slcan_port);
+    if (connect(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0) {
+        fprintf(stderr, "slcan: cannot connect to %s:%u: %s\n", address, slcan_port, strerror(errno));
+        close(fd);
+        return NULL;
+    }
+    set_timeout(fd, 10);
+
+    // slcand's start sequence: flush, bit rate, open
+    const char *init = "\r\r\rS6\rO\r";
+    send(fd, init, strlen(init), 0);
+
+    char in[4096];
+    char line[CAN_SLCAN_LINE_MAX];
+    size_t line_len = 0;
+    int64_t start_us = esp_timer_get_time();
+    while (atomic_load(&running)) {
+        ssize_t n = recv(fd, in, sizeof(in), 0);
+        if (n == 0) {
+            fprintf(stderr, "slcan: connection closed\n");
+            break;
+        }
+        for (ssize_t i = 0; i < n; i++) {
+            if (in[i] == '\r') {
+                slcan_line(line, line_len);
+                line_len = 0;
+            } else if (in[i] == '\a') {
+                slcan_stats.errors++;
+            } else if (line_len < sizeof(line) - 1) {
+                line[line_len++] = in[i];
+            }
+        }
+        if (n > 0) {
+            slcan_stats.bytes += n;
+        }
+
+        for (uint64_t due = tx_due(start_us); slcan_stats.tx < due; slcan_stats.tx++) {
+            twai_message_t msg = tx_frame(slcan_stats.tx);
+            char text[CAN_SLCAN_LINE_MAX];
+            size_t len = can_slcan_encode(text, &msg, -1);
+            send(fd, text, len, 0);
+        }
+    }
+    close(fd);
+    return NULL;
+}
+
+static void udp_frame(const twai_message_t *msg, void *ctx) {
+    udp_stats.frames++;
+}
+
+static void *udp_thread(void *arg) {
+    int fd = socket(AF_INET, SOCK_DGRAM, 0);
+    struct sockaddr_in addr = server_addr(cannelloni_port);
+    set_timeout(fd, 10);
+
+    uint8_t packet[UDP_PACKET_MAX];
+    can_cannelloni_packet_t out;
+    uint8_t tx_seq = 0;
+    int expected_seq = -1;
+    int64_t start_us = esp_timer_get_time();
+    int64_t last_hello_us = 0;
+
+    while (atomic_load(&running)) {
+        // An empty packet registers this socket as the bridge's peer
+        int64_t now_us = esp_timer_get_time();
+        if (now_us - last_hello_us > 1000000) {
+            can_cannelloni_begin(&out, packet, sizeof(packet), tx_seq++);
+            size_t len = can_cannelloni_end(&out);
+            sendto(fd, packet, len, 0, (struct sockaddr *)&addr, sizeof(addr));
+            last_hello_us = now_us;
+        }
+
+        ssize_t n = recv(fd, packet, sizeof(packet), 0);
+        if (n > 0) {
+            udp_stats.packets++;
+            udp_stats.bytes += n;
+            if (n >= CAN_CANNELLONI_HEADER_SIZE) {
+                if (expected_seq >= 0 && packet[2] != expected_seq) {
+                    udp_stats.seq_gaps += (uint8_t)(packet[2] - expected_seq);
+                }
+                expected_seq = (uint8_t)(packet[2] + 1);
+            }
+            if (can_cannelloni_parse(packet, n, udp_frame, NULL) != ESP_OK) {
+                udp_stats.errors++;
+            }
+        }
+
+        uint64_t due = tx_due(start_us);
+        if (udp_stats.tx < due) {
+            can_cannelloni_begin(&out, packet, sizeof(packet), tx_seq++);
+            while (udp_stats.tx < due) {
+                twai_message_t msg = tx_frame(udp_stats.tx);
+                if (can_cannelloni_add(&out, &msg) != ESP_OK) {
+                    break;
+                }
+                udp_stats.tx++;
+            }
+            size_t len = can_cannelloni_end(&out);
+            sendto(fd, packet, len, 0, (struct sockaddr *)&addr, sizeof(addr));
+        }
+    }
+    close(fd);
+    return NULL;
+}
+
+static void report(const char *name, const transport_stats_t *s, double seconds) {
+    printf("%-10s frames=%llu fps=%.0f bytes=%llu packets=%llu errors=%llu seq_gaps=%llu tx=%llu",
+           name, (unsigned long long)s->frames, s->frames / seconds, (unsigned long long)s->bytes,
+           (unsigned long long)s->packets, (unsigned long long)s->errors, (unsigned long long)s->seq_gaps,
+           (unsigned long long)s->tx);
+    if (s == &udp_stats && s->packets > 0) {
+        printf(" frames_per_packet=%.1f", (double)s->frames / s->packets);
+    }
+    printf("\n");
+}
+
+static void usage(const char *prog) {
+    fprintf(stderr,
+            "usage: %s [-a address] [-p slcan_port] [-u cannelloni_port] [-d seconds] [-t tx_fps]\n"
+            "  -a  bridge address (default 127.0.0.1; 192.168.4.1 for the board)\n"
+            "  -p  slcan TCP port, 0 to skip (default 3333)\n"
+            "  -u  cannelloni UDP port, 0 to skip (default 20000)\n"
+            "  -d  run time in seconds (default 5)\n"
+            "  -t  frames per second to transmit on each transport (default 0)\n",
+            prog);
+}
+
+int main(int argc, char **argv) {
+    unsigned duration_s = 5;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "a:p:u:d:t:h")) != -1) {
+        switch (opt) {
+        case 'a': address = optarg; break;
+        case 'p': slcan_port = strtoul(optarg, NULL, 0); break;
+        case 'u': cannelloni_port = strtoul(optarg, NULL, 0); break;
+        case 'd': duration_s = strtoul(optarg, NULL, 0); break;
+        case 't': tx_rate = strtoul(optarg, NULL, 0); break;
+        default:
+            usage(argv[0]);
+            return opt == 'h' ? 0 : 2;
+        }
+    }
+
+    pthread_t threads[2];
+    bool started[2] = { slcan_port != 0, cannelloni_port != 0 };
+    int64_t start_us = esp_timer_get_time();
+    if (started[0]) {
+        pthread_create(&threads[0], NULL, slcan_thread, NULL);
+    }
+    if (started[1]) {
+        pthread_create(&threads[1], NULL, udp_thread, NULL);
+    }
+    sleep(duration_s);
+    atomic_store(&running, false);
+    double seconds = (esp_timer_get_time() - start_us) / 1e6;
+    for (int i = 0; i < 2; i++) {
+        if (started[i]) {
+            pthread_join(threads[i], NULL);
+        }
+    }
+
+    if (started[0]) {
+        report("slcan", &slcan_stats, seconds);
+    }
+    if (started[1]) {
+        report("cannelloni", &udp_stats, seconds);
+    }
+    return 0;
+}
\ No newline at end of file
@@ -0,0 +1,491 @@
+// Host checks: focused tests of the firmware modules that encode, decode or
+// parse (history, log export, DBC decoding, trigger, TX and slcan parsers),
+// run by ctest. Each check prints the cases that fail; the exit status is
+// the number of failures.
+#include "can_history.h"
+#include "can_log.h"
+#include "can_dbc.h"
+#include "can_trigger.h"
+#include "can_tx.h"
+#include "can_slcan.h"
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define CHECK(cond)                                                         \
+    do {                                                                    \
+        if (!(cond)) {                                                      \
+            printf("%s:%d: %s failed\n", __func__, __LINE__, #cond);        \
+            failures++;                                                     \
+        }                                                                   \
+    } while (0)
+
+#define HISTORY_FRAMES 20000
+
+static int failures;
+
+// Frames that exercise every record form: dictionary and literal
+// identifiers, DLC changes, remote frames, long and short gaps in time and
+// gaps in the sequence numbers.
+static void make_history_input(can_frame_record_t *in, size_t count) {
+    int64_t t = 1000;
+    uint32_t seq = 100;
+
+    srand(3);
+    for (size_t i = 0; i < count; i++) {
+        can_frame_record_t *r = &in[i];
+        memset(r, 0, sizeof(*r));
+        int k = rand() % 200;
+        r->msg.identifier = k < 100 ? k * 7 : 0x18da0000 + k;
+        r->msg.extd = k >= 100;
+        r->msg.rtr = rand() % 50 == 0;
+        r->msg.data_length_code = k % 9 == 0 ? rand() % 9 : 8;
+        for (int j = 0; j < r->msg.data_length_code && !r->msg.rtr; j++) {
+            r->msg.data[j] = rand();
+        }
+        t += rand() % 7 == 0 ? rand() % 3000000 : rand() % 400;
+        if (rand() % 1000 == 0) {
+            seq += 5;
+        }
+        r->timestamp_us = t;
+        r->seq = seq++;
+    }
+}
+
+// Periodic traffic as a vehicle bus carries it: 64 identifiers every 10 to
+// 100 ms, mostly 8 data bytes, each payload a rolling counter, a checksum,
+// a slowly moving 16-bit signal, a flag that comes and goes and constant
+// bytes.
+static void make_bus_input(can_frame_record_t *in, size_t count) {
+    static const int periods_ms[] = { 10, 20, 50, 100 };
+    int64_t next_us[64];
+    uint8_t counter[64] = { 0 };
+
+    srand(5);
+    for (int id = 0; id < 64; id++) {
+        next_us[id] = rand() % 10000;
+    }
+    for (size_t i = 0; i < count; i++) {
+        int id = 0;
+        for (int j = 1; j < 64; j++) {
+            if (next_us[j] < next_us[id]) {
+                id = j;
+            }
+        }
+        can_frame_record_t *r = &in[i];
+        memset(r, 0, sizeof(*r));
+        r->msg.extd = id >= 48;
+        r->msg.identifier = r->msg.extd ? 0x18fe0000 + id * 0x100 : 0x100 + id * 8;
+        r->msg.data_length_code = id % 8 == 0 ? 4 : id % 5 == 0 ? 6 : 8;
+        r->timestamp_us = next_us[id];
+        r->seq = i;
+        next_us[id] += periods_ms[id % 4] * 1000 + rand() % 200;
+
+        uint8_t *d = r->msg.data;
+        uint16_t signal = 1000 + id * 50 + (r->timestamp_us / 100000) % 40;
+        d[0] = (id << 4) | (counter[id]++ & 0x0f);
+        d[1] = signal;
+        d[2] = signal >> 8;
+        d[3] = (counter[id] & 0x30) == 0x30 ? 0x41 : 0x40;     // A status flag now and then
+        for (int j = 4; j < r->msg.data_length_code - 1; j++) {
+            d[j] = id + j;
+        }
+        d[r->msg.data_length_code - 1] = 0;
+        for (int j = 0; j < r->msg.data_length_code - 1; j++) {
+            d[r->msg.data_length_code - 1] ^= d[j];
+        }
+    }
+}
+
+static bool same_frame(const can_frame_record_t *in, const can_frame_record_t *out) {
+    // Timestamps come back rounded down to the history tick
+    return in->seq == out->seq && out->timestamp_us <= in->timestamp_us &&
+           in->timestamp_us - out->timestamp_us < CAN_HISTORY_TICK_US &&
+           memcmp(&in->msg, &out->msg, sizeof(twai_message_t)) == 0;
+}
+
+static void check_history(void) {
+    static can_frame_record_t in[HISTORY_FRAMES];
+    can_frame_record_t out[64];
+    can_history_cursor_t cursor;
+    can_history_usage_t usage;
+    size_t n;
+
+    make_history_input(in, HISTORY_FRAMES);
+    CHECK(can_history_init() == ESP_OK);
+    for (size_t i = 0; i < HISTORY_FRAMES; i += 13) {
+        add_can_messages(&in[i], i + 13 <= HISTORY_FRAMES ? 13 : HISTORY_FRAMES - i);
+    }
+    can_history_get_usage(&usage);
+    CHECK(usage.frames > 0 && usage.bytes <= usage.capacity);
+    CHECK(usage.ram <= CONFIG_CAN_HISTORY_SIZE_KB * 1024);
+
+    // Whole history: the newest usage.frames frames, in order
+    size_t first = HISTORY_FRAMES - usage.frames;
+    size_t k = first;
+    can_history_cursor_init(&cursor);
+    while ((n = can_history_read_frames(&cursor, out, 64)) > 0) {
+        for (size_t i = 0; i < n && k < HISTORY_FRAMES; i++, k++) {
+            CHECK(same_frame(&in[k], &out[i]));
+        }
+    }
+    CHECK(k == HISTORY_FRAMES);
+
+    // Per-identifier queries from a sequence number on, including an
+    // identifier that was never seen
+    const uint32_t ids[] = { 7 * 5, 0x18da0000 + 150, 0x123 };
+    const bool extd[] = { false, true, false };
+    uint32_t since = in[first + 300].seq;
+    for (int q = 0; q < 3; q++) {
+        size_t want = 0, got = 0;
+        for (size_t i = first; i < HISTORY_FRAMES; i++) {
+            want += (int32_t)(in[i].seq - since) >= 0 && in[i].msg.identifier == ids[q] && in[i].msg.extd == extd[q];
+        }
+        can_history_cursor_init_query(&cursor, ids[q], extd[q], since);
+        while ((n = can_history_read_frames(&cursor, out, 3)) > 0) {
+            for (size_t i = 0; i < n; i++) {
+                CHECK(out[i].msg.identifier == ids[q] && (int32_t)(out[i].seq - since) >= 0);
+            }
+            got += n;
+        }
+        CHECK(got == want);
+    }
+
+    // Text export: one line per frame
+    char text[1024];
+    size_t lines = 0, len;
+    can_history_cursor_init(&cursor);
+    while ((len = can_history_read(&cursor, "\n", text, sizeof(text))) > 0) {
+        for (size_t i = 0; i < len; i++) {
+            lines += text[i] == '\n';
+        }
+    }
+    CHECK(lines == usage.frames);
+}
+
+// The history replaced a store of 100 frames as text in 10 KB and has to
+// hold at least ten times as many of a realistic mix in the same RAM, also
+// right after dropping its oldest block. Exports run meanwhile, as the
+// encoder then has to rebuild its state. Runs first, while the dictionary
+// is empty.
+static void check_history_capacity(void) {
+    static can_frame_record_t in[HISTORY_FRAMES];
+    can_frame_record_t out[64];
+    can_history_cursor_t cursor;
+    can_history_usage_t usage;
+    uint32_t fewest = UINT32_MAX;
+    size_t n;
+
+    make_bus_input(in, HISTORY_FRAMES);
+    CHECK(can_history_init() == ESP_OK);
+    for (size_t i = 0; i < HISTORY_FRAMES; i += 32) {
+        add_can_messages(&in[i], 32);
+        can_history_get_usage(&usage);
+        if (i >= HISTORY_FRAMES / 4 && usage.frames < fewest) {
+            fewest = usage.frames;
+        }
+        if (i % 256 == 0) {
+            can_history_cursor_init(&cursor);
+            can_history_read_frames(&cursor, out, 64);
+        }
+    }
+    CHECK(CONFIG_CAN_HISTORY_SIZE_KB == 10 && usage.ram <= 10 * 1024);
+    CHECK(fewest >= 10 * 100);
+
+    size_t k = HISTORY_FRAMES - usage.frames;
+    can_history_cursor_init(&cursor);
+    while ((n = can_history_read_frames(&cursor, out, 64)) > 0) {
+        for (size_t i = 0; i < n && k < HISTORY_FRAMES; i++, k++) {
+            CHECK(same_frame(&in[k], &out[i]));
+        }
+    }
+    CHECK(k == HISTORY_FRAMES);
+}
+
+// Intel and Motorola byte order, signed values, scale and offset, simple
+// multiplexing and an extended identifier
+static const char dbc_text[] =
+    "VERSION \"\"\n"
+    "\n"
+    "BO_ 256 ENGINE: 8 ECU\n"
+    " SG_ RPM : 0|16@1+ (0.25,0) [0|16383.75] \"rpm\" ECU\n"
+    " SG_ TORQUE : 16|12@1- (0.5,0) [-1024|1023.5] \"Nm\" ECU\n"
+    " SG_ SPEED : 39|16@0+ (0.01,0) [0|655.35] \"km/h\" ECU\n"
+    " SG_ TEMP : 55|8@0- (1,-40) [-168|87] \"degC\" ECU\n"
+    "\n"
+    "BO_ 512 DIAG: 8 ECU\n"
+    " SG_ MODE M : 0|8@1+ (1,0) [0|255] \"\" ECU\n"
+    " SG_ LEVEL m1 : 8|8@1+ (1,0) [0|255] \"%\" ECU\n"
+    " SG_ OFFSET m2 : 8|16@1- (1,0) [-32768|32767] \"mV\" ECU\n"
+    "\n"
+    "BO_ 2566845184 EXT: 8 ECU\n"
+    " SG_ VALUE : 0|8@1+ (1,0) [0|255] \"\" ECU\n";
+
+static void dbc_frame(can_frame_record_t *r, uint32_t id, bool extd, const uint8_t data[8]) {
+    memset(r, 0, sizeof(*r));
+    r->msg.identifier = id;
+    r->msg.extd = extd;
+    r->msg.data_length_code = 8;
+    memcpy(r->msg.data, data, 8);
+}
+
+typedef struct {
+    char data[CAN_LOG_PAGE_SIZE];
+    size_t len;
+    int pieces;
+    int empty_pieces;
+} export_sink_t;
+
+static esp_err_t export_send(void *ctx, const char *data, size_t len) {
+    export_sink_t *sink = ctx;
+    sink->pieces++;
+    if (len == 0) {
+        sink->empty_pieces++;
+    }
+    if (sink->len + len <= sizeof(sink->data)) {
+        memcpy(sink->data + sink->len, data, len);
+        sink->len += len;
+    }
+    return ESP_OK;
+}
+
+static void export_segment(FILE *f, can_log_format_t format, export_sink_t *sink) {
+    memset(sink, 0, sizeof(*sink));
+    rewind(f);
+    CHECK(can_log_export(f, format, export_send, sink) == ESP_OK);
+    CHECK(sink->empty_pieces == 0);
+    sink->data[sink->len < sizeof(sink->data) ? sink->len : sizeof(sink->data) - 1] = '\0';
+}
+
+// A page as the writer lays it out: TIME marker, frames, PAD to the end.
+// Every format must produce records, and no piece may be empty since an
+// empty chunk ends the HTTP response.
+static void check_log_export(void) {
+    uint8_t page[CAN_LOG_PAGE_SIZE] = { 0 };
+    uint8_t *r = page;
+    int64_t start_us = 1500000;
+    r[0] = CAN_LOG_MARKER_TIME;
+    memcpy(r + 8, &start_us, sizeof(start_us));
+    r += CAN_LOG_RECORD_SIZE;
+    r[0] = 2;                                   // DLC 2, delta 250 us, 0x123
+    r[1] = 250;
+    r[4] = 0x23;
+    r[5] = 0x01;
+    r[8] = 0xde;
+    r[9] = 0xad;
+    r += CAN_LOG_RECORD_SIZE;
+    r[0] = CAN_LOG_KIND_EXTD | CAN_LOG_KIND_RTR;  // Remote, 0x18DAF110
+    r[4] = 0x10;
+    r[5] = 0xf1;
+    r[6] = 0xda;
+    r[7] = 0x18;
+    for (r += CAN_LOG_RECORD_SIZE; r < page + sizeof(page); r += CAN_LOG_RECORD_SIZE) {
+        r[0] = CAN_LOG_MARKER_PAD;
+    }
+
+    FILE *f = tmpfile();
+    CHECK(f != NULL);
+    if (f == NULL) {
+        return;
+    }
+    fwrite(page, 1, sizeof(page), f);
+
+    static export_sink_t sink;
+    export_segment(f, CAN_LOG_FORMAT_BINARY, &sink);
+    CHECK(sink.len == sizeof(page) && memcmp(sink.data, page, sizeof(page)) == 0);
+
+    export_segment(f, CAN_LOG_FORMAT_CANDUMP, &sink);
+    CHECK(strcmp(sink.data, "(1.500250) can0 123#DEAD\n"
+                            "(1.500250) can0 18DAF110#R\n") == 0);
+
+    export_segment(f, CAN_LOG_FORMAT_ASC, &sink);
+    CHECK(strncmp(sink.data, can_log_text_header(CAN_LOG_FORMAT_ASC), strlen(can_log_text_header(CAN_LOG_FORMAT_ASC))) == 0);
+    CHECK(strstr(sink.data, "123") != NULL && strstr(sink.data, "18DAF110x") != NULL);
+    fclose(f);
+}
+
+static void check_dbc_decoded(const can_frame_record_t *r, const char *expected) {
+    char json[512];
+    size_t len = can_dbc_format_batch_json(r, 1, json, sizeof(json));
+    if (len == 0 || strcmp(json, expected) != 0) {
+        printf("%s: got %s\n    expected %s\n", __func__, len ? json : "nothing", expected);
+        failures++;
+    }
+}
+
+static void check_dbc(void) {
+    can_dbc_table_t *table = NULL;
+    can_frame_record_t r;
+
+    // No table saved on the host
+    CHECK(can_dbc_init() == ESP_ERR_NOT_FOUND);
+    can_dbc_parser_t *parser = can_dbc_parser_new();
+    // Fed in small pieces, as an upload arrives
+    for (size_t off = 0; off < sizeof(dbc_text) - 1; off += 7) {
+        size_t n = sizeof(dbc_text) - 1 - off < 7 ? sizeof(dbc_text) - 1 - off : 7;
+        CHECK(can_dbc_parser_feed(parser, dbc_text + off, n) == ESP_OK);
+    }
+    CHECK(can_dbc_parser_finish(parser, &table) == ESP_OK);
+    can_dbc_parser_free(parser);
+    CHECK(table != NULL && can_dbc_install(table, false) == ESP_OK);
+
+    size_t messages = 0, signals = 0, bytes;
+    CHECK(can_dbc_info(&messages, &signals, &bytes) && messages == 3 && signals == 8);
+
+    // RPM 8000 * 0.25, TORQUE -100 * 0.5 in 12 bits, SPEED 10000 * 0.01
+    // big-endian from byte 4, TEMP -10 - 40 big-endian in byte 6
+    dbc_frame(&r, 0x100, false, (const uint8_t[8]){ 0x40, 0x1f, 0x9c, 0x0f, 0x27, 0x10, 0xf6, 0x00 });
+    check_dbc_decoded(&r, "[[\"ENGINE\",\"RPM\",2000,\"rpm\"],[\"ENGINE\",\"TORQUE\",-50,\"Nm\"],"
+                          "[\"ENGINE\",\"SPEED\",100,\"km/h\"],[\"ENGINE\",\"TEMP\",-50,\"degC\"]]");
+    dbc_frame(&r, 0x100, false, (const uint8_t[8]){ 0x01, 0x00, 0xff, 0x07, 0x00, 0x7b, 0x7f, 0x00 });
+    check_dbc_decoded(&r, "[[\"ENGINE\",\"RPM\",0.25,\"rpm\"],[\"ENGINE\",\"TORQUE\",1023.5,\"Nm\"],"
+                          "[\"ENGINE\",\"SPEED\",1.23,\"km/h\"],[\"ENGINE\",\"TEMP\",87,\"degC\"]]");
+
+    // Only the signals of the active multiplexer value
+    dbc_frame(&r, 0x200, false, (const uint8_t[8]){ 0x01, 0x2a });
+    check_dbc_decoded(&r, "[[\"DIAG\",\"MODE\",1,\"\"],[\"DIAG\",\"LEVEL\",42,\"%\"]]");
+    dbc_frame(&r, 0x200, false, (const uint8_t[8]){ 0x02, 0x38, 0xff });
+    check_dbc_decoded(&r, "[[\"DIAG\",\"MODE\",2,\"\"],[\"DIAG\",\"OFFSET\",-200,\"mV\"]]");
+
+    // The extended message does not match the same standard identifier
+    dbc_frame(&r, 0x18fef300, true, (const uint8_t[8]){ 0x05 });
+    check_dbc_decoded(&r, "[[\"EXT\",\"VALUE\",5,\"\"]]");
+    dbc_frame(&r, 0x300, false, (const uint8_t[8]){ 0x05 });
+    CHECK(can_dbc_format_batch_json(&r, 1, (char[64]){ 0 }, 64) == 0);
+
+    // Errors carry the line number
+    char reason[64];
+    parser = can_dbc_parser_new();
+    can_dbc_parser_feed(parser, "BO_ 256 A: 8 ECU\n SG_ X : 0|99@1+ (1,0) [0|0] \"\" ECU\n", 55);
+    CHECK(can_dbc_parser_finish(parser, &table) != ESP_OK);
+    can_dbc_parser_error(parser, reason, sizeof(reason));
+    CHECK(strncmp(reason, "line 2:", 7) == 0);
+    can_dbc_parser_free(parser);
+
+    // A factor finer than the kept decimals is an error, not a zero
+    static const char *too_fine = "BO_ 256 A: 8 ECU\n SG_ X : 0|8@1+ (0.0000000001,0) [0|0] \"\" ECU\n";
+    parser = can_dbc_parser_new();
+    can_dbc_parser_feed(parser, too_fine, strlen(too_fine));
+    CHECK(can_dbc_parser_finish(parser, &table) != ESP_OK);
+    can_dbc_parser_error(parser, reason, sizeof(reason));
+    CHECK(strncmp(reason, "line 2:", 7) == 0);
+    can_dbc_parser_free(parser);
+
+    // 1/65536 keeps nine decimals: 65535 * 0.000015259
+    static const char *fine = "BO_ 1024 FINE: 8 ECU\n SG_ F : 0|16@1+ (0.0000152587890625,0) [0|1] \"\" ECU\n";
+    parser = can_dbc_parser_new();
+    can_dbc_parser_feed(parser, fine, strlen(fine));
+    CHECK(can_dbc_parser_finish(parser, &table) == ESP_OK);
+    can_dbc_parser_free(parser);
+    CHECK(table != NULL && can_dbc_install(table, false) == ESP_OK);
+    dbc_frame(&r, 0x400, false, (const uint8_t[8]){ 0xff, 0xff });
+    check_dbc_decoded(&r, "[[\"FINE\",\"F\",0.999998565,\"\"]]");
+    can_dbc_install(NULL, false);
+}
+
+static void check_trigger_parser(void) {
+    can_trigger_config_t config, again;
+    char text[CAN_TRIGGER_TEXT_MAX];
+
+    CHECK(can_trigger_parse("7E8#..41,pre=10,post=20", &config) == ESP_OK);
+    CHECK(config.kind == CAN_TRIGGER_MATCH && config.id == 0x7e8 && config.id_mask == 0x7ff && !config.extd);
+    CHECK(config.data_mask[0] == 0x00 && config.data_mask[1] == 0xff && config.data[1] == 0x41);
+    CHECK(config.pre == 10 && config.post == 20);
+
+    CHECK(can_trigger_parse("18DAF100/1FFFFF00x#4.", &config) == ESP_OK);
+    CHECK(config.extd && config.id == 0x18daf100 && config.id_mask == 0x1fffff00);
+    CHECK(config.data_mask[0] == 0xf0 && config.data[0] == 0x40);
+    CHECK(config.pre == 100 && config.post == 100);
+
+    CHECK(can_trigger_parse("123,absent=500", &config) == ESP_OK);
+    CHECK(config.kind == CAN_TRIGGER_ABSENT && config.absent_ms == 500);
+
+    // Formatting gives back text that parses to the same trigger
+    CHECK(can_trigger_parse("18DAF100/1FFFFF00x#4.,pre=5,post=7", &config) == ESP_OK);
+    CHECK(can_trigger_format(&config, text, sizeof(text)) > 0);
+    CHECK(can_trigger_parse(text, &again) == ESP_OK && memcmp(&config, &again, sizeof(config)) == 0);
+
+    CHECK(can_trigger_parse("", &config) != ESP_OK);
+    CHECK(can_trigger_parse("800", &config) == ESP_OK && config.extd);
+    CHECK(can_trigger_parse("20000000", &config) != ESP_OK);
+    CHECK(can_trigger_parse("123#GG", &config) != ESP_OK);
+    CHECK(can_trigger_parse("123,bogus=1", &config) != ESP_OK);
+}
+
+static void check_tx_parser(void) {
+    can_tx_config_t config, again;
+    char text[CAN_TX_TEXT_MAX];
+
+    CHECK(can_tx_parse("123#0011223344556677", &config) == ESP_OK);
+    CHECK(config.msg.identifier == 0x123 && !config.msg.extd && config.msg.data_length_code == 8);
+    CHECK(config.msg.data[7] == 0x77 && config.period_us == 0);
+    CHECK(config.counter_byte == -1 && config.checksum_byte == -1);
+
+    CHECK(can_tx_parse("18DAF110x#0102,period=500us,counter=1/0f,checksum=0/crc8", &config) == ESP_OK);
+    CHECK(config.msg.extd && config.msg.identifier == 0x18daf110 && config.msg.data_length_code == 2);
+    CHECK(config.period_us == 500 && config.counter_byte == 1 && config.counter_mask == 0x0f);
+    CHECK(config.checksum_byte == 0 && config.checksum == CAN_TX_CHECKSUM_CRC8);
+
+    CHECK(can_tx_parse("7DF#R,period=10", &config) == ESP_OK);
+    CHECK(config.msg.rtr && config.period_us == 10000);
+
+    // Formatting gives back text that parses to the same entry
+    CHECK(can_tx_parse("123#00112233,period=20ms,counter=3,checksum=2/xor", &config) == ESP_OK);
+    CHECK(can_tx_format(&config, text, sizeof(text)) > 0);
+    CHECK(can_tx_parse(text, &again) == ESP_OK && memcmp(&config, &again, sizeof(config)) == 0);
+
+    CHECK(can_tx_parse("123#001", &config) != ESP_OK);
+    CHECK(can_tx_parse("800#00", &config) == ESP_OK && config.msg.extd);
+    CHECK(can_tx_parse("20000000#00", &config) != ESP_OK);
+
+    // Periods below CAN_TX_MIN_PERIOD_US parse, the table refuses them
+    int slot;
+    CHECK(can_tx_parse("123#00,period=100us", &config) == ESP_OK);
+    CHECK(can_tx_request(&config, &slot) == ESP_ERR_INVALID_ARG);
+    CHECK(can_tx_parse("123#00,counter=1", &config) != ESP_OK);
+}
+
+static void check_slcan_parser(void) {
+    can_slcan_request_t req;
+    char line[CAN_SLCAN_LINE_MAX];
+
+#define SLCAN_PARSE(text) can_slcan_parse(text, strlen(text), &req)
+    CHECK(SLCAN_PARSE("t1232AABB") == ESP_OK && req.command == CAN_SLCAN_FRAME);
+    CHECK(req.msg.identifier == 0x123 && !req.msg.extd && !req.msg.rtr && req.msg.data_length_code == 2);
+    CHECK(req.msg.data[0] == 0xaa && req.msg.data[1] == 0xbb);
+    CHECK(SLCAN_PARSE("T18DAF1101FF") == ESP_OK && req.msg.extd && req.msg.identifier == 0x18daf110);
+    CHECK(SLCAN_PARSE("r7DF8") == ESP_OK && req.msg.rtr && req.msg.data_length_code == 8);
+    CHECK(SLCAN_PARSE("S6") == ESP_OK && req.command == CAN_SLCAN_BITRATE && req.arg == 6);
+    CHECK(SLCAN_PARSE("O") == ESP_OK && req.command == CAN_SLCAN_OPEN);
+    CHECK(SLCAN_PARSE("C") == ESP_OK && req.command == CAN_SLCAN_CLOSE);
+    CHECK(SLCAN_PARSE("") == ESP_OK && req.command == CAN_SLCAN_NOP);
+
+    CHECK(SLCAN_PARSE("t12") != ESP_OK);
+    CHECK(SLCAN_PARSE("t8000") != ESP_OK);
+    CHECK(SLCAN_PARSE("t1232AA") != ESP_OK);
+    CHECK(SLCAN_PARSE("t1239") != ESP_OK);
+    CHECK(SLCAN_PARSE("X") != ESP_OK);
+
+    // Encoded lines parse back to the same frame, with or without timestamp
+    twai_message_t msg = { .identifier = 0x18daf110, .extd = 1, .data_length_code = 3, .data = { 1, 2, 3 } };
+    size_t len = can_slcan_encode(line, &msg, -1);
+    CHECK(len > 0 && line[len - 1] == '\r');
+    CHECK(can_slcan_parse(line, len - 1, &req) == ESP_OK && memcmp(&req.msg, &msg, sizeof(msg)) == 0);
+    len = can_slcan_encode(line, &msg, 1234);
+    CHECK(len > 4 && memcmp(line + len - 5, "04D2\r", 5) == 0);
+    CHECK(can_slcan_bitrate_code(500000) == 6 && can_slcan_bitrate_code(123) == -1);
+#undef SLCAN_PARSE
+}
+
+int main(void) {
+    check_history_capacity();
+    check_history();
+    check_log_export();
+    check_dbc();
+    check_trigger_parser();
+    check_tx_parser();
+    check_slcan_parser();
+    printf("%s: %d failures\n", failures ? "FAILED" : "ok", failures);
+    return failures;
+}
\ No newline at end of file
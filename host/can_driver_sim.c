@@ -0,0 +1,261 @@
+#include "can_driver_sim.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define TAG "CAN_SIM"
+#define SIM_TICK_US 100
+#define SIM_REPLAY_LINE_MAX 128
+
+static can_sim_config_t config = CAN_SIM_CONFIG_DEFAULT();
+static twai_message_t *frames;      // Identifier mix or replayed log
+static size_t frame_count;
+
+static pthread_mutex_t queue_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t queue_cond = PTHREAD_COND_INITIALIZER;
+static twai_message_t *queue;
+static size_t queue_head;
+static size_t queue_len;
+static uint32_t rx_missed;
+
+static pthread_t generator;
+static atomic_bool running;
+static atomic_uint_least64_t generated;
+static atomic_uint_least64_t transmitted;
+
+static uint32_t xorshift32(uint32_t *state) {
+    uint32_t x = *state;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    *state = x;
+    return x;
+}
+
+static esp_err_t build_mix(void) {
+    uint32_t rng = config.seed ? config.seed : 1;
+    uint32_t count = config.id_count ? config.id_count : 1;
+
+    frames = calloc(count, sizeof(twai_message_t));
+    if (frames == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    for (uint32_t i = 0; i < count; i++) {
+        twai_message_t *f = &frames[i];
+        f->extd = (xorshift32(&rng) % 100) < config.ext_percent;
+        f->identifier = f->extd ? xorshift32(&rng) & TWAI_EXTD_ID_MASK
+                                : (0x100 + i * 7) & TWAI_STD_ID_MASK;
+        f->data_length_code = 8;
+    }
+    frame_count = count;
+    return ESP_OK;
+}
+
+// Parses "(sec.usec) iface ID#DATA" lines as written by candump -l.
+static esp_err_t load_replay(const char *path) {
+    FILE *file = fopen(path, "r");
+    if (file == NULL) {
+        ESP_LOGE(TAG, "Cannot open %s", path);
+        return ESP_ERR_NOT_FOUND;
+    }
+
+    size_t capacity = 0;
+    char line[SIM_REPLAY_LINE_MAX];
+    while (fgets(line, sizeof(line), file) != NULL) {
+        char id_text[16];
+        char data_text[32] = "";
+        if (sscanf(line, "(%*[^)]) %*s %15[0-9A-Fa-f]#%31s", id_text, data_text) < 1) {
+            continue;
+        }
+        if (frame_count == capacity) {
+            capacity = capacity ? capacity * 2 : 256;
+            twai_message_t *grown = realloc(frames, capacity * sizeof(twai_message_t));
+            if (grown == NULL) {
+                fclose(file);
+                return ESP_ERR_NO_MEM;
+            }
+            frames = grown;
+        }
+
+        twai_message_t *f = &frames[frame_count++];
+        memset(f, 0, sizeof(twai_message_t));
+        f->identifier = strtoul(id_text, NULL, 16);
+        f->extd = strlen(id_text) > 3;
+        if (data_text[0] == 'R') {
+            f->rtr = 1;
+            continue;
+        }
+        for (size_t i = 0; i < TWAI_FRAME_MAX_DLC && data_text[i * 2] && data_text[i * 2 + 1]; i++) {
+            char byte[3] = { data_text[i * 2], data_text[i * 2 + 1], 0 };
+            f->data[i] = strtoul(byte, NULL, 16);
+            f->data_length_code++;
+        }
+    }
+    fclose(file);
+
+    if (frame_count == 0) {
+        ESP_LOGE(TAG, "No frames in %s", path);
+        return ESP_ERR_INVALID_ARG;
+    }
+    return ESP_OK;
+}
+
+esp_err_t can_sim_configure(const can_sim_config_t *new_config) {
+    free(frames);
+    frames = NULL;
+    frame_count = 0;
+    config = *new_config;
+    if (config.rx_queue_len == 0) {
+        config.rx_queue_len = 1;
+    }
+    return config.replay_path ? load_replay(config.replay_path) : build_mix();
+}
+
+static void enqueue(const twai_message_t *msg) {
+    pthread_mutex_lock(&queue_lock);
+    if (queue_len == config.rx_queue_len) {
+        rx_missed++;
+    } else {
+        queue[(queue_head + queue_len) % config.rx_queue_len] = *msg;
+        queue_len++;
+        pthread_cond_signal(&queue_cond);
+    }
+    pthread_mutex_unlock(&queue_lock);
+}
+
+static void *generator_thread(void *arg) {
+    uint32_t rng = config.seed ? config.seed : 1;
+    uint64_t sent = 0;
+    size_t next = 0;
+    int64_t start_us = esp_timer_get_time();
+    struct timespec tick = { .tv_sec = 0, .tv_nsec = SIM_TICK_US * 1000 };
+
+    while (atomic_load(&running)) {
+        uint64_t due = (uint64_t)(esp_timer_get_time() - start_us) * config.rate / 1000000;
+        for (; sent < due; sent++) {
+            twai_message_t msg;
+            if (config.replay_path) {
+                msg = frames[next];
+                next = (next + 1) % frame_count;
+            } else {
+                msg = frames[xorshift32(&rng) % frame_count];
+                uint32_t payload = xorshift32(&rng);
+                memcpy(&msg.data[0], &sent, 4);
+                memcpy(&msg.data[4], &payload, 4);
+            }
+            enqueue(&msg);
+            atomic_fetch_add(&generated, 1);
+        }
+        nanosleep(&tick, NULL);
+    }
+    return NULL;
+}
+
+static esp_err_t sim_start(const twai_filter_config_t *filter) {
+    (void)filter;   // Acceptance filtering is left to the software filter
+    if (frames == NULL && can_sim_configure(&config) != ESP_OK) {
+        return ESP_FAIL;
+    }
+
+    queue = calloc(config.rx_queue_len, sizeof(twai_message_t));
+    if (queue == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    queue_head = 0;
+    queue_len = 0;
+    atomic_store(&running, true);
+    if (pthread_create(&generator, NULL, generator_thread, NULL) != 0) {
+        atomic_store(&running, false);
+        free(queue);
+        queue = NULL;
+        return ESP_FAIL;
+    }
+    return ESP_OK;
+}
+
+static esp_err_t sim_stop(void) {
+    if (!atomic_exchange(&running, false)) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    pthread_join(generator, NULL);
+
+    pthread_mutex_lock(&queue_lock);
+    free(queue);
+    queue = NULL;
+    queue_len = 0;
+    pthread_cond_broadcast(&queue_cond);
+    pthread_mutex_unlock(&queue_lock);
+    return ESP_OK;
+}
+
+static esp_err_t sim_receive(twai_message_t *msg, uint32_t timeout_ms) {
+    esp_err_t ret = ESP_ERR_TIMEOUT;
+
+    pthread_mutex_lock(&queue_lock);
+    if (queue_len == 0 && timeout_ms > 0) {
+        struct timespec deadline;
+        clock_gettime(CLOCK_REALTIME, &deadline);
+        deadline.tv_sec += timeout_ms / 1000;
+        deadline.tv_nsec += (long)(timeout_ms % 1000) * 1000000;
+        if (deadline.tv_nsec >= 1000000000) {
+            deadline.tv_sec++;
+            deadline.tv_nsec -= 1000000000;
+        }
+        while (queue_len == 0 && atomic_load(&running)) {
+            if (pthread_cond_timedwait(&queue_cond, &queue_lock, &deadline) != 0) {
+                break;
+            }
+        }
+    }
+    if (queue_len > 0) {
+        *msg = queue[queue_head];
+        queue_head = (queue_head + 1) % config.rx_queue_len;
+        queue_len--;
+        ret = ESP_OK;
+    } else if (!atomic_load(&running)) {
+        ret = ESP_ERR_INVALID_STATE;
+    }
+    pthread_mutex_unlock(&queue_lock);
+    return ret;
+}
+
+static esp_err_t sim_transmit(const twai_message_t *msg, uint32_t timeout_ms) {
+    if (!atomic_load(&running)) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    atomic_fetch_add(&transmitted, 1);
+    return ESP_OK;
+}
+
+static esp_err_t sim_get_status(twai_status_info_t *status) {
+    memset(status, 0, sizeof(twai_status_info_t));
+    pthread_mutex_lock(&queue_lock);
+    status->state = atomic_load(&running) ? TWAI_STATE_RUNNING : TWAI_STATE_STOPPED;
+    status->msgs_to_rx = queue_len;
+    status->rx_missed_count = rx_missed;
+    pthread_mutex_unlock(&queue_lock);
+    return ESP_OK;
+}
+
+uint64_t can_sim_generated(void) {
+    return atomic_load(&generated);
+}
+
+uint64_t can_sim_transmitted(void) {
+    return atomic_load(&transmitted);
+}
+
+const can_driver_t can_driver_sim = {
+    .name = "sim",
+    .start = sim_start,
+    .stop = sim_stop,
+    .receive = sim_receive,
+    .transmit = sim_transmit,
+    .get_status = sim_get_status,
+};
\ No newline at end of file
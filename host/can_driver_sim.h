@@ -0,0 +1,35 @@
+// can_driver_sim.h
+#ifndef CAN_DRIVER_SIM_H
+#define CAN_DRIVER_SIM_H
+
+#include <stdint.h>
+#include "esp_err.h"
+#include "can_driver.h"
+
+// Simulated bus for the host build. A generator thread produces frames at a
+// fixed rate into a bounded receive queue, like the TWAI ISR feeding the
+// driver queue; frames that find the queue full are counted as missed.
+typedef struct {
+    uint32_t rate;              // Frames per second
+    uint32_t id_count;          // Distinct identifiers in the synthetic mix
+    uint32_t ext_percent;       // Share of those identifiers that are extended
+    uint32_t rx_queue_len;      // Depth of the receive queue
+    uint32_t seed;
+    const char *replay_path;    // candump log replayed in a loop instead of the synthetic mix
+} can_sim_config_t;
+
+#define CAN_SIM_CONFIG_DEFAULT() { \
+    .rate = 2000, .id_count = 64, .ext_percent = 10, .rx_queue_len = 32, .seed = 1, .replay_path = NULL }
+
+// Must be called before start(). Loads the replay file if one is given.
+esp_err_t can_sim_configure(const can_sim_config_t *config);
+
+// Frames the generator has put on the bus since start().
+uint64_t can_sim_generated(void);
+
+// Frames accepted by transmit().
+uint64_t can_sim_transmitted(void);
+
+extern const can_driver_t can_driver_sim;
+
+#endif // CAN_DRIVER_SIM_H
\ No newline at end of file
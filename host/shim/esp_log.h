@@ -0,0 +1,13 @@
+// esp_log.h - host build stand-in. Info and debug output is compiled out so
+// the benchmark measures the pipeline rather than the terminal.
+#ifndef HOST_ESP_LOG_H
+#define HOST_ESP_LOG_H
+
+#include <stdio.h>
+
+#define ESP_LOGE(tag, format, ...) fprintf(stderr, "E (%s) " format "\n", tag, ##__VA_ARGS__)
+#define ESP_LOGW(tag, format, ...) fprintf(stderr, "W (%s) " format "\n", tag, ##__VA_ARGS__)
+#define ESP_LOGI(tag, format, ...) do { } while (0)
+#define ESP_LOGD(tag, format, ...) do { } while (0)
+
+#endif // HOST_ESP_LOG_H
\ No newline at end of file
@@ -0,0 +1,9 @@
+// esp_system.h - host build stand-in
+#ifndef HOST_ESP_SYSTEM_H
+#define HOST_ESP_SYSTEM_H
+
+#include "esp_err.h"
+
+void esp_restart(void) __attribute__((noreturn));
+
+#endif // HOST_ESP_SYSTEM_H
\ No newline at end of file
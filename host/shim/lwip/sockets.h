@@ -0,0 +1,11 @@
+// sockets.h - host build stand-in: lwIP's BSD socket API is the system one.
+#ifndef HOST_LWIP_SOCKETS_H
+#define HOST_LWIP_SOCKETS_H
+
+#include <sys/socket.h>
+#include <sys/select.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+
+#endif // HOST_LWIP_SOCKETS_H
\ No newline at end of file
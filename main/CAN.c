@@ -1,103 +1,240 @@
 #include "CAN.h"
+#include "can_driver.h"
+#include "can_pipeline.h"
+#include "can_filter.h"
+#include "can_metrics.h"
 #include "esp_log.h"
 #include "esp_system.h"
-#include "esp_timer.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include "freertos/semphr.h"
+#include "freertos/queue.h"
 #include <stdio.h>
 #include <string.h>
 
 #define TAG "TWAI_EXAMPLE"
 #define RX_TASK_INTERVAL_MS 10
-#define BUFFER_SIZE 100
+#define RX_ERROR_BACKOFF_MS 100
 
-static char latest_message[BUFFER_SIZE];
-static SemaphoreHandle_t twai_mutex;
+static const can_driver_t *driver = &can_driver_twai;
+static can_filter_rule_t filter_rules[CAN_FILTER_MAX_RULES];
+static size_t filter_rule_count;
+static portMUX_TYPE filter_lock = portMUX_INITIALIZER_UNLOCKED;
 
-static esp_err_t init_twai(void) {
-    twai_general_config_t g_config = TWAI_GENERAL_CONFIG_DEFAULT(GPIO_NUM_18, GPIO_NUM_19, TWAI_MODE_NORMAL);
-    twai_timing_config_t t_config = TWAI_TIMING_CONFIG_500KBITS();
-    twai_filter_config_t f_config = TWAI_FILTER_CONFIG_ACCEPT_ALL();
+// Filter and trigger changes are handed to the receive task, which applies
+// them between two drains, so the pipeline and the driver have one user.
+typedef enum {
+    CAN_REQUEST_FILTERS,
+    CAN_REQUEST_ARM_TRIGGER,
+    CAN_REQUEST_CLEAR_TRIGGER,
+} can_request_kind_t;
 
-    esp_err_t result = twai_driver_install(&g_config, &t_config, &f_config);
-    if (result != ESP_OK) {
-        ESP_LOGE(TAG, "Failed to install TWAI driver: %s", esp_err_to_name(result));
-        return result;
+typedef struct {
+    can_request_kind_t kind;
+    const can_filter_rule_t *rules;
+    size_t count;
+    const can_trigger_config_t *trigger;
+    int slot;
+    esp_err_t result;
+} can_request_t;
+
+// Other tasks reach the driver through can_tx_driver, which refuses calls
+// while the receive task has the controller uninstalled.
+static portMUX_TYPE driver_lock = portMUX_INITIALIZER_UNLOCKED;
+static bool driver_down;
+static int driver_users;
+
+static QueueHandle_t request_queue;
+static SemaphoreHandle_t request_done;
+static SemaphoreHandle_t request_mutex;     // One request in flight
+
+static void apply_filter_rules(void) {
+    static can_filter_compiled_t compiled;
+    can_filter_compile(filter_rules, filter_rule_count, &compiled);
+    can_pipeline_set_filter(&compiled);
+}
+
+static esp_err_t apply_filters(const can_filter_rule_t *rules, size_t count) {
+    twai_filter_config_t f_config;
+    can_filter_hw_config(rules, count, &f_config);
+
+    taskENTER_CRITICAL(&filter_lock);
+    memcpy(filter_rules, rules, count * sizeof(can_filter_rule_t));
+    filter_rule_count = count;
+    taskEXIT_CRITICAL(&filter_lock);
+    apply_filter_rules();
+
+    // The acceptance filter can only change while the driver is uninstalled,
+    // so close the driver to senders and wait for those inside to leave.
+    taskENTER_CRITICAL(&driver_lock);
+    driver_down = true;
+    taskEXIT_CRITICAL(&driver_lock);
+    while (1) {
+        taskENTER_CRITICAL(&driver_lock);
+        int users = driver_users;
+        taskEXIT_CRITICAL(&driver_lock);
+        if (users == 0) {
+            break;
+        }
+        vTaskDelay(1);
     }
 
-    result = twai_start();
-    if (result != ESP_OK) {
-        ESP_LOGE(TAG, "Failed to start TWAI driver: %s", esp_err_to_name(result));
-        return result;
+    driver->stop();
+    esp_err_t result = driver->start(&f_config);
+    taskENTER_CRITICAL(&driver_lock);
+    driver_down = result != ESP_OK;
+    taskEXIT_CRITICAL(&driver_lock);
+    return result;
+}
+
+static bool driver_enter(void) {
+    taskENTER_CRITICAL(&driver_lock);
+    bool up = !driver_down;
+    if (up) {
+        driver_users++;
     }
+    taskEXIT_CRITICAL(&driver_lock);
+    return up;
+}
 
-    ESP_LOGI(TAG, "TWAI driver installed and started successfully");
-    return ESP_OK;
+static void driver_leave(void) {
+    taskENTER_CRITICAL(&driver_lock);
+    driver_users--;
+    taskEXIT_CRITICAL(&driver_lock);
 }
 
-static void twai_receive_task(void *arg) {
-    twai_message_t rx_message;
+static esp_err_t tx_driver_transmit(const twai_message_t *msg, uint32_t timeout_ms) {
+    if (!driver_enter()) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    esp_err_t result = driver->transmit(msg, timeout_ms);
+    driver_leave();
+    return result;
+}
+
+static esp_err_t tx_driver_get_status(twai_status_info_t *status) {
+    if (!driver_enter()) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    esp_err_t result = driver->get_status(status);
+    driver_leave();
+    return result;
+}
+
+static const can_driver_t can_tx_driver = {
+    .name = "twai-shared",
+    .transmit = tx_driver_transmit,
+    .get_status = tx_driver_get_status,
+};
 
+static void handle_request(can_request_t *req) {
+    switch (req->kind) {
+    case CAN_REQUEST_FILTERS:
+        req->result = apply_filters(req->rules, req->count);
+        break;
+    case CAN_REQUEST_ARM_TRIGGER:
+        req->result = can_trigger_arm(req->trigger, &req->slot);
+        break;
+    case CAN_REQUEST_CLEAR_TRIGGER:
+        req->result = can_trigger_clear(req->slot);
+        break;
+    }
+}
+
+// Blocks for at most one drain interval
+static esp_err_t run_in_receive_task(can_request_t *req) {
+    xSemaphoreTake(request_mutex, portMAX_DELAY);
+    xQueueSend(request_queue, &req, portMAX_DELAY);
+    xSemaphoreTake(request_done, portMAX_DELAY);
+    xSemaphoreGive(request_mutex);
+    return req->result;
+}
+
+static void twai_receive_task(void *arg) {
     while (1) {
-        esp_err_t result = twai_receive(&rx_message, pdMS_TO_TICKS(RX_TASK_INTERVAL_MS));
-        if (result == ESP_OK) {
-            xSemaphoreTake(twai_mutex, portMAX_DELAY);
-            snprintf(latest_message, BUFFER_SIZE, "ID: 0x%lx, DLC: %d, Data: 0x%02x 0x%02x 0x%02x 0x%02x 0x%02x 0x%02x 0x%02x 0x%02x",
-                     rx_message.identifier,
-                     rx_message.data_length_code,
-                     rx_message.data[0], rx_message.data[1], rx_message.data[2], rx_message.data[3],
-                     rx_message.data[4], rx_message.data[5], rx_message.data[6], rx_message.data[7]);
-            xSemaphoreGive(twai_mutex);
-            ESP_LOGI(TAG, "Message received - %s", latest_message);
-        } else if (result != ESP_ERR_TIMEOUT) {
-            ESP_LOGE(TAG, "Failed to receive message: %s", esp_err_to_name(result));
+        size_t frames = 0;
+        can_request_t *req;
+
+        while (xQueueReceive(request_queue, &req, 0) == pdTRUE) {
+            handle_request(req);
+            xSemaphoreGive(request_done);
         }
 
-        vTaskDelay(pdMS_TO_TICKS(RX_TASK_INTERVAL_MS));
+        esp_err_t result = can_pipeline_drain(driver, RX_TASK_INTERVAL_MS, &frames);
+        if (result != ESP_ERR_TIMEOUT) {
+            can_metrics_add(CAN_METRIC_RX_ERRORS, 1);
+            ESP_LOGE(TAG, "Failed to receive message: %s", esp_err_to_name(result));
+            vTaskDelay(pdMS_TO_TICKS(RX_ERROR_BACKOFF_MS));
+        }
     }
 }
 
-void init_can(void) {
-    twai_mutex = xSemaphoreCreateMutex();
-    if (twai_mutex == NULL) {
-        ESP_LOGE(TAG, "Failed to create TWAI mutex");
-        esp_restart();
+esp_err_t can_set_filters(const can_filter_rule_t *rules, size_t count, bool persist) {
+    if (count > CAN_FILTER_MAX_RULES) {
+        return ESP_ERR_INVALID_SIZE;
     }
 
-    if (init_twai() != ESP_OK) {
-        ESP_LOGE(TAG, "Failed to initialize TWAI. Restarting...");
-        esp_restart();
+    can_request_t req = { .kind = CAN_REQUEST_FILTERS, .rules = rules, .count = count };
+    esp_err_t result = run_in_receive_task(&req);
+    if (result == ESP_OK && persist) {
+        result = can_filter_save(rules, count);
+        if (result != ESP_OK) {
+            ESP_LOGE(TAG, "Failed to save filters: %s", esp_err_to_name(result));
+        }
     }
+    return result;
 }
 
-void start_can_tasks(void) {
-    xTaskCreate(twai_receive_task, "twai_receive_task", 4096, NULL, 5, NULL);
+size_t can_get_filters(can_filter_rule_t *rules) {
+    taskENTER_CRITICAL(&filter_lock);
+    size_t count = filter_rule_count;
+    memcpy(rules, filter_rules, count * sizeof(can_filter_rule_t));
+    taskEXIT_CRITICAL(&filter_lock);
+    return count;
 }
 
-const char* get_latest_can_message(void) {
-    static char message_copy[BUFFER_SIZE];
-    xSemaphoreTake(twai_mutex, portMAX_DELAY);
-    strncpy(message_copy, latest_message, BUFFER_SIZE);
-    xSemaphoreGive(twai_mutex);
-    return message_copy;
+esp_err_t can_arm_trigger(const can_trigger_config_t *config, int *slot) {
+    can_request_t req = { .kind = CAN_REQUEST_ARM_TRIGGER, .trigger = config };
+    esp_err_t result = run_in_receive_task(&req);
+    *slot = req.slot;
+    return result;
 }
 
-esp_err_t send_can_message_id_199(void) {
-    twai_message_t message;
-    message.identifier = 0x199;
-    message.extd = 0;
-    message.rtr = 0;
-    message.data_length_code = 8;
-    for (int i = 0; i < 8; i++) {
-        message.data[i] = i;  // Puedes cambiar esto por los datos que quieras enviar
+esp_err_t can_clear_trigger(int slot) {
+    can_request_t req = { .kind = CAN_REQUEST_CLEAR_TRIGGER, .slot = slot };
+    return run_in_receive_task(&req);
+}
+
+const can_driver_t *can_get_tx_driver(void) {
+    return &can_tx_driver;
+}
+
+esp_err_t can_get_status(twai_status_info_t *status) {
+    return can_tx_driver.get_status(status);
+}
+
+void init_can(void) {
+    request_queue = xQueueCreate(1, sizeof(can_request_t *));
+    request_done = xSemaphoreCreateBinary();
+    request_mutex = xSemaphoreCreateMutex();
+    if (request_queue == NULL || request_done == NULL || request_mutex == NULL) {
+        ESP_LOGE(TAG, "Failed to create CAN request queue");
+        esp_restart();
     }
 
-    esp_err_t result = twai_transmit(&message, pdMS_TO_TICKS(1000));
-    if (result != ESP_OK) {
-        ESP_LOGE(TAG, "Failed to send message: %s", esp_err_to_name(result));
-    } else {
-        ESP_LOGI(TAG, "Message sent successfully");
+    if (can_filter_load(filter_rules, &filter_rule_count) != ESP_OK) {
+        filter_rule_count = 0;
     }
-    return result;
+    apply_filter_rules();
+
+    twai_filter_config_t f_config;
+    can_filter_hw_config(filter_rules, filter_rule_count, &f_config);
+    if (driver->start(&f_config) != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to initialize TWAI. Restarting...");
+        esp_restart();
+    }
+}
+
+void start_can_tasks(void) {
+    xTaskCreate(twai_receive_task, "twai_receive_task", 4096, NULL, 5, NULL);
 }
\ No newline at end of file
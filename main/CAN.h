@@ -3,14 +3,41 @@
 #define CAN_H
 
 #include <stdint.h>
+#include <stddef.h>
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include "driver/twai.h"
+#include "can_filter.h"
+#include "can_trigger.h"
+#include "can_driver.h"
+
+// Nominal bit rate configured by can_driver_twai
+#define CAN_BUS_BITRATE 500000
 
 void init_can(void);
 void start_can_tasks(void);
-const char* get_latest_can_message(void);
 
-esp_err_t send_can_message_id_199(void);
+// Replaces the acceptance filter list. The best hardware filter is derived
+// from it and the driver is restarted by the receive task between two
+// drains; the rest is enforced in software before frames reach the ring.
+// With persist the list is saved to NVS.
+esp_err_t can_set_filters(const can_filter_rule_t *rules, size_t count, bool persist);
+
+// Copies the active filter list (up to CAN_FILTER_MAX_RULES) and returns its
+// length. Does not wait for the receive task.
+size_t can_get_filters(can_filter_rule_t *rules);
+
+// Arms a capture trigger, or clears a slot, in step with the receive task.
+esp_err_t can_arm_trigger(const can_trigger_config_t *config, int *slot);
+esp_err_t can_clear_trigger(int slot);
+
+// Controller for modules that transmit on their own: only transmit and
+// get_status are set. Both return ESP_ERR_INVALID_STATE while the receive
+// task restarts the driver.
+const can_driver_t *can_get_tx_driver(void);
+
+// Controller state and error counters. ESP_ERR_INVALID_STATE while the
+// driver is restarted.
+esp_err_t can_get_status(twai_status_info_t *status);
 
 #endif // CAN_H
\ No newline at end of file
@@ -0,0 +1,364 @@
+#include "can_bridge.h"
+#include "can_ring.h"
+#include "can_slcan.h"
+#include "can_cannelloni.h"
+#include "can_metrics.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "lwip/sockets.h"
+#include <errno.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#define TAG "CAN_BRIDGE"
+#define BRIDGE_BATCH 64
+#define SLCAN_OUT_SIZE 2048     // Room for about 90 frame lines
+#define SLCAN_IN_SIZE 256
+#define UDP_PAYLOAD_MAX 1400    // Below the 1472 bytes a 1500 byte MTU allows
+#define UDP_IN_SIZE 1500
+
+static can_bridge_config_t config;
+static const can_driver_t *driver;
+static can_ring_cursor_t cursor;
+static can_frame_record_t batch[BRIDGE_BATCH];
+
+// TCP slcan client
+static int listen_fd = -1;
+static int client_fd = -1;
+static bool slcan_open;
+static bool slcan_listen_only;
+static bool slcan_timestamps;
+static char slcan_line[CAN_SLCAN_LINE_MAX];
+static size_t slcan_line_len;
+static bool slcan_line_overflow;
+static char slcan_out[SLCAN_OUT_SIZE];
+static size_t slcan_out_len;
+
+// UDP cannelloni peer
+static int udp_fd = -1;
+static struct sockaddr_in udp_peer;
+static bool udp_peer_known;
+static uint8_t udp_out[UDP_PAYLOAD_MAX];
+static can_cannelloni_packet_t udp_packet;
+static uint8_t udp_seq;
+static uint8_t udp_in[UDP_IN_SIZE];
+
+static int open_socket(int type, uint16_t port) {
+    int fd = socket(AF_INET, type, type == SOCK_STREAM ? IPPROTO_TCP : IPPROTO_UDP);
+    if (fd < 0) {
+        return -1;
+    }
+    int one = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+
+    struct sockaddr_in addr = {
+        .sin_family = AF_INET,
+        .sin_port = htons(port),
+        .sin_addr.s_addr = htonl(INADDR_ANY),
+    };
+    if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0 ||
+        (type == SOCK_STREAM && listen(fd, 1) != 0)) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+static void close_client(void) {
+    if (client_fd >= 0) {
+        close(client_fd);
+        client_fd = -1;
+    }
+    slcan_open = false;
+    slcan_out_len = 0;
+}
+
+// Sends what the socket takes without blocking; the rest waits for the next round.
+static void slcan_flush(void) {
+    if (client_fd < 0 || slcan_out_len == 0) {
+        return;
+    }
+    ssize_t n = send(client_fd, slcan_out, slcan_out_len, MSG_DONTWAIT);
+    if (n < 0) {
+        if (errno != EAGAIN && errno != EWOULDBLOCK) {
+            ESP_LOGW(TAG, "slcan client lost: errno %d", errno);
+            close_client();
+        }
+        return;
+    }
+    memmove(slcan_out, slcan_out + n, slcan_out_len - n);
+    slcan_out_len -= n;
+}
+
+static void slcan_reply(const char *text) {
+    size_t len = strlen(text);
+    if (slcan_out_len + len <= SLCAN_OUT_SIZE) {
+        memcpy(slcan_out + slcan_out_len, text, len);
+        slcan_out_len += len;
+    }
+}
+
+static esp_err_t transmit(const twai_message_t *msg) {
+    esp_err_t err = driver->transmit(msg, 0);
+    can_metrics_add(err == ESP_OK ? CAN_METRIC_BRIDGE_TX : CAN_METRIC_BRIDGE_TX_ERRORS, 1);
+    return err;
+}
+
+static void slcan_command(const char *line, size_t len) {
+    can_slcan_request_t req;
+    char reply[16];
+
+    if (can_slcan_parse(line, len, &req) != ESP_OK) {
+        slcan_reply(CAN_SLCAN_ERROR);
+        return;
+    }
+    switch (req.command) {
+    case CAN_SLCAN_FRAME:
+        if (!slcan_open || slcan_listen_only || transmit(&req.msg) != ESP_OK) {
+            slcan_reply(CAN_SLCAN_ERROR);
+        } else {
+            slcan_reply(req.msg.extd ? "Z\r" : "z\r");
+        }
+        return;
+    case CAN_SLCAN_OPEN:
+    case CAN_SLCAN_LISTEN:
+        slcan_open = true;
+        slcan_listen_only = (req.command == CAN_SLCAN_LISTEN);
+        break;
+    case CAN_SLCAN_CLOSE:
+        slcan_open = false;
+        break;
+    case CAN_SLCAN_BITRATE:
+        if (config.bitrate != 0 && (int)req.arg != can_slcan_bitrate_code(config.bitrate)) {
+            slcan_reply(CAN_SLCAN_ERROR);
+            return;
+        }
+        break;
+    case CAN_SLCAN_TIMESTAMP:
+        slcan_timestamps = req.arg != 0;
+        break;
+    case CAN_SLCAN_VERSION:
+        slcan_reply("V1013\r");
+        return;
+    case CAN_SLCAN_SERIAL:
+        slcan_reply("NC3CV\r");
+        return;
+    case CAN_SLCAN_STATUS: {
+        // Error warning, error passive and bus error flags of the Lawicel status byte
+        twai_status_info_t status;
+        uint8_t flags = 0;
+        if (driver->get_status(&status) == ESP_OK) {
+            uint32_t errors = status.tx_error_counter > status.rx_error_counter ? status.tx_error_counter
+                                                                                   : status.rx_error_counter;
+            flags |= errors >= 96 ? 0x04 : 0;
+            flags |= errors >= 128 ? 0x20 : 0;
+            flags |= status.state == TWAI_STATE_BUS_OFF ? 0x80 : 0;
+        }
+        snprintf(reply, sizeof(reply), "F%02X\r", flags);
+        slcan_reply(reply);
+        return;
+    }
+    case CAN_SLCAN_NOP:
+        break;
+    }
+    slcan_reply(CAN_SLCAN_OK);
+}
+
+static void slcan_receive(void) {
+    char in[SLCAN_IN_SIZE];
+    ssize_t n = recv(client_fd, in, sizeof(in), 0);
+    if (n <= 0) {
+        close_client();
+        return;
+    }
+    for (ssize_t i = 0; i < n; i++) {
+        char c = in[i];
+        if (c == '\r') {
+            if (slcan_line_overflow) {
+                slcan_reply(CAN_SLCAN_ERROR);
+            } else {
+                slcan_command(slcan_line, slcan_line_len);
+            }
+            slcan_line_len = 0;
+            slcan_line_overflow = false;
+        } else if (c == '\n') {
+            continue;
+        } else if (slcan_line_len < CAN_SLCAN_LINE_MAX - 1) {
+            slcan_line[slcan_line_len++] = c;
+        } else {
+            slcan_line_overflow = true;
+        }
+    }
+    slcan_flush();
+}
+
+static void accept_client(void) {
+    int fd = accept(listen_fd, NULL, NULL);
+    if (fd < 0) {
+        return;
+    }
+    // The newest connection wins, so a tool that restarts does not wait for a timeout
+    close_client();
+    int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    client_fd = fd;
+    slcan_line_len = 0;
+    slcan_line_overflow = false;
+    slcan_listen_only = false;
+    slcan_timestamps = false;
+    ESP_LOGI(TAG, "slcan client connected");
+}
+
+static void udp_transmit(const twai_message_t *msg, void *ctx) {
+    transmit(msg);
+}
+
+static void udp_receive(void) {
+    struct sockaddr_in from;
+    socklen_t from_len = sizeof(from);
+    ssize_t n = recvfrom(udp_fd, udp_in, sizeof(udp_in), 0, (struct sockaddr *)&from, &from_len);
+    if (n <= 0) {
+        return;
+    }
+    // Any packet, even one without frames, makes its sender the peer
+    if (!udp_peer_known || from.sin_addr.s_addr != udp_peer.sin_addr.s_addr || from.sin_port != udp_peer.sin_port) {
+        ESP_LOGI(TAG, "cannelloni peer %s:%u", inet_ntoa(from.sin_addr), ntohs(from.sin_port));
+    }
+    udp_peer = from;
+    udp_peer_known = true;
+    can_cannelloni_parse(udp_in, n, udp_transmit, NULL);
+}
+
+static void udp_flush(void) {
+    if (udp_packet.count == 0) {
+        return;
+    }
+    size_t len = can_cannelloni_end(&udp_packet);
+    if (sendto(udp_fd, udp_out, len, MSG_DONTWAIT, (struct sockaddr *)&udp_peer, sizeof(udp_peer)) == (ssize_t)len) {
+        can_metrics_add(CAN_METRIC_BRIDGE_FRAMES, udp_packet.count);
+        can_metrics_add(CAN_METRIC_BRIDGE_DATAGRAMS, 1);
+    } else {
+        can_metrics_add(CAN_METRIC_BRIDGE_DROPPED, udp_packet.count);
+    }
+    can_cannelloni_begin(&udp_packet, udp_out, sizeof(udp_out), ++udp_seq);
+}
+
+static void forward_frame(const can_frame_record_t *rec) {
+    if (client_fd >= 0 && slcan_open) {
+        if (slcan_out_len + CAN_SLCAN_LINE_MAX > SLCAN_OUT_SIZE) {
+            slcan_flush();
+        }
+        if (slcan_out_len + CAN_SLCAN_LINE_MAX <= SLCAN_OUT_SIZE) {
+            int timestamp_ms = slcan_timestamps ? (int)((rec->timestamp_us / 1000) % 60000) : -1;
+            slcan_out_len += can_slcan_encode(slcan_out + slcan_out_len, &rec->msg, timestamp_ms);
+            can_metrics_add(CAN_METRIC_BRIDGE_FRAMES, 1);
+        } else {
+            can_metrics_add(CAN_METRIC_BRIDGE_DROPPED, 1);
+        }
+    }
+    if (udp_peer_known) {
+        if (can_cannelloni_add(&udp_packet, &rec->msg) != ESP_OK) {
+            udp_flush();
+            can_cannelloni_add(&udp_packet, &rec->msg);
+        }
+    }
+}
+
+static void forward_frames(void) {
+    size_t count;
+    do {
+        uint32_t lost;
+        count = can_ring_read(&cursor, batch, BRIDGE_BATCH, &lost);
+        if (lost > 0) {
+            can_metrics_add(CAN_METRIC_BRIDGE_DROPPED, lost);
+        }
+        for (size_t i = 0; i < count; i++) {
+            forward_frame(&batch[i]);
+        }
+    } while (count == BRIDGE_BATCH);
+}
+
+// Waits for network input until the next flush is due. Frames are picked up
+// from the ring at every flush, so none waits longer than flush_ms, and a
+// packet carries everything received in that interval.
+static void can_bridge_task(void *arg) {
+    int64_t flush_us = (int64_t)config.flush_ms * 1000;
+    int64_t next_flush_us = esp_timer_get_time() + flush_us;
+
+    while (1) {
+        fd_set readfds;
+        int max_fd = -1;
+        FD_ZERO(&readfds);
+        int fds[] = { listen_fd, client_fd, udp_fd };
+        for (int i = 0; i < 3; i++) {
+            if (fds[i] >= 0) {
+                FD_SET(fds[i], &readfds);
+                max_fd = fds[i] > max_fd ? fds[i] : max_fd;
+            }
+        }
+
+        int64_t wait_us = next_flush_us - esp_timer_get_time();
+        struct timeval tv = {
+            .tv_sec = wait_us > 0 ? wait_us / 1000000 : 0,
+            .tv_usec = wait_us > 0 ? wait_us % 1000000 : 0,
+        };
+        if (select(max_fd + 1, &readfds, NULL, NULL, &tv) > 0) {
+            if (client_fd >= 0 && FD_ISSET(client_fd, &readfds)) {
+                slcan_receive();
+            }
+            if (listen_fd >= 0 && FD_ISSET(listen_fd, &readfds)) {
+                accept_client();
+            }
+            if (udp_fd >= 0 && FD_ISSET(udp_fd, &readfds)) {
+                udp_receive();
+            }
+        }
+
+        int64_t now_us = esp_timer_get_time();
+        if (now_us < next_flush_us) {
+            continue;
+        }
+        next_flush_us = now_us + flush_us;
+        forward_frames();
+        slcan_flush();
+        if (udp_peer_known) {
+            udp_flush();
+        }
+    }
+}
+
+esp_err_t can_bridge_start(const can_bridge_config_t *bridge_config, const can_driver_t *can_driver) {
+    config = *bridge_config;
+    driver = can_driver;
+    if (config.flush_ms == 0) {
+        config.flush_ms = 1;
+    }
+
+    if (config.slcan_port != 0) {
+        listen_fd = open_socket(SOCK_STREAM, config.slcan_port);
+        if (listen_fd < 0) {
+            ESP_LOGE(TAG, "Cannot listen on TCP port %u: errno %d", config.slcan_port, errno);
+            return ESP_FAIL;
+        }
+    }
+    if (config.cannelloni_port != 0) {
+        udp_fd = open_socket(SOCK_DGRAM, config.cannelloni_port);
+        if (udp_fd < 0) {
+            ESP_LOGE(TAG, "Cannot bind UDP port %u: errno %d", config.cannelloni_port, errno);
+            return ESP_FAIL;
+        }
+    }
+    can_cannelloni_begin(&udp_packet, udp_out, sizeof(udp_out), udp_seq);
+    can_ring_cursor_init(&cursor);
+
+    if (xTaskCreate(can_bridge_task, "can_bridge_task", 4096, NULL, 4, NULL) != pdPASS) {
+        ESP_LOGE(TAG, "Failed to create bridge task");
+        return ESP_ERR_NO_MEM;
+    }
+    ESP_LOGI(TAG, "slcan on TCP %u, cannelloni on UDP %u", config.slcan_port, config.cannelloni_port);
+    return ESP_OK;
+}
\ No newline at end of file
@@ -0,0 +1,37 @@
+// can_bridge.h
+#ifndef CAN_BRIDGE_H
+#define CAN_BRIDGE_H
+
+#include <stdint.h>
+#include "esp_err.h"
+#include "can_driver.h"
+
+// Network CAN interface for PC tools. Received frames are forwarded from the
+// frame ring to
+//
+//   - one TCP client speaking slcan (can_slcan.h), e.g. through
+//     socat pty,link=/tmp/ttyCAN,raw tcp:192.168.4.1:3333 and slcand;
+//   - the last UDP peer that sent a cannelloni packet (can_cannelloni.h).
+//
+// Frames both clients send are transmitted on the bus.
+typedef struct {
+    uint16_t slcan_port;        // 0 disables the TCP server
+    uint16_t cannelloni_port;   // 0 disables the UDP endpoint
+    uint32_t flush_ms;          // Longest time a frame waits for its batch to be sent
+    uint32_t bitrate;           // Bus rate; slcan Sn for other rates is refused. 0 accepts any.
+} can_bridge_config_t;
+
+#define CAN_BRIDGE_CONFIG_DEFAULT() { \
+    .slcan_port = CONFIG_CAN_BRIDGE_SLCAN_PORT, \
+    .cannelloni_port = CONFIG_CAN_BRIDGE_CANNELLONI_PORT, \
+    .flush_ms = CONFIG_CAN_BRIDGE_FLUSH_MS, \
+    .bitrate = 0, \
+}
+
+// Opens the sockets and starts the bridge task. driver is used to transmit
+// and to answer slcan status requests from the bridge task, so on the device
+// it is the one from can_get_tx_driver; frames it refuses are counted as
+// bridge TX errors.
+esp_err_t can_bridge_start(const can_bridge_config_t *config, const can_driver_t *driver);
+
+#endif // CAN_BRIDGE_H
\ No newline at end of file
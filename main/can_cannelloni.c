@@ -0,0 +1,79 @@
+#include "can_cannelloni.h"
+#include <stdbool.h>
+#include <string.h>
+
+void can_cannelloni_begin(can_cannelloni_packet_t *pkt, uint8_t *buf, size_t size, uint8_t seq_no) {
+    pkt->buf = buf;
+    pkt->size = size;
+    pkt->len = CAN_CANNELLONI_HEADER_SIZE;
+    pkt->count = 0;
+    buf[0] = CAN_CANNELLONI_VERSION;
+    buf[1] = CAN_CANNELLONI_OP_DATA;
+    buf[2] = seq_no;
+}
+
+esp_err_t can_cannelloni_add(can_cannelloni_packet_t *pkt, const twai_message_t *msg) {
+    uint8_t dlc = msg->data_length_code > TWAI_FRAME_MAX_DLC ? TWAI_FRAME_MAX_DLC : msg->data_length_code;
+    size_t data_len = msg->rtr ? 0 : dlc;
+    if (pkt->len + 5 + data_len > pkt->size || pkt->count == UINT16_MAX) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+
+    uint32_t can_id = msg->identifier | (msg->extd ? CAN_CANNELLONI_EFF_FLAG : 0) |
+                      (msg->rtr ? CAN_CANNELLONI_RTR_FLAG : 0);
+    uint8_t *p = pkt->buf + pkt->len;
+    p[0] = can_id >> 24;
+    p[1] = can_id >> 16;
+    p[2] = can_id >> 8;
+    p[3] = can_id;
+    p[4] = dlc;
+    memcpy(p + 5, msg->data, data_len);
+    pkt->len += 5 + data_len;
+    pkt->count++;
+    return ESP_OK;
+}
+
+size_t can_cannelloni_end(can_cannelloni_packet_t *pkt) {
+    pkt->buf[3] = pkt->count >> 8;
+    pkt->buf[4] = pkt->count;
+    return pkt->len;
+}
+
+esp_err_t can_cannelloni_parse(const uint8_t *buf, size_t len,
+                               void (*fn)(const twai_message_t *msg, void *ctx), void *ctx) {
+    if (len < CAN_CANNELLONI_HEADER_SIZE || buf[0] != CAN_CANNELLONI_VERSION || buf[1] != CAN_CANNELLONI_OP_DATA) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    uint16_t count = (buf[3] << 8) | buf[4];
+    size_t off = CAN_CANNELLONI_HEADER_SIZE;
+    for (uint16_t i = 0; i < count; i++) {
+        if (off + 5 > len) {
+            return ESP_ERR_INVALID_ARG;
+        }
+        const uint8_t *p = buf + off;
+        uint32_t can_id = ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | (p[2] << 8) | p[3];
+        uint8_t flags_len = p[4];
+        bool fd = flags_len & CAN_CANNELLONI_FD_FLAG;
+        uint8_t data_len = flags_len & ~CAN_CANNELLONI_FD_FLAG;
+        off += 5 + fd;
+        bool rtr = !fd && (can_id & CAN_CANNELLONI_RTR_FLAG);
+        if (rtr) {
+            data_len = 0;
+        }
+        if (off + data_len > len || data_len > 64) {
+            return ESP_ERR_INVALID_ARG;
+        }
+        if (!fd && data_len <= TWAI_FRAME_MAX_DLC) {
+            twai_message_t msg = { 0 };
+            msg.extd = (can_id & CAN_CANNELLONI_EFF_FLAG) != 0;
+            msg.rtr = rtr;
+            msg.identifier = can_id & (msg.extd ? TWAI_EXTD_ID_MASK : TWAI_STD_ID_MASK);
+            msg.data_length_code = rtr ? (flags_len > TWAI_FRAME_MAX_DLC ? TWAI_FRAME_MAX_DLC : flags_len) : data_len;
+            memcpy(msg.data, p + 5, data_len);
+            fn(&msg, ctx);
+        }
+        off += data_len;
+    }
+    return ESP_OK;
+}
\ No newline at end of file
@@ -0,0 +1,55 @@
+// can_cannelloni.h
+#ifndef CAN_CANNELLONI_H
+#define CAN_CANNELLONI_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "esp_err.h"
+#include "driver/twai.h"
+
+// Cannelloni UDP data packets, compatible with the cannelloni tool
+// (github.com/mguentner/cannelloni). Multi-byte fields are big-endian.
+//
+// Header (CAN_CANNELLONI_HEADER_SIZE bytes):
+//   u8  version      CAN_CANNELLONI_VERSION
+//   u8  op_code      CAN_CANNELLONI_OP_DATA
+//   u8  seq_no       incremented per packet
+//   u16 count        number of frames that follow
+//
+// Frame (5 + len bytes):
+//   u32 can_id       SocketCAN layout: CAN_EFF_FLAG, CAN_RTR_FLAG, identifier
+//   u8  len          DLC
+//   u8  data[len]    omitted for remote frames
+#define CAN_CANNELLONI_VERSION 2
+#define CAN_CANNELLONI_OP_DATA 0
+#define CAN_CANNELLONI_HEADER_SIZE 5
+#define CAN_CANNELLONI_FRAME_MAX (5 + TWAI_FRAME_MAX_DLC)
+
+#define CAN_CANNELLONI_EFF_FLAG 0x80000000UL
+#define CAN_CANNELLONI_RTR_FLAG 0x40000000UL
+#define CAN_CANNELLONI_FD_FLAG 0x80
+
+// Packet under construction.
+typedef struct {
+    uint8_t *buf;
+    size_t size;
+    size_t len;
+    uint16_t count;
+} can_cannelloni_packet_t;
+
+// Starts a packet in buf. size must be at least CAN_CANNELLONI_HEADER_SIZE.
+void can_cannelloni_begin(can_cannelloni_packet_t *pkt, uint8_t *buf, size_t size, uint8_t seq_no);
+
+// Appends a frame. ESP_ERR_INVALID_SIZE when it does not fit any more.
+esp_err_t can_cannelloni_add(can_cannelloni_packet_t *pkt, const twai_message_t *msg);
+
+// Writes the frame count into the header and returns the packet length.
+size_t can_cannelloni_end(can_cannelloni_packet_t *pkt);
+
+// Decodes the frames of a received packet, calling fn for each one. CAN FD
+// frames are skipped. Returns ESP_ERR_INVALID_ARG if the packet is truncated
+// or not a data packet; frames before the error were already delivered.
+esp_err_t can_cannelloni_parse(const uint8_t *buf, size_t len,
+                               void (*fn)(const twai_message_t *msg, void *ctx), void *ctx);
+
+#endif // CAN_CANNELLONI_H
\ No newline at end of file
@@ -0,0 +1,803 @@
+#include "can_dbc.h"
+#include "esp_log.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define TAG "CAN_DBC"
+#define DBC_MAGIC 0x31434244        // "DBC1"
+#define DBC_VERSION 1
+#define DBC_NO_MUX 0xffff
+#define DBC_KEY_EXTD 0x80000000u
+#define DBC_INDEPENDENT_MSG "VECTOR__INDEPENDENT_SIG_MSG"
+#define DBC_NAME_SLOTS 4096         // Name index of the parser, a power of two
+
+#define SIG_BIG_ENDIAN 0x01
+#define SIG_SIGNED 0x02
+#define SIG_MULTIPLEXOR 0x04
+#define SIG_MULTIPLEXED 0x08
+
+typedef struct {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t message_count;
+    uint16_t signal_count;
+    uint16_t reserved;
+    uint32_t names_size;
+} dbc_header_t;
+
+typedef struct {
+    uint32_t key;                   // Identifier, DBC_KEY_EXTD for extended frames
+    uint16_t first_signal;
+    uint16_t signal_count;
+    uint16_t mux_signal;            // Index of the multiplexor signal, DBC_NO_MUX if none
+    uint16_t name;
+} dbc_message_t;
+
+typedef struct {
+    uint64_t mask;                  // (1 << length) - 1
+    int32_t scale;                  // Scale * 10^decimals
+    int32_t offset;                 // Offset * 10^decimals
+    uint8_t shift;                  // Position of the LSB in the byte-order-adjusted 64-bit word
+    uint8_t extend;                 // 64 - length: shift pair that sign-extends
+    uint8_t flags;
+    uint8_t decimals;
+    uint16_t mux_value;
+    uint16_t name;
+    uint16_t unit;
+    uint16_t reserved;
+} dbc_signal_t;
+
+// One allocation: header, messages, signals, names. This is also the file format.
+struct can_dbc_table {
+    size_t size;
+    const dbc_header_t *header;
+    const dbc_message_t *messages;
+    const dbc_signal_t *signals;
+    const char *names;
+    uint8_t blob[];
+};
+
+struct can_dbc_parser {
+    dbc_message_t *messages;
+    dbc_signal_t *signals;
+    char *names;
+    size_t message_count;
+    size_t signal_count;
+    size_t names_size;
+    uint16_t name_slots[DBC_NAME_SLOTS];    // Open-addressed pool offsets + 1, 0 when free
+    size_t name_count;
+    bool in_message;                // Signals of the current BO_ are kept
+    size_t line_len;
+    bool line_overflow;
+    uint32_t line_number;
+    esp_err_t error;
+    char reason[48];
+    char line[CAN_DBC_LINE_MAX];
+};
+
+static can_dbc_table_t *active;
+static SemaphoreHandle_t dbc_mutex;
+
+// ---- Parser ----
+
+static esp_err_t parse_fail(can_dbc_parser_t *p, esp_err_t err, const char *reason) {
+    p->error = err;
+    snprintf(p->reason, sizeof(p->reason), "%s", reason);
+    return err;
+}
+
+static const char *skip_space(const char *s) {
+    while (*s == ' ' || *s == '\t') {
+        s++;
+    }
+    return s;
+}
+
+// Copies an identifier-like token; returns its end or NULL if empty.
+static const char *parse_token(const char *s, char *dst, size_t size) {
+    size_t n = 0;
+    s = skip_space(s);
+    while (*s && *s != ' ' && *s != '\t' && *s != ':' && *s != '\r') {
+        if (n + 1 < size) {
+            dst[n++] = *s;
+        }
+        s++;
+    }
+    dst[n] = '\0';
+    return n ? s : NULL;
+}
+
+static const char *parse_uint(const char *s, uint32_t *out) {
+    char *end;
+    s = skip_space(s);
+    if (!isdigit((unsigned char)*s)) {
+        return NULL;
+    }
+    *out = strtoul(s, &end, 10);
+    return end;
+}
+
+// Reads a decimal number exactly as value = mantissa * 10^-exponent.
+static const char *parse_decimal(const char *s, int64_t *mantissa, int *exponent) {
+    bool negative = false;
+    bool digits = false;
+    int64_t m = 0;
+    int e = 0;
+
+    s = skip_space(s);
+    if (*s == '+' || *s == '-') {
+        negative = *s++ == '-';
+    }
+    for (; isdigit((unsigned char)*s); s++, digits = true) {
+        if (m < 100000000000000000LL) {
+            m = m * 10 + (*s - '0');
+        } else {
+            e--;
+        }
+    }
+    if (*s == '.') {
+        for (s++; isdigit((unsigned char)*s); s++, digits = true) {
+            if (m < 100000000000000000LL) {
+                m = m * 10 + (*s - '0');
+                e++;
+            }
+        }
+    }
+    if (!digits) {
+        return NULL;
+    }
+    if (*s == 'e' || *s == 'E') {
+        char *end;
+        long x = strtol(s + 1, &end, 10);
+        if (end == s + 1) {
+            return NULL;
+        }
+        e -= x;
+        s = end;
+    }
+
+    while (e > 0 && m % 10 == 0 && m != 0) {
+        m /= 10;
+        e--;
+    }
+    while (e < 0 && m < 100000000000000000LL) {
+        m *= 10;
+        e++;
+    }
+    if (e < 0) {
+        return NULL;
+    }
+    *mantissa = negative ? -m : m;
+    *exponent = m == 0 ? 0 : e;
+    return s;
+}
+
+static int64_t pow10_i64(int n) {
+    int64_t v = 1;
+    while (n-- > 0) {
+        v *= 10;
+    }
+    return v;
+}
+
+static int64_t div_round(int64_t v, int64_t d) {
+    return (v >= 0 ? v + d / 2 : v - d / 2) / d;
+}
+
+// Brings scale and offset to a common number of decimals that fits int32.
+// Digits past CAN_DBC_MAX_DECIMALS are rounded, which the caller has to
+// check did not take a nonzero factor or offset to zero.
+static bool to_fixed_point(int64_t sm, int se, int64_t om, int oe, dbc_signal_t *sig) {
+    int decimals = se > oe ? se : oe;
+    if (decimals > CAN_DBC_MAX_DECIMALS) {
+        decimals = CAN_DBC_MAX_DECIMALS;
+    }
+
+    for (; decimals >= 0; decimals--) {
+        int64_t scale = se > decimals ? div_round(sm, pow10_i64(se - decimals)) : sm * pow10_i64(decimals - se);
+        int64_t offset = oe > decimals ? div_round(om, pow10_i64(oe - decimals)) : om * pow10_i64(decimals - oe);
+        if (scale >= INT32_MIN && scale <= INT32_MAX && offset >= INT32_MIN && offset <= INT32_MAX) {
+            sig->scale = scale;
+            sig->offset = offset;
+            sig->decimals = decimals;
+            return true;
+        }
+    }
+    return false;
+}
+
+static bool valid_utf8(const char *s, size_t len) {
+    for (size_t i = 0; i < len; ) {
+        uint8_t c = s[i];
+        size_t extra = c < 0x80 ? 0 : (c & 0xe0) == 0xc0 ? 1 : (c & 0xf0) == 0xe0 ? 2 : (c & 0xf8) == 0xf0 ? 3 : 4;
+        if (extra == 4 || (extra > 0 && i + extra >= len)) {
+            return false;
+        }
+        for (size_t k = 1; k <= extra; k++) {
+            if (((uint8_t)s[i + k] & 0xc0) != 0x80) {
+                return false;
+            }
+        }
+        i += extra + 1;
+    }
+    return true;
+}
+
+// Adds a name to the pool, reusing an identical one found through
+// name_slots. Units that are not UTF-8 are taken as Latin-1 (the usual DBC
+// encoding) and converted, since they end up in WebSocket text frames.
+static bool add_name(can_dbc_parser_t *p, const char *text, size_t len, uint16_t *out) {
+    char converted[2 * 32 + 1];
+    if (!valid_utf8(text, len)) {
+        size_t n = 0;
+        for (size_t i = 0; i < len && n + 2 < sizeof(converted); i++) {
+            uint8_t c = text[i];
+            if (c < 0x80) {
+                converted[n++] = c;
+            } else {
+                converted[n++] = 0xc0 | (c >> 6);
+                converted[n++] = 0x80 | (c & 0x3f);
+            }
+        }
+        text = converted;
+        len = n;
+    }
+
+    // Names are emitted inside JSON strings as is
+    char clean[2 * 32 + 1];
+    if (len >= sizeof(clean)) {
+        len = sizeof(clean) - 1;
+    }
+    for (size_t i = 0; i < len; i++) {
+        clean[i] = ((uint8_t)text[i] < 0x20 || text[i] == '\\' || text[i] == '"') ? '?' : text[i];
+    }
+    text = clean;
+
+    // FNV-1a, linear probing
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < len; i++) {
+        hash = (hash ^ (uint8_t)text[i]) * 16777619u;
+    }
+    size_t slot = hash & (DBC_NAME_SLOTS - 1);
+    for (; p->name_slots[slot] != 0; slot = (slot + 1) & (DBC_NAME_SLOTS - 1)) {
+        const char *name = p->names + p->name_slots[slot] - 1;
+        if (strncmp(name, text, len) == 0 && name[len] == '\0') {
+            *out = p->name_slots[slot] - 1;
+            return true;
+        }
+    }
+    if (p->names_size + len + 1 > CAN_DBC_MAX_NAMES) {
+        return false;
+    }
+    char *names = realloc(p->names, p->names_size + len + 1);
+    if (names == NULL) {
+        return false;
+    }
+    p->names = names;
+    memcpy(p->names + p->names_size, text, len);
+    p->names[p->names_size + len] = '\0';
+    *out = p->names_size;
+    if (p->name_count < DBC_NAME_SLOTS * 3 / 4) {
+        // Past that, further names are stored without being indexed
+        p->name_slots[slot] = p->names_size + 1;
+        p->name_count++;
+    }
+    p->names_size += len + 1;
+    return true;
+}
+
+// BO_ <id> <name>: <dlc> <transmitter>
+static esp_err_t parse_message(can_dbc_parser_t *p, const char *s) {
+    uint32_t raw_id;
+    char name[64];
+
+    p->in_message = false;
+    if ((s = parse_uint(s, &raw_id)) == NULL || (s = parse_token(s, name, sizeof(name))) == NULL) {
+        return parse_fail(p, ESP_ERR_INVALID_ARG, "bad BO_ line");
+    }
+    if (strcmp(name, DBC_INDEPENDENT_MSG) == 0) {
+        return ESP_OK;
+    }
+    if (p->message_count == CAN_DBC_MAX_MESSAGES) {
+        return parse_fail(p, ESP_ERR_INVALID_SIZE, "too many messages");
+    }
+
+    dbc_message_t *messages = realloc(p->messages, (p->message_count + 1) * sizeof(dbc_message_t));
+    if (messages == NULL) {
+        return parse_fail(p, ESP_ERR_NO_MEM, "out of memory");
+    }
+    p->messages = messages;
+
+    dbc_message_t *m = &p->messages[p->message_count];
+    m->key = (raw_id & DBC_KEY_EXTD) ? ((raw_id & TWAI_EXTD_ID_MASK) | DBC_KEY_EXTD) : (raw_id & TWAI_STD_ID_MASK);
+    m->first_signal = p->signal_count;
+    m->signal_count = 0;
+    m->mux_signal = DBC_NO_MUX;
+    if (!add_name(p, name, strlen(name), &m->name)) {
+        return parse_fail(p, ESP_ERR_NO_MEM, "name pool full");
+    }
+    p->message_count++;
+    p->in_message = true;
+    return ESP_OK;
+}
+
+// SG_ <name> [M|m<n>] : <start>|<length>@<order><sign> (<scale>,<offset>) [<min>|<max>] "<unit>" <receivers>
+static esp_err_t parse_signal(can_dbc_parser_t *p, const char *s) {
+    char name[64];
+    char mux[16] = "";
+    uint32_t start, length;
+    int64_t sm, om;
+    int se, oe;
+    dbc_signal_t sig;
+
+    if (!p->in_message) {
+        return ESP_OK;
+    }
+    memset(&sig, 0, sizeof(sig));
+    sig.mux_value = DBC_NO_MUX;
+
+    if ((s = parse_token(s, name, sizeof(name))) == NULL) {
+        return parse_fail(p, ESP_ERR_INVALID_ARG, "bad SG_ name");
+    }
+    s = skip_space(s);
+    if (*s != ':') {
+        if ((s = parse_token(s, mux, sizeof(mux))) == NULL) {
+            return parse_fail(p, ESP_ERR_INVALID_ARG, "bad SG_ multiplexer");
+        }
+        s = skip_space(s);
+    }
+    if (*s++ != ':' || (s = parse_uint(s, &start)) == NULL || *s++ != '|'
+            || (s = parse_uint(s, &length)) == NULL || *s++ != '@'
+            || (*s != '0' && *s != '1') || (s[1] != '+' && s[1] != '-')) {
+        return parse_fail(p, ESP_ERR_INVALID_ARG, "bad SG_ layout");
+    }
+    bool big_endian = *s == '0';
+    bool is_signed = s[1] == '-';
+    s = skip_space(s + 2);
+    if (*s++ != '(' || (s = parse_decimal(s, &sm, &se)) == NULL || *s++ != ','
+            || (s = parse_decimal(s, &om, &oe)) == NULL || *s++ != ')') {
+        return parse_fail(p, ESP_ERR_INVALID_ARG, "bad SG_ factor");
+    }
+    s = strchr(s, '"');
+    const char *unit_end = s ? strchr(s + 1, '"') : NULL;
+    if (unit_end == NULL) {
+        return parse_fail(p, ESP_ERR_INVALID_ARG, "bad SG_ unit");
+    }
+
+    if (length == 0 || length > 64 || start > 63) {
+        return parse_fail(p, ESP_ERR_INVALID_ARG, "signal outside frame");
+    }
+    int lsb;
+    if (big_endian) {
+        // Motorola start bit is the MSB; in the byte-swapped word byte 0 is on top
+        int msb = (7 - (int)(start / 8)) * 8 + (int)(start % 8);
+        lsb = msb - (int)length + 1;
+    } else {
+        lsb = start;
+        if (start + length > 64) {
+            lsb = -1;
+        }
+    }
+    if (lsb < 0) {
+        return parse_fail(p, ESP_ERR_INVALID_ARG, "signal outside frame");
+    }
+    sig.shift = lsb;
+    sig.mask = length == 64 ? UINT64_MAX : ((1ULL << length) - 1);
+    sig.extend = 64 - length;
+    sig.flags = (big_endian ? SIG_BIG_ENDIAN : 0) | (is_signed ? SIG_SIGNED : 0);
+    if (!to_fixed_point(sm, se, om, oe, &sig)) {
+        return parse_fail(p, ESP_ERR_INVALID_ARG, "factor out of range");
+    }
+    if ((sm != 0 && sig.scale == 0) || (om != 0 && sig.offset == 0)) {
+        return parse_fail(p, ESP_ERR_INVALID_ARG, "factor or offset below resolution");
+    }
+
+    dbc_message_t *m = &p->messages[p->message_count - 1];
+    if (strcmp(mux, "M") == 0) {
+        sig.flags |= SIG_MULTIPLEXOR;
+        m->mux_signal = p->signal_count;
+    } else if (mux[0] == 'm' && isdigit((unsigned char)mux[1])) {
+        // "m3" or, in extended multiplexing, "m3M": only the value is used
+        sig.flags |= SIG_MULTIPLEXED;
+        sig.mux_value = strtoul(mux + 1, NULL, 10);
+    }
+
+    if (p->signal_count == CAN_DBC_MAX_SIGNALS || m->signal_count == UINT16_MAX) {
+        return parse_fail(p, ESP_ERR_INVALID_SIZE, "too many signals");
+    }
+    if (!add_name(p, name, strlen(name), &sig.name) || !add_name(p, s + 1, unit_end - s - 1, &sig.unit)) {
+        return parse_fail(p, ESP_ERR_NO_MEM, "name pool full");
+    }
+    dbc_signal_t *signals = realloc(p->signals, (p->signal_count + 1) * sizeof(dbc_signal_t));
+    if (signals == NULL) {
+        return parse_fail(p, ESP_ERR_NO_MEM, "out of memory");
+    }
+    p->signals = signals;
+    p->signals[p->signal_count++] = sig;
+    m->signal_count++;
+    return ESP_OK;
+}
+
+static esp_err_t parse_line(can_dbc_parser_t *p) {
+    const char *s = skip_space(p->line);
+
+    if (strncmp(s, "BO_ ", 4) == 0) {
+        return parse_message(p, s + 4);
+    }
+    if (strncmp(s, "SG_ ", 4) == 0) {
+        return parse_signal(p, s + 4);
+    }
+    if (*s != '\0' && *s != '\r') {
+        p->in_message = false;   // Any other section ends the signal list
+    }
+    return ESP_OK;
+}
+
+can_dbc_parser_t *can_dbc_parser_new(void) {
+    can_dbc_parser_t *p = calloc(1, sizeof(can_dbc_parser_t));
+    if (p != NULL) {
+        p->line_number = 1;
+    }
+    return p;
+}
+
+esp_err_t can_dbc_parser_feed(can_dbc_parser_t *p, const char *text, size_t len) {
+    for (size_t i = 0; i < len && p->error == ESP_OK; i++) {
+        if (text[i] != '\n') {
+            if (p->line_len + 1 < CAN_DBC_LINE_MAX) {
+                p->line[p->line_len++] = text[i];
+            } else {
+                p->line_overflow = true;
+            }
+            continue;
+        }
+
+        p->line[p->line_len] = '\0';
+        const char *s = skip_space(p->line);
+        if (!p->line_overflow) {
+            parse_line(p);
+        } else if (strncmp(s, "BO_ ", 4) == 0 || strncmp(s, "SG_ ", 4) == 0) {
+            parse_fail(p, ESP_ERR_INVALID_SIZE, "line too long");
+        }
+        if (p->error == ESP_OK) {
+            p->line_number++;
+        }
+        p->line_len = 0;
+        p->line_overflow = false;
+    }
+    return p->error;
+}
+
+void can_dbc_parser_error(const can_dbc_parser_t *p, char *dst, size_t size) {
+    snprintf(dst, size, "line %lu: %s", (unsigned long)p->line_number, p->reason);
+}
+
+void can_dbc_parser_free(can_dbc_parser_t *p) {
+    if (p != NULL) {
+        free(p->messages);
+        free(p->signals);
+        free(p->names);
+        free(p);
+    }
+}
+
+static int compare_messages(const void *a, const void *b) {
+    uint32_t ka = ((const dbc_message_t *)a)->key;
+    uint32_t kb = ((const dbc_message_t *)b)->key;
+    return ka < kb ? -1 : ka > kb;
+}
+
+static void table_bind(can_dbc_table_t *t) {
+    t->header = (const dbc_header_t *)t->blob;
+    t->messages = (const dbc_message_t *)(t->blob + sizeof(dbc_header_t));
+    t->signals = (const dbc_signal_t *)(t->messages + t->header->message_count);
+    t->names = (const char *)(t->signals + t->header->signal_count);
+}
+
+esp_err_t can_dbc_parser_finish(can_dbc_parser_t *p, can_dbc_table_t **out) {
+    if (p->error == ESP_OK && p->line_len > 0) {
+        can_dbc_parser_feed(p, "\n", 1);
+    }
+    esp_err_t err = p->error;
+    if (err == ESP_OK && p->message_count == 0) {
+        err = parse_fail(p, ESP_ERR_NOT_FOUND, "no messages");
+    }
+    if (err != ESP_OK) {
+        return err;
+    }
+
+    // Sorted for binary search; each message keeps its own signal run
+    qsort(p->messages, p->message_count, sizeof(dbc_message_t), compare_messages);
+    for (size_t i = 1; i < p->message_count; i++) {
+        if (p->messages[i].key == p->messages[i - 1].key) {
+            return parse_fail(p, ESP_ERR_INVALID_ARG, "duplicate message id");
+        }
+    }
+
+    size_t blob_size = sizeof(dbc_header_t) + p->message_count * sizeof(dbc_message_t)
+                       + p->signal_count * sizeof(dbc_signal_t) + p->names_size;
+    can_dbc_table_t *t = malloc(sizeof(can_dbc_table_t) + blob_size);
+    if (t == NULL) {
+        return parse_fail(p, ESP_ERR_NO_MEM, "out of memory");
+    }
+    t->size = blob_size;
+
+    dbc_header_t header = {
+        .magic = DBC_MAGIC,
+        .version = DBC_VERSION,
+        .message_count = p->message_count,
+        .signal_count = p->signal_count,
+        .names_size = p->names_size,
+    };
+    uint8_t *w = t->blob;
+    memcpy(w, &header, sizeof(header));
+    w += sizeof(header);
+    memcpy(w, p->messages, p->message_count * sizeof(dbc_message_t));
+    w += p->message_count * sizeof(dbc_message_t);
+    memcpy(w, p->signals, p->signal_count * sizeof(dbc_signal_t));
+    w += p->signal_count * sizeof(dbc_signal_t);
+    memcpy(w, p->names, p->names_size);
+    table_bind(t);
+
+    *out = t;
+    return ESP_OK;
+}
+
+// ---- Table ----
+
+// Checks a table read from flash before anything indexes into it.
+static bool table_valid(const can_dbc_table_t *t) {
+    if (t->size < sizeof(dbc_header_t)) {
+        return false;
+    }
+    const dbc_header_t *h = (const dbc_header_t *)t->blob;
+    if (h->magic != DBC_MAGIC || h->version != DBC_VERSION || h->names_size == 0
+            || t->size != sizeof(dbc_header_t) + h->message_count * sizeof(dbc_message_t)
+                          + h->signal_count * sizeof(dbc_signal_t) + h->names_size
+            || t->blob[t->size - 1] != '\0') {
+        return false;
+    }
+
+    const dbc_message_t *messages = (const dbc_message_t *)(t->blob + sizeof(dbc_header_t));
+    const dbc_signal_t *signals = (const dbc_signal_t *)(messages + h->message_count);
+    for (size_t i = 0; i < h->message_count; i++) {
+        const dbc_message_t *m = &messages[i];
+        if (m->name >= h->names_size || m->first_signal + m->signal_count > h->signal_count
+                || (i > 0 && m->key <= messages[i - 1].key)
+                || (m->mux_signal != DBC_NO_MUX && m->mux_signal >= h->signal_count)) {
+            return false;
+        }
+    }
+    for (size_t i = 0; i < h->signal_count; i++) {
+        const dbc_signal_t *sig = &signals[i];
+        if (sig->name >= h->names_size || sig->unit >= h->names_size || sig->shift > 63 || sig->extend > 63
+                || sig->decimals > CAN_DBC_MAX_DECIMALS) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static esp_err_t table_save(const can_dbc_table_t *t) {
+    char tmp_path[] = CAN_DBC_PATH ".TMP";
+    FILE *f = fopen(tmp_path, "wb");
+    if (f == NULL) {
+        return ESP_FAIL;
+    }
+    bool ok = fwrite(t->blob, 1, t->size, f) == t->size;
+    ok = (fclose(f) == 0) && ok;
+    unlink(CAN_DBC_PATH);
+    if (!ok || rename(tmp_path, CAN_DBC_PATH) != 0) {
+        unlink(tmp_path);
+        return ESP_FAIL;
+    }
+    return ESP_OK;
+}
+
+esp_err_t can_dbc_install(can_dbc_table_t *table, bool persist) {
+    esp_err_t ret = ESP_OK;
+    if (persist) {
+        if (table != NULL) {
+            ret = table_save(table);
+        } else if (unlink(CAN_DBC_PATH) != 0) {
+            ret = ESP_ERR_NOT_FOUND;
+        }
+        if (ret != ESP_OK) {
+            ESP_LOGW(TAG, "Failed to update %s", CAN_DBC_PATH);
+        }
+    }
+
+    xSemaphoreTake(dbc_mutex, portMAX_DELAY);
+    can_dbc_table_t *old = active;
+    active = table;
+    xSemaphoreGive(dbc_mutex);
+    free(old);
+    return ret;
+}
+
+esp_err_t can_dbc_init(void) {
+    dbc_mutex = xSemaphoreCreateMutex();
+    if (dbc_mutex == NULL) {
+        ESP_LOGE(TAG, "Failed to create DBC mutex");
+        return ESP_ERR_NO_MEM;
+    }
+
+    FILE *f = fopen(CAN_DBC_PATH, "rb");
+    if (f == NULL) {
+        return ESP_ERR_NOT_FOUND;
+    }
+    fseek(f, 0, SEEK_END);
+    long size = ftell(f);
+    fseek(f, 0, SEEK_SET);
+
+    can_dbc_table_t *t = NULL;
+    if (size > 0 && size <= (long)(sizeof(dbc_header_t) + CAN_DBC_MAX_MESSAGES * sizeof(dbc_message_t)
+                                   + CAN_DBC_MAX_SIGNALS * sizeof(dbc_signal_t) + CAN_DBC_MAX_NAMES)) {
+        t = malloc(sizeof(can_dbc_table_t) + size);
+    }
+    if (t != NULL) {
+        t->size = size;
+        if (fread(t->blob, 1, size, f) != (size_t)size || !table_valid(t)) {
+            free(t);
+            t = NULL;
+        }
+    }
+    fclose(f);
+
+    if (t == NULL) {
+        ESP_LOGW(TAG, "Ignoring invalid %s", CAN_DBC_PATH);
+        return ESP_ERR_INVALID_STATE;
+    }
+    table_bind(t);
+    ESP_LOGI(TAG, "Loaded %u messages, %u signals", t->header->message_count, t->header->signal_count);
+    return can_dbc_install(t, false);
+}
+
+bool can_dbc_info(size_t *messages, size_t *signals, size_t *bytes) {
+    xSemaphoreTake(dbc_mutex, portMAX_DELAY);
+    bool loaded = active != NULL;
+    if (loaded) {
+        *messages = active->header->message_count;
+        *signals = active->header->signal_count;
+        *bytes = active->size;
+    }
+    xSemaphoreGive(dbc_mutex);
+    return loaded;
+}
+
+// ---- Decoding ----
+
+static int find_message(const can_dbc_table_t *t, uint32_t key) {
+    int lo = 0;
+    int hi = t->header->message_count - 1;
+    while (lo <= hi) {
+        int mid = (lo + hi) / 2;
+        uint32_t k = t->messages[mid].key;
+        if (k == key) {
+            return mid;
+        }
+        if (k < key) {
+            lo = mid + 1;
+        } else {
+            hi = mid - 1;
+        }
+    }
+    return -1;
+}
+
+static inline uint64_t load_le64(const uint8_t *d) {
+    uint64_t v;
+    memcpy(&v, d, sizeof(v));   // Both the C3 and hosts are little-endian
+    return v;
+}
+
+// Raw signal value in the integer domain, sign-extended if signed.
+static inline int64_t extract_raw(const dbc_signal_t *sig, uint64_t le, uint64_t be) {
+    uint64_t raw = ((sig->flags & SIG_BIG_ENDIAN ? be : le) >> sig->shift) & sig->mask;
+    if (sig->flags & SIG_SIGNED) {
+        return (int64_t)(raw << sig->extend) >> sig->extend;
+    }
+    return (int64_t)raw;
+}
+
+// Physical value * 10^decimals
+static inline int64_t decode_signal(const dbc_signal_t *sig, uint64_t le, uint64_t be) {
+    return extract_raw(sig, le, be) * sig->scale + sig->offset;
+}
+
+static char *put_fixed(char *p, int64_t value, uint8_t decimals) {
+    char digits[24];
+    int n = 0;
+    uint64_t v = value < 0 ? -(uint64_t)value : (uint64_t)value;
+
+    do {
+        digits[n++] = '0' + v % 10;
+        v /= 10;
+    } while (v > 0 || n <= decimals);
+
+    // Trailing fractional zeros are dropped
+    int skip = 0;
+    while (skip < decimals && digits[skip] == '0') {
+        skip++;
+    }
+    if (value < 0) {
+        *p++ = '-';
+    }
+    for (int i = n - 1; i >= skip; i--) {
+        if (i == decimals - 1) {
+            *p++ = '.';
+        }
+        *p++ = digits[i];
+    }
+    return p;
+}
+
+// Longest row: two names, a value and a unit, quoted, plus separators
+static size_t row_max(const can_dbc_table_t *t, const dbc_message_t *m, const dbc_signal_t *sig) {
+    return strlen(t->names + m->name) + strlen(t->names + sig->name) + strlen(t->names + sig->unit) + 48;
+}
+
+size_t can_dbc_format_batch_json(const can_frame_record_t *records, size_t count, char *dst, size_t size) {
+    uint32_t done[CAN_DBC_MAX_MESSAGES / 32] = {0};
+    size_t len = 0;
+    bool any = false;
+
+    if (size < 3) {
+        return 0;
+    }
+    xSemaphoreTake(dbc_mutex, portMAX_DELAY);
+    const can_dbc_table_t *t = active;
+    dst[len++] = '[';
+
+    // Newest frame of each message only: walk the batch backwards
+    for (size_t r = count; t != NULL && r-- > 0; ) {
+        const twai_message_t *msg = &records[r].msg;
+        uint32_t key = msg->extd ? (msg->identifier | DBC_KEY_EXTD) : msg->identifier;
+        int index = find_message(t, key);
+        if (index < 0 || (done[index / 32] & (1u << (index % 32)))) {
+            continue;
+        }
+        done[index / 32] |= 1u << (index % 32);
+
+        const dbc_message_t *m = &t->messages[index];
+        uint64_t le = load_le64(msg->data);
+        uint64_t be = __builtin_bswap64(le);
+        int64_t mux = m->mux_signal != DBC_NO_MUX ? extract_raw(&t->signals[m->mux_signal], le, be) : -1;
+
+        size_t row_start = len;
+        bool fits = true;
+        for (size_t i = 0; i < m->signal_count; i++) {
+            const dbc_signal_t *sig = &t->signals[m->first_signal + i];
+            if ((sig->flags & SIG_MULTIPLEXED) && sig->mux_value != mux) {
+                continue;
+            }
+            if (len + row_max(t, m, sig) + 2 > size) {
+                fits = false;
+                break;
+            }
+            char *p = dst + len;
+            p += sprintf(p, "%s[\"%s\",\"%s\",", any ? "," : "", t->names + m->name, t->names + sig->name);
+            p = put_fixed(p, decode_signal(sig, le, be), sig->decimals);
+            p += sprintf(p, ",\"%s\"]", t->names + sig->unit);
+            len = p - dst;
+            any = true;
+        }
+        if (!fits) {
+            len = row_start;     // Drop the partial message and stop
+            break;
+        }
+    }
+    xSemaphoreGive(dbc_mutex);
+
+    if (!any) {
+        return 0;
+    }
+    dst[len++] = ']';
+    dst[len] = '\0';
+    return len;
+}
\ No newline at end of file
@@ -0,0 +1,60 @@
+// can_dbc.h
+#ifndef CAN_DBC_H
+#define CAN_DBC_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stddef.h>
+#include "esp_err.h"
+#include "driver/twai.h"
+#include "can_ring.h"
+#include "storage.h"
+
+// Signal decoding from a DBC file. The text is parsed once into a compact
+// table: messages sorted by identifier, each pointing at a run of signal
+// descriptors with precomputed shift, mask, sign extension and fixed-point
+// scale/offset, followed by a pool of names. Decoding a signal is a byte
+// swap, two shifts, a mask, a multiply and an add. The table is stored as
+// is in flash and loaded at boot without parsing.
+
+#define CAN_DBC_PATH STORAGE_BASE_PATH "/DBC.BIN"
+#define CAN_DBC_MAX_MESSAGES 512
+#define CAN_DBC_MAX_SIGNALS 2048
+#define CAN_DBC_MAX_NAMES 32768     // Bytes of message, signal and unit names
+#define CAN_DBC_LINE_MAX 512
+#define CAN_DBC_MAX_DECIMALS 9      // Fractional digits kept in physical values
+
+typedef struct can_dbc_table can_dbc_table_t;
+typedef struct can_dbc_parser can_dbc_parser_t;
+
+// Incremental DBC parser. Text can be fed in arbitrary pieces, so an upload
+// is compiled while it is received. BO_ and SG_ lines are used, including
+// simple multiplexing (M / mN); everything else is skipped.
+can_dbc_parser_t *can_dbc_parser_new(void);
+esp_err_t can_dbc_parser_feed(can_dbc_parser_t *parser, const char *text, size_t len);
+
+// Flushes the last line and builds the table. The parser still has to be freed.
+esp_err_t can_dbc_parser_finish(can_dbc_parser_t *parser, can_dbc_table_t **out);
+
+// Line number and reason of the last parser error.
+void can_dbc_parser_error(const can_dbc_parser_t *parser, char *dst, size_t size);
+void can_dbc_parser_free(can_dbc_parser_t *parser);
+
+// Makes table the active one, taking ownership. With persist it is saved to
+// CAN_DBC_PATH. NULL clears the active table (and the saved one).
+esp_err_t can_dbc_install(can_dbc_table_t *table, bool persist);
+
+// Creates the table lock and loads the table saved in CAN_DBC_PATH, if any.
+// Storage must be mounted for the saved table to be found.
+esp_err_t can_dbc_init(void);
+
+// Size of the active table; false when none is loaded.
+bool can_dbc_info(size_t *messages, size_t *signals, size_t *bytes);
+
+// Decodes the newest frame of every known message in records as a JSON array
+// of ["Message","Signal",value,"unit"] rows. Stops before a message that
+// does not fit. Returns the number of characters written, 0 when nothing
+// was decoded.
+size_t can_dbc_format_batch_json(const can_frame_record_t *records, size_t count, char *dst, size_t size);
+
+#endif // CAN_DBC_H
\ No newline at end of file
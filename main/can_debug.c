@@ -0,0 +1,86 @@
+#include "can_debug.h"
+#include "can_format.h"
+#include "can_ring.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include <stdatomic.h>
+
+#define TAG "CAN_TRACE"
+#define DEBUG_BATCH 16
+#define DEBUG_IDLE_MS 200
+#define DEBUG_POLL_MS 20
+#define DEBUG_WINDOW_US 1000000
+
+static atomic_uint_least32_t max_lines = CONFIG_CAN_DEBUG_LOG_RATE;
+static atomic_uint_least32_t sample_every = 1;
+
+void can_debug_set(uint32_t max_per_sec, uint32_t sample) {
+    atomic_store(&sample_every, sample ? sample : 1);
+    atomic_store(&max_lines, max_per_sec);
+}
+
+void can_debug_get(uint32_t *max_per_sec, uint32_t *sample) {
+    *max_per_sec = atomic_load(&max_lines);
+    *sample = atomic_load(&sample_every);
+}
+
+static void can_debug_task(void *arg) {
+    static can_frame_record_t batch[DEBUG_BATCH];
+    char line[CAN_FORMAT_MESSAGE_MAX];
+    can_ring_cursor_t cursor;
+    uint32_t seen = 0;
+    uint32_t budget = 0;
+    uint32_t suppressed = 0;
+    int64_t window_start = 0;
+
+    while (1) {
+        uint32_t limit = atomic_load(&max_lines);
+        if (limit == 0) {
+            // Disabled: stay at the head so enabling shows new frames only
+            can_ring_cursor_init(&cursor);
+            vTaskDelay(pdMS_TO_TICKS(DEBUG_IDLE_MS));
+            continue;
+        }
+
+        int64_t now = esp_timer_get_time();
+        if (now - window_start >= DEBUG_WINDOW_US) {
+            if (suppressed > 0) {
+                ESP_LOGI(TAG, "%lu frames not logged", suppressed);
+            }
+            window_start = now;
+            budget = limit;
+            suppressed = 0;
+        }
+
+        uint32_t lost;
+        size_t count = can_ring_read(&cursor, batch, DEBUG_BATCH, &lost);
+        suppressed += lost;
+        uint32_t sample = atomic_load(&sample_every);
+        for (size_t i = 0; i < count; i++) {
+            if (++seen < sample) {
+                continue;
+            }
+            seen = 0;
+            if (budget == 0) {
+                suppressed++;
+                continue;
+            }
+            budget--;
+            can_format_message(line, sizeof(line), &batch[i].msg);
+            ESP_LOGI(TAG, "%s", line);
+        }
+        if (count < DEBUG_BATCH) {
+            vTaskDelay(pdMS_TO_TICKS(DEBUG_POLL_MS));
+        }
+    }
+}
+
+esp_err_t can_debug_start(void) {
+    if (xTaskCreate(can_debug_task, "can_debug_task", 3072, NULL, 1, NULL) != pdPASS) {
+        ESP_LOGE(TAG, "Failed to create trace task");
+        return ESP_ERR_NO_MEM;
+    }
+    return ESP_OK;
+}
\ No newline at end of file
@@ -0,0 +1,20 @@
+// can_debug.h
+#ifndef CAN_DEBUG_H
+#define CAN_DEBUG_H
+
+#include <stdint.h>
+#include "esp_err.h"
+
+// Optional console trace of received frames. It runs as its own ring
+// consumer at the lowest priority, so a slow UART never stalls reception.
+
+// Starts the trace task with the rate from CONFIG_CAN_DEBUG_LOG_RATE.
+esp_err_t can_debug_start(void);
+
+// Logs every sample-th frame, at most max_per_sec lines per second; frames
+// over the budget are counted and reported once a second. 0 disables it.
+void can_debug_set(uint32_t max_per_sec, uint32_t sample);
+
+void can_debug_get(uint32_t *max_per_sec, uint32_t *sample);
+
+#endif // CAN_DEBUG_H
\ No newline at end of file
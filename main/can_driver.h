@@ -0,0 +1,32 @@
+// can_driver.h
+#ifndef CAN_DRIVER_H
+#define CAN_DRIVER_H
+
+#include <stdint.h>
+#include "esp_err.h"
+#include "driver/twai.h"
+
+// Controller interface the capture pipeline is written against, so the same
+// receive/buffer/format code runs on the TWAI peripheral and, in the host
+// build, on a simulated bus.
+typedef struct {
+    const char *name;
+
+    // Installs and starts the controller with the given acceptance filter.
+    esp_err_t (*start)(const twai_filter_config_t *filter);
+
+    // Stops and uninstalls the controller.
+    esp_err_t (*stop)(void);
+
+    // Waits up to timeout_ms for a frame. ESP_ERR_TIMEOUT if none arrived.
+    esp_err_t (*receive)(twai_message_t *msg, uint32_t timeout_ms);
+
+    esp_err_t (*transmit)(const twai_message_t *msg, uint32_t timeout_ms);
+
+    esp_err_t (*get_status)(twai_status_info_t *status);
+} can_driver_t;
+
+// TWAI peripheral, 500 kbit/s on GPIO 18 (TX) / 19 (RX)
+extern const can_driver_t can_driver_twai;
+
+#endif // CAN_DRIVER_H
\ No newline at end of file
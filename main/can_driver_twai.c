@@ -0,0 +1,57 @@
+#include "can_driver.h"
+#include "esp_intr_alloc.h"
+#include "esp_log.h"
+#include "freertos/FreeRTOS.h"
+
+#define TAG "TWAI_EXAMPLE"
+// Flash writes of the capture log disable the cache. With the ISR in IRAM
+// (CONFIG_TWAI_ISR_IN_IRAM) frames keep arriving meanwhile, and the queue
+// must hold them until the receive task, also stalled, runs again.
+#define RX_QUEUE_LEN 64
+
+static esp_err_t twai_driver_start(const twai_filter_config_t *f_config) {
+    twai_general_config_t g_config = TWAI_GENERAL_CONFIG_DEFAULT(GPIO_NUM_18, GPIO_NUM_19, TWAI_MODE_NORMAL);
+    twai_timing_config_t t_config = TWAI_TIMING_CONFIG_500KBITS();
+    g_config.rx_queue_len = RX_QUEUE_LEN;
+#ifdef CONFIG_TWAI_ISR_IN_IRAM
+    g_config.intr_flags |= ESP_INTR_FLAG_IRAM;
+#endif
+
+    esp_err_t result = twai_driver_install(&g_config, &t_config, f_config);
+    if (result != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to install TWAI driver: %s", esp_err_to_name(result));
+        return result;
+    }
+
+    result = twai_start();
+    if (result != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to start TWAI driver: %s", esp_err_to_name(result));
+        return result;
+    }
+
+    ESP_LOGI(TAG, "TWAI driver installed and started successfully (code 0x%08lx, mask 0x%08lx, %s filter)",
+             f_config->acceptance_code, f_config->acceptance_mask, f_config->single_filter ? "single" : "dual");
+    return ESP_OK;
+}
+
+static esp_err_t twai_driver_stop(void) {
+    twai_stop();
+    return twai_driver_uninstall();
+}
+
+static esp_err_t twai_driver_receive(twai_message_t *msg, uint32_t timeout_ms) {
+    return twai_receive(msg, pdMS_TO_TICKS(timeout_ms));
+}
+
+static esp_err_t twai_driver_transmit(const twai_message_t *msg, uint32_t timeout_ms) {
+    return twai_transmit(msg, pdMS_TO_TICKS(timeout_ms));
+}
+
+const can_driver_t can_driver_twai = {
+    .name = "twai",
+    .start = twai_driver_start,
+    .stop = twai_driver_stop,
+    .receive = twai_driver_receive,
+    .transmit = twai_driver_transmit,
+    .get_status = twai_get_status_info,
+};
\ No newline at end of file
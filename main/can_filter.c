@@ -0,0 +1,227 @@
+#include "can_filter.h"
+#include "nvs.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define NVS_NAMESPACE "can"
+#define NVS_KEY_FILTERS "filters"
+
+void can_filter_compile(const can_filter_rule_t *rules, size_t count, can_filter_compiled_t *out) {
+    memset(out, 0, sizeof(can_filter_compiled_t));
+    out->accept_all = (count == 0);
+
+    for (size_t i = 0; i < count && i < CAN_FILTER_MAX_RULES; i++) {
+        if (rules[i].extd) {
+            uint32_t mask = rules[i].mask & TWAI_EXTD_ID_MASK;
+            out->ext_mask[out->ext_count] = mask;
+            out->ext_id[out->ext_count] = rules[i].id & mask;
+            out->ext_count++;
+        } else {
+            uint32_t mask = rules[i].mask & TWAI_STD_ID_MASK;
+            uint32_t id = rules[i].id & mask;
+            for (uint32_t x = 0; x <= TWAI_STD_ID_MASK; x++) {
+                if ((x & mask) == id) {
+                    out->std_bitmap[x >> 3] |= 1 << (x & 7);
+                }
+            }
+        }
+    }
+}
+
+// Identifier bits that differ between the rules or are masked out by any of them
+static uint32_t dont_care_bits(const can_filter_rule_t *rules, size_t count, uint32_t id_mask) {
+    uint32_t dc = 0;
+    for (size_t i = 0; i < count; i++) {
+        dc |= (rules[i].id ^ rules[0].id) | ~rules[i].mask;
+    }
+    return dc & id_mask;
+}
+
+static int compare_rule_id(const void *a, const void *b) {
+    uint32_t ia = ((const can_filter_rule_t *)a)->id;
+    uint32_t ib = ((const can_filter_rule_t *)b)->id;
+    return (ia > ib) - (ia < ib);
+}
+
+void can_filter_hw_config(const can_filter_rule_t *rules, size_t count, twai_filter_config_t *out) {
+    twai_filter_config_t accept_all = TWAI_FILTER_CONFIG_ACCEPT_ALL();
+    size_t ext_rules = 0;
+
+    *out = accept_all;
+    if (count == 0 || count > CAN_FILTER_MAX_RULES) {
+        return;
+    }
+    for (size_t i = 0; i < count; i++) {
+        ext_rules += rules[i].extd;
+    }
+
+    if (ext_rules == count) {
+        // Single filter, extended layout: ID[28:0] in bits 31:3, RTR in bit 2
+        uint32_t dc = dont_care_bits(rules, count, TWAI_EXTD_ID_MASK);
+        out->acceptance_code = (rules[0].id & TWAI_EXTD_ID_MASK & ~dc) << 3;
+        out->acceptance_mask = (dc << 3) | 0x7;
+        out->single_filter = true;
+        return;
+    }
+    if (ext_rules != 0) {
+        // Both formats in one list cannot be expressed; software does all the work
+        return;
+    }
+
+    // Standard layout. One filter covers every rule, or the sorted list is
+    // split in two groups for dual filter mode, whichever accepts fewer IDs.
+    can_filter_rule_t sorted[CAN_FILTER_MAX_RULES];
+    memcpy(sorted, rules, count * sizeof(can_filter_rule_t));
+    qsort(sorted, count, sizeof(can_filter_rule_t), compare_rule_id);
+
+    uint32_t single_dc = dont_care_bits(sorted, count, TWAI_STD_ID_MASK);
+    uint32_t best_cost = 1UL << __builtin_popcount(single_dc);
+    size_t best_split = 0;
+    for (size_t split = 1; split < count; split++) {
+        uint32_t dc1 = dont_care_bits(sorted, split, TWAI_STD_ID_MASK);
+        uint32_t dc2 = dont_care_bits(sorted + split, count - split, TWAI_STD_ID_MASK);
+        uint32_t cost = (1UL << __builtin_popcount(dc1)) + (1UL << __builtin_popcount(dc2));
+        if (cost < best_cost) {
+            best_cost = cost;
+            best_split = split;
+        }
+    }
+
+    if (best_split == 0) {
+        // ID in bits 31:21, RTR and data bytes ignored
+        out->acceptance_code = (sorted[0].id & TWAI_STD_ID_MASK & ~single_dc) << 21;
+        out->acceptance_mask = (single_dc << 21) | 0x1FFFFF;
+        out->single_filter = true;
+    } else {
+        // Filter 1: ID in bits 31:21, RTR bit 20, data byte 1 in 19:16 and 3:0.
+        // Filter 2: ID in bits 15:5, RTR bit 4.
+        const can_filter_rule_t *g2 = &sorted[best_split];
+        uint32_t dc1 = dont_care_bits(sorted, best_split, TWAI_STD_ID_MASK);
+        uint32_t dc2 = dont_care_bits(g2, count - best_split, TWAI_STD_ID_MASK);
+        out->acceptance_code = ((sorted[0].id & TWAI_STD_ID_MASK & ~dc1) << 21) |
+                               ((g2->id & TWAI_STD_ID_MASK & ~dc2) << 5);
+        out->acceptance_mask = (dc1 << 21) | (1UL << 20) | (0xFUL << 16) |
+                               (dc2 << 5) | (1UL << 4) | 0xF;
+        out->single_filter = false;
+    }
+}
+
+esp_err_t can_filter_parse(const char *text, can_filter_rule_t *rules, size_t *count) {
+    size_t n = 0;
+    const char *p = text;
+
+    while (*p != '\0') {
+        while (*p == ' ' || *p == ',') {
+            p++;
+        }
+        if (*p == '\0') {
+            break;
+        }
+        if (n >= CAN_FILTER_MAX_RULES) {
+            return ESP_ERR_INVALID_SIZE;
+        }
+
+        char *end;
+        unsigned long id = strtoul(p, &end, 16);
+        if (end == p) {
+            return ESP_ERR_INVALID_ARG;
+        }
+        p = end;
+
+        bool has_mask = false;
+        unsigned long mask = 0;
+        if (*p == '/') {
+            mask = strtoul(p + 1, &end, 16);
+            if (end == p + 1) {
+                return ESP_ERR_INVALID_ARG;
+            }
+            has_mask = true;
+            p = end;
+        }
+
+        bool extd = id > TWAI_STD_ID_MASK;
+        if (*p == 'x' || *p == 'X') {
+            extd = true;
+            p++;
+        }
+        if (*p != '\0' && *p != ',' && *p != ' ') {
+            return ESP_ERR_INVALID_ARG;
+        }
+        if (id > TWAI_EXTD_ID_MASK) {
+            return ESP_ERR_INVALID_ARG;
+        }
+
+        uint32_t id_mask = extd ? TWAI_EXTD_ID_MASK : TWAI_STD_ID_MASK;
+        rules[n].id = id & id_mask;
+        rules[n].mask = has_mask ? (mask & id_mask) : id_mask;
+        rules[n].extd = extd;
+        n++;
+    }
+
+    *count = n;
+    return ESP_OK;
+}
+
+size_t can_filter_format(const can_filter_rule_t *rules, size_t count, char *dst, size_t size) {
+    size_t len = 0;
+
+    if (size == 0) {
+        return 0;
+    }
+    dst[0] = '\0';
+    for (size_t i = 0; i < count; i++) {
+        int n = snprintf(dst + len, size - len, "%s%lX/%lX%s",
+                         i ? "," : "", (unsigned long)rules[i].id, (unsigned long)rules[i].mask,
+                         rules[i].extd ? "x" : "");
+        if (n < 0 || (size_t)n >= size - len) {
+            dst[len] = '\0';
+            break;
+        }
+        len += n;
+    }
+    return len;
+}
+
+esp_err_t can_filter_load(can_filter_rule_t *rules, size_t *count) {
+    nvs_handle_t handle;
+    esp_err_t ret = nvs_open(NVS_NAMESPACE, NVS_READONLY, &handle);
+    if (ret != ESP_OK) {
+        return ret;
+    }
+
+    size_t size = CAN_FILTER_MAX_RULES * sizeof(can_filter_rule_t);
+    ret = nvs_get_blob(handle, NVS_KEY_FILTERS, rules, &size);
+    nvs_close(handle);
+    if (ret != ESP_OK) {
+        return ret;
+    }
+    if (size % sizeof(can_filter_rule_t) != 0) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+
+    *count = size / sizeof(can_filter_rule_t);
+    return ESP_OK;
+}
+
+esp_err_t can_filter_save(const can_filter_rule_t *rules, size_t count) {
+    nvs_handle_t handle;
+    esp_err_t ret = nvs_open(NVS_NAMESPACE, NVS_READWRITE, &handle);
+    if (ret != ESP_OK) {
+        return ret;
+    }
+
+    if (count == 0) {
+        ret = nvs_erase_key(handle, NVS_KEY_FILTERS);
+        if (ret == ESP_ERR_NVS_NOT_FOUND) {
+            ret = ESP_OK;
+        }
+    } else {
+        ret = nvs_set_blob(handle, NVS_KEY_FILTERS, rules, count * sizeof(can_filter_rule_t));
+    }
+    if (ret == ESP_OK) {
+        ret = nvs_commit(handle);
+    }
+    nvs_close(handle);
+    return ret;
+}
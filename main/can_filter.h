@@ -0,0 +1,64 @@
+// can_filter.h
+#ifndef CAN_FILTER_H
+#define CAN_FILTER_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stddef.h>
+#include "esp_err.h"
+#include "driver/twai.h"
+
+#define CAN_FILTER_MAX_RULES 16
+
+// A frame passes a rule when (identifier & mask) == (id & mask) and the
+// frame format matches. An empty rule list accepts every frame.
+typedef struct {
+    uint32_t id;
+    uint32_t mask;
+    bool extd;
+} can_filter_rule_t;
+
+// Rules compiled for the receive path: a bitmap over the 2048 standard
+// identifiers and a short list of extended id/mask pairs.
+typedef struct {
+    bool accept_all;
+    uint8_t std_bitmap[(TWAI_STD_ID_MASK + 1) / 8];
+    uint8_t ext_count;
+    uint32_t ext_id[CAN_FILTER_MAX_RULES];
+    uint32_t ext_mask[CAN_FILTER_MAX_RULES];
+} can_filter_compiled_t;
+
+void can_filter_compile(const can_filter_rule_t *rules, size_t count, can_filter_compiled_t *out);
+
+static inline bool can_filter_match(const can_filter_compiled_t *f, const twai_message_t *msg) {
+    if (f->accept_all) {
+        return true;
+    }
+    if (!msg->extd) {
+        uint32_t id = msg->identifier & TWAI_STD_ID_MASK;
+        return (f->std_bitmap[id >> 3] >> (id & 7)) & 1;
+    }
+    for (int i = 0; i < f->ext_count; i++) {
+        if ((msg->identifier & f->ext_mask[i]) == f->ext_id[i]) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Derives the single or dual hardware acceptance filter that lets through
+// every frame matched by the rules while rejecting as many others as possible.
+void can_filter_hw_config(const can_filter_rule_t *rules, size_t count, twai_filter_config_t *out);
+
+// Parses "ID[/MASK][x],..." (hexadecimal; a trailing x or an ID above 0x7FF
+// selects the extended format). Returns ESP_ERR_INVALID_ARG on bad input.
+esp_err_t can_filter_parse(const char *text, can_filter_rule_t *rules, size_t *count);
+
+// Inverse of can_filter_parse.
+size_t can_filter_format(const can_filter_rule_t *rules, size_t count, char *dst, size_t size);
+
+// Rule list persisted in NVS.
+esp_err_t can_filter_load(can_filter_rule_t *rules, size_t *count);
+esp_err_t can_filter_save(const can_filter_rule_t *rules, size_t count);
+
+#endif // CAN_FILTER_H
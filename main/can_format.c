@@ -0,0 +1,109 @@
+#include "can_format.h"
+#include <stdio.h>
+#include <string.h>
+
+#define HEX_ROW(h) \
+    {h, '0'}, {h, '1'}, {h, '2'}, {h, '3'}, {h, '4'}, {h, '5'}, {h, '6'}, {h, '7'}, \
+    {h, '8'}, {h, '9'}, {h, 'a'}, {h, 'b'}, {h, 'c'}, {h, 'd'}, {h, 'e'}, {h, 'f'}
+
+// Both digits of every byte value, so a byte costs one table load and a
+// two-character copy
+static const char hex_pairs[256][2] = {
+    HEX_ROW('0'), HEX_ROW('1'), HEX_ROW('2'), HEX_ROW('3'),
+    HEX_ROW('4'), HEX_ROW('5'), HEX_ROW('6'), HEX_ROW('7'),
+    HEX_ROW('8'), HEX_ROW('9'), HEX_ROW('a'), HEX_ROW('b'),
+    HEX_ROW('c'), HEX_ROW('d'), HEX_ROW('e'), HEX_ROW('f'),
+};
+
+static inline char *put_text(char *p, const char *text, size_t len) {
+    memcpy(p, text, len);
+    return p + len;
+}
+
+static inline char *put_byte(char *p, uint8_t value) {
+    p[0] = hex_pairs[value][0];
+    p[1] = hex_pairs[value][1];
+    return p + 2;
+}
+
+char *can_format_hex(char *dst, const uint8_t *data, size_t len) {
+    for (size_t i = 0; i < len; i++) {
+        dst = put_byte(dst, data[i]);
+    }
+    return dst;
+}
+
+// Same text as "ID: 0x%lx, DLC: %d, Data: 0x%02x 0x%02x ..." with all eight data bytes
+static char *format_message(char *p, const twai_message_t *msg) {
+    uint32_t id = msg->identifier;
+    int shift = 28;
+    while (shift > 0 && (id >> shift) == 0) {
+        shift -= 4;
+    }
+
+    p = put_text(p, "ID: 0x", 6);
+    for (; shift >= 0; shift -= 4) {
+        *p++ = hex_pairs[(id >> shift) & 0x0f][1];
+    }
+
+    p = put_text(p, ", DLC: ", 7);
+    uint8_t dlc = msg->data_length_code;
+    if (dlc >= 100) {
+        *p++ = '0' + dlc / 100;
+    }
+    if (dlc >= 10) {
+        *p++ = '0' + dlc / 10 % 10;
+    }
+    *p++ = '0' + dlc % 10;
+
+    p = put_text(p, ", Data: ", 8);
+    for (int i = 0; i < TWAI_FRAME_MAX_DLC; i++) {
+        p = put_text(p, i ? " 0x" : "0x", i ? 3 : 2);
+        p = put_byte(p, msg->data[i]);
+    }
+    return p;
+}
+
+int can_format_message(char *dst, size_t size, const twai_message_t *msg) {
+    if (size == 0) {
+        return 0;
+    }
+    if (size >= CAN_FORMAT_MESSAGE_MAX) {
+        char *end = format_message(dst, msg);
+        *end = '\0';
+        return end - dst;
+    }
+
+    // Short buffer: format aside and truncate like snprintf
+    char text[CAN_FORMAT_MESSAGE_MAX];
+    size_t len = format_message(text, msg) - text;
+    if (len > size - 1) {
+        len = size - 1;
+    }
+    memcpy(dst, text, len);
+    dst[len] = '\0';
+    return len;
+}
+
+int can_format_candump(char *dst, size_t size, int64_t timestamp_us, const twai_message_t *msg) {
+    static const char hex_digits[] = "0123456789ABCDEF";
+    if (size < CAN_FORMAT_CANDUMP_MAX) {
+        return 0;
+    }
+
+    int len = snprintf(dst, size, msg->extd ? "(%lld.%06lld) can0 %08lX#" : "(%lld.%06lld) can0 %03lX#",
+                       (long long)(timestamp_us / 1000000), (long long)(timestamp_us % 1000000),
+                       (unsigned long)msg->identifier);
+    if (msg->rtr) {
+        dst[len++] = 'R';
+    } else {
+        int dlc = msg->data_length_code > TWAI_FRAME_MAX_DLC ? TWAI_FRAME_MAX_DLC : msg->data_length_code;
+        for (int i = 0; i < dlc; i++) {
+            dst[len++] = hex_digits[msg->data[i] >> 4];
+            dst[len++] = hex_digits[msg->data[i] & 0x0f];
+        }
+    }
+    dst[len++] = '\n';
+    dst[len] = '\0';
+    return len;
+}
\ No newline at end of file
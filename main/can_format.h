@@ -0,0 +1,28 @@
+// can_format.h
+#ifndef CAN_FORMAT_H
+#define CAN_FORMAT_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "driver/twai.h"
+
+// Longest text can_format_message produces, terminator included.
+#define CAN_FORMAT_MESSAGE_MAX 72
+
+// Formats a frame as "ID: 0x..., DLC: n, Data: 0x.. ..." without going
+// through printf. Writes at most size - 1 characters plus a terminator and
+// returns the number of characters written.
+int can_format_message(char *dst, size_t size, const twai_message_t *msg);
+
+// Longest line can_format_candump produces, terminator included.
+#define CAN_FORMAT_CANDUMP_MAX 64
+
+// Formats a frame as a candump -l line, "(sec.usec) can0 ID#DATA\n".
+// Returns the number of characters written, 0 if size is too small.
+int can_format_candump(char *dst, size_t size, int64_t timestamp_us, const twai_message_t *msg);
+
+// Writes two lowercase hex digits per byte, no separator and no terminator.
+// Returns the end of the written text.
+char *can_format_hex(char *dst, const uint8_t *data, size_t len);
+
+#endif // CAN_FORMAT_H
\ No newline at end of file
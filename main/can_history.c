@@ -0,0 +1,493 @@
+#include "can_history.h"
+#include "can_format.h"
+#include "esp_log.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include <string.h>
+
+#define TAG "CAN_HISTORY"
+#define DICT_HASH_SIZE 256     // Power of two, twice the dictionary
+#define KEY_EXTD 0x80000000u
+#define RECORD_MAX (1 + 4 + 1 + 5 + TWAI_FRAME_MAX_DLC)   // Literal with the longest delta
+
+typedef struct {
+    uint32_t ticks;            // First frame's time since the previous block's first frame
+    uint32_t ids[2];           // Dictionary entries present, bit index % 64
+    uint16_t seq_gap;          // Sequence numbers skipped since the end of the previous block
+    uint16_t used;             // Bytes written
+    uint16_t count;
+} block_info_t;
+
+// DLC byte and payload of a reference frame, which the next frame of the
+// dictionary entry is encoded against.
+typedef struct {
+    uint8_t dlc_byte;
+    uint8_t data[TWAI_FRAME_MAX_DLC];
+} id_state_t;
+
+// CONFIG_CAN_HISTORY_SIZE_KB covers the blocks, their index, the dictionary
+// and the per-entry state
+#define STATE_BYTES \
+    (CAN_HISTORY_DICT_SIZE * (sizeof(uint32_t) + 2 * sizeof(id_state_t)) + DICT_HASH_SIZE + 4 * sizeof(uint32_t))
+#define HISTORY_BLOCKS \
+    ((CONFIG_CAN_HISTORY_SIZE_KB * 1024 - STATE_BYTES) / (CAN_HISTORY_BLOCK_SIZE + sizeof(block_info_t)))
+
+_Static_assert(CONFIG_CAN_HISTORY_SIZE_KB * 1024 >= STATE_BYTES + 2 * (CAN_HISTORY_BLOCK_SIZE + sizeof(block_info_t)),
+               "CAN_HISTORY_SIZE_KB too small");
+_Static_assert(CAN_HISTORY_DICT_SIZE <= 32 * 4, "seen sets too small");
+
+typedef struct {
+    const uint8_t *p;
+    const uint8_t *end;
+    uint32_t seq;
+    int64_t tick;               // Of the last frame decoded
+    uint32_t seen[4];           // Dictionary entries met so far in the block
+} block_reader_t;
+
+static uint8_t blocks[HISTORY_BLOCKS][CAN_HISTORY_BLOCK_SIZE];
+static block_info_t info[HISTORY_BLOCKS];
+static int head = -1;                       // Block being written
+static int block_count = 0;
+static uint32_t last_tick;                  // Of the last frame written, since the block's first
+
+// Blocks only hold their distance from the previous one; these anchor the
+// chain at both ends.
+static uint32_t oldest_seq;
+static int64_t oldest_tick;                 // Of the first frame, in CAN_HISTORY_TICK_US units
+static uint32_t head_seq;
+static int64_t head_tick;
+
+// Identifiers get a dictionary index on first sight and keep it; once the
+// dictionary is full, new identifiers are written in full. The frame that
+// created an entry is the reference of the entry's first frame in a block.
+static uint32_t dict[CAN_HISTORY_DICT_SIZE];
+static id_state_t dict_ref[CAN_HISTORY_DICT_SIZE];
+static int dict_count = 0;
+static uint8_t dict_hash[DICT_HASH_SIZE];   // Index + 1, 0 for an empty slot
+
+// Last frame of each entry in the block being written or decoded. Shared by
+// the writer and the decoder; once a decoder has used it, the writer
+// rebuilds it from the head block before the next append.
+static id_state_t id_states[CAN_HISTORY_DICT_SIZE];
+static uint32_t head_seen[4];               // Entries present in the head block
+static bool head_states_valid = true;
+
+static SemaphoreHandle_t can_buffer_mutex;
+
+esp_err_t can_history_init(void) {
+    can_buffer_mutex = xSemaphoreCreateMutex();
+    if (can_buffer_mutex == NULL) {
+        ESP_LOGE(TAG, "Failed to create CAN buffer mutex");
+        return ESP_ERR_NO_MEM;
+    }
+    return ESP_OK;
+}
+
+static uint32_t frame_key(uint32_t identifier, bool extd) {
+    return identifier | (extd ? KEY_EXTD : 0);
+}
+
+static unsigned dict_slot(uint32_t key) {
+    return (key * 2654435761u) >> 24;
+}
+
+static int dict_find(uint32_t key) {
+    for (unsigned h = dict_slot(key);; h = (h + 1) & (DICT_HASH_SIZE - 1)) {
+        if (dict_hash[h] == 0) {
+            return -(int)h - 1;
+        }
+        if (dict[dict_hash[h] - 1] == key) {
+            return dict_hash[h] - 1;
+        }
+    }
+}
+
+static int dict_index(uint32_t key, uint8_t dlc_byte, const uint8_t *data) {
+    int index = dict_find(key);
+    if (index >= 0) {
+        return index;
+    }
+    if (dict_count == CAN_HISTORY_DICT_SIZE) {
+        return CAN_HISTORY_LITERAL;
+    }
+    dict[dict_count] = key;
+    dict_ref[dict_count].dlc_byte = dlc_byte;
+    memcpy(dict_ref[dict_count].data, data, TWAI_FRAME_MAX_DLC);
+    dict_hash[-index - 1] = dict_count + 1;
+    return dict_count++;
+}
+
+static bool seen_get(const uint32_t *seen, int index) {
+    return seen[index / 32] & (1u << (index % 32));
+}
+
+static void seen_set(uint32_t *seen, int index) {
+    seen[index / 32] |= 1u << (index % 32);
+}
+
+static int oldest_block(void) {
+    return (head - block_count + 1 + HISTORY_BLOCKS) % HISTORY_BLOCKS;
+}
+
+static void open_block(uint32_t seq, int64_t tick) {
+    if (block_count > 0) {
+        uint32_t end = head_seq + info[head].count;
+        if (seq - end > UINT16_MAX || tick < head_tick || tick - head_tick > UINT32_MAX) {
+            block_count = 0;    // Too far from the previous block to be chained to it
+        }
+    }
+
+    int next = (head + 1) % HISTORY_BLOCKS;
+    if (block_count == HISTORY_BLOCKS) {
+        // next is the oldest block: the one after it takes over as the anchor
+        int after = (next + 1) % HISTORY_BLOCKS;
+        oldest_seq += info[next].count + info[after].seq_gap;
+        oldest_tick += info[after].ticks;
+    }
+
+    block_info_t *b = &info[next];
+    memset(b, 0, sizeof(block_info_t));
+    if (block_count == 0) {
+        oldest_seq = seq;
+        oldest_tick = tick;
+    } else {
+        b->seq_gap = seq - (head_seq + info[head].count);
+        b->ticks = tick - head_tick;
+    }
+    if (block_count < HISTORY_BLOCKS) {
+        block_count++;
+    }
+    head = next;
+    head_seq = seq;
+    head_tick = tick;
+    last_tick = 0;
+    memset(head_seen, 0, sizeof(head_seen));
+}
+
+// Encodes the frame as the next record of the head block, against the
+// entry's previous frame in the block or, for its first one, the entry's
+// reference frame. Returns the size.
+static size_t encode_record(uint8_t *rec, const twai_message_t *msg, uint32_t key, int index, uint8_t dlc_byte,
+                            uint32_t delta) {
+    int dlc = dlc_byte & 0x0f;
+    uint8_t *p = rec;
+    const id_state_t *prev = NULL;
+    if (index != CAN_HISTORY_LITERAL) {
+        prev = seen_get(head_seen, index) ? &id_states[index] : &dict_ref[index];
+    }
+
+    if (index == CAN_HISTORY_LITERAL) {
+        *p++ = CAN_HISTORY_LITERAL | CAN_HISTORY_KEY_DLC;
+        memcpy(p, &key, 4);
+        p += 4;
+        *p++ = dlc_byte;
+    } else {
+        if (dlc_byte == prev->dlc_byte) {
+            *p++ = index;
+        } else {
+            *p++ = index | CAN_HISTORY_KEY_DLC;
+            *p++ = dlc_byte;
+        }
+    }
+    while (delta >= 0x80) {
+        *p++ = delta | 0x80;
+        delta >>= 7;
+    }
+    *p++ = delta;
+
+    if (msg->rtr) {
+        return p - rec;
+    }
+    if (prev != NULL && dlc > 0 && dlc_byte == prev->dlc_byte) {
+        uint8_t *mask = p++;
+        *mask = 0;
+        for (int i = 0; i < dlc; i++) {
+            if (msg->data[i] != prev->data[i]) {
+                *mask |= 1u << i;
+                *p++ = msg->data[i];
+            }
+        }
+    } else {
+        memcpy(p, msg->data, dlc);
+        p += dlc;
+    }
+    return p - rec;
+}
+
+static void append(const can_frame_record_t *record) {
+    const twai_message_t *msg = &record->msg;
+    uint32_t key = frame_key(msg->identifier, msg->extd);
+    int dlc = msg->data_length_code > TWAI_FRAME_MAX_DLC ? TWAI_FRAME_MAX_DLC : msg->data_length_code;
+    uint8_t dlc_byte = dlc | (msg->rtr ? CAN_HISTORY_DLC_RTR : 0);
+    int index = dict_index(key, dlc_byte, msg->data);
+
+    // Times are kept in CAN_HISTORY_TICK_US units, deltas adding up to the
+    // exact tick of each frame however many there are.
+    uint8_t rec[RECORD_MAX];
+    size_t size = 0;
+    int64_t tick = record->timestamp_us / CAN_HISTORY_TICK_US;
+    block_info_t *b = block_count > 0 ? &info[head] : NULL;
+    if (b != NULL && record->seq == head_seq + b->count && tick >= head_tick + last_tick &&
+        tick - head_tick <= UINT32_MAX) {
+        size = encode_record(rec, msg, key, index, dlc_byte, tick - head_tick - last_tick);
+    }
+    if (size == 0 || b->used + size > CAN_HISTORY_BLOCK_SIZE) {
+        open_block(record->seq, tick);
+        b = &info[head];
+        size = encode_record(rec, msg, key, index, dlc_byte, 0);
+    }
+
+    memcpy(&blocks[head][b->used], rec, size);
+    b->used += size;
+    b->count++;
+    b->ids[(index % 64) / 32] |= 1u << (index % 32);
+    last_tick = tick - head_tick;
+    if (index != CAN_HISTORY_LITERAL) {
+        id_states[index].dlc_byte = dlc_byte;
+        memcpy(id_states[index].data, msg->data, TWAI_FRAME_MAX_DLC);
+        seen_set(head_seen, index);
+    }
+}
+
+static void reader_init(block_reader_t *r, int block, uint32_t seq, int64_t tick) {
+    r->p = blocks[block];
+    r->end = blocks[block] + info[block].used;
+    r->seq = seq;
+    r->tick = tick;
+    memset(r->seen, 0, sizeof(r->seen));
+}
+
+// Decodes the record at r->p into out and returns its sequence number
+static uint32_t reader_next(block_reader_t *r, can_frame_record_t *out) {
+    twai_message_t *msg = &out->msg;
+    uint8_t key = *r->p++;
+    int index = key & CAN_HISTORY_LITERAL;
+    const id_state_t *prev = NULL;
+    uint32_t id_key;
+    uint8_t dlc_byte;
+
+    if (index == CAN_HISTORY_LITERAL) {
+        memcpy(&id_key, r->p, 4);
+        r->p += 4;
+    } else {
+        id_key = dict[index];
+        prev = seen_get(r->seen, index) ? &id_states[index] : &dict_ref[index];
+    }
+    if (key & CAN_HISTORY_KEY_DLC) {
+        dlc_byte = *r->p++;
+    } else {
+        dlc_byte = prev->dlc_byte;
+    }
+    uint32_t delta = 0;
+    for (int shift = 0;; shift += 7) {
+        uint8_t b = *r->p++;
+        delta |= (uint32_t)(b & 0x7f) << shift;
+        if (!(b & 0x80)) {
+            break;
+        }
+    }
+    r->tick += delta;
+
+    memset(msg, 0, sizeof(twai_message_t));
+    msg->identifier = id_key & ~KEY_EXTD;
+    msg->extd = (id_key & KEY_EXTD) != 0;
+    msg->rtr = (dlc_byte & CAN_HISTORY_DLC_RTR) != 0;
+    msg->data_length_code = dlc_byte & 0x0f;
+    if (msg->rtr) {
+        // No payload
+    } else if (prev != NULL && msg->data_length_code > 0 && dlc_byte == prev->dlc_byte) {
+        uint8_t mask = *r->p++;
+        for (int i = 0; i < msg->data_length_code; i++) {
+            msg->data[i] = (mask & (1u << i)) ? *r->p++ : prev->data[i];
+        }
+    } else {
+        memcpy(msg->data, r->p, msg->data_length_code);
+        r->p += msg->data_length_code;
+    }
+    if (index != CAN_HISTORY_LITERAL) {
+        id_states[index].dlc_byte = dlc_byte;
+        memcpy(id_states[index].data, msg->data, TWAI_FRAME_MAX_DLC);
+        seen_set(r->seen, index);
+    }
+    out->timestamp_us = r->tick * CAN_HISTORY_TICK_US;
+    out->seq = r->seq;
+    return r->seq++;
+}
+
+// Brings id_states back to the end of the head block
+static void rebuild_head_states(void) {
+    block_reader_t r;
+    can_frame_record_t record;
+    reader_init(&r, head, head_seq, head_tick);
+    while (r.p < r.end) {
+        reader_next(&r, &record);
+    }
+    memcpy(head_seen, r.seen, sizeof(head_seen));
+    head_states_valid = true;
+}
+
+void add_can_messages(const can_frame_record_t *records, size_t count) {
+    xSemaphoreTake(can_buffer_mutex, portMAX_DELAY);
+    if (!head_states_valid && block_count > 0) {
+        rebuild_head_states();
+    }
+    for (size_t i = 0; i < count; i++) {
+        append(&records[i]);
+    }
+    xSemaphoreGive(can_buffer_mutex);
+}
+
+static uint32_t history_end(void) {
+    return block_count > 0 ? head_seq + info[head].count : 0;
+}
+
+void can_history_cursor_init(can_history_cursor_t *cursor) {
+    xSemaphoreTake(can_buffer_mutex, portMAX_DELAY);
+    memset(cursor, 0, sizeof(can_history_cursor_t));
+    cursor->end = history_end();
+    cursor->next = block_count > 0 ? oldest_seq : cursor->end;
+    xSemaphoreGive(can_buffer_mutex);
+}
+
+void can_history_cursor_init_query(can_history_cursor_t *cursor, uint32_t identifier, bool extd, uint32_t since) {
+    can_history_cursor_init(cursor);
+    cursor->filtered = true;
+    cursor->identifier = identifier;
+    cursor->extd = extd;
+    if ((int32_t)(since - cursor->next) > 0) {
+        cursor->next = since;
+    }
+}
+
+// Whether frames of the cursor's identifier may be in the block
+static bool block_matches(const block_info_t *b, int index) {
+    return index >= 0 && (b->ids[(index % 64) / 32] & (1u << (index % 32)));
+}
+
+// Calls emit for each frame following the cursor until it returns false or
+// the export is complete. Runs under the lock. A block is decoded from its
+// start, so the frames before the cursor are decoded and skipped.
+static void history_walk(can_history_cursor_t *cursor, bool (*emit)(const can_frame_record_t *, void *), void *ctx) {
+    int index = CAN_HISTORY_LITERAL;
+    if (cursor->filtered) {
+        index = dict_find(frame_key(cursor->identifier, cursor->extd));
+        if (index < 0 && dict_count < CAN_HISTORY_DICT_SIZE) {
+            index = -1;     // Never seen: no block can hold it
+        } else if (index < 0) {
+            index = CAN_HISTORY_LITERAL;
+        }
+    }
+
+    uint32_t first_seq = oldest_seq;
+    int64_t first_tick = oldest_tick;
+    head_states_valid = false;
+    for (int n = 0, block = oldest_block(); n < block_count; n++, block = (block + 1) % HISTORY_BLOCKS) {
+        const block_info_t *b = &info[block];
+        if (n > 0) {
+            first_seq += b->seq_gap;
+            first_tick += b->ticks;
+        }
+        uint32_t block_end = first_seq + b->count;
+        if ((int32_t)(cursor->end - cursor->next) <= 0) {
+            return;
+        }
+        if ((int32_t)(block_end - cursor->next) <= 0) {
+            first_seq = block_end;
+            continue;
+        }
+        if ((int32_t)(first_seq - cursor->next) > 0) {
+            cursor->next = first_seq;       // Dropped, or never stored
+        }
+        if (cursor->filtered && !block_matches(b, index)) {
+            cursor->next = block_end;
+            first_seq = block_end;
+            continue;
+        }
+
+        block_reader_t r;
+        can_frame_record_t record;
+        reader_init(&r, block, first_seq, first_tick);
+        first_seq = block_end;
+        while (r.p < r.end && (int32_t)(cursor->end - r.seq) > 0) {
+            uint32_t seq = reader_next(&r, &record);
+            if ((int32_t)(seq - cursor->next) < 0) {
+                continue;
+            }
+            if (!cursor->filtered || (record.msg.identifier == cursor->identifier && record.msg.extd == cursor->extd)) {
+                if (!emit(&record, ctx)) {
+                    return;
+                }
+            }
+            cursor->next = seq + 1;
+        }
+    }
+    cursor->next = cursor->end;
+}
+
+typedef struct {
+    can_frame_record_t *out;
+    size_t max;
+    size_t count;
+} frames_ctx_t;
+
+static bool emit_frame(const can_frame_record_t *record, void *arg) {
+    frames_ctx_t *ctx = arg;
+    if (ctx->count == ctx->max) {
+        return false;
+    }
+    ctx->out[ctx->count++] = *record;
+    return true;
+}
+
+size_t can_history_read_frames(can_history_cursor_t *cursor, can_frame_record_t *out, size_t max) {
+    frames_ctx_t ctx = { .out = out, .max = max, .count = 0 };
+
+    xSemaphoreTake(can_buffer_mutex, portMAX_DELAY);
+    history_walk(cursor, emit_frame, &ctx);
+    xSemaphoreGive(can_buffer_mutex);
+    return ctx.count;
+}
+
+typedef struct {
+    const char *separator;
+    size_t sep_len;
+    char *dst;
+    size_t size;
+    size_t len;
+} text_ctx_t;
+
+static bool emit_text(const can_frame_record_t *record, void *arg) {
+    text_ctx_t *ctx = arg;
+    if (ctx->len + CAN_FORMAT_MESSAGE_MAX + ctx->sep_len >= ctx->size) {
+        return false;
+    }
+    ctx->len += can_format_message(ctx->dst + ctx->len, CAN_FORMAT_MESSAGE_MAX, &record->msg);
+    memcpy(ctx->dst + ctx->len, ctx->separator, ctx->sep_len);
+    ctx->len += ctx->sep_len;
+    return true;
+}
+
+size_t can_history_read(can_history_cursor_t *cursor, const char *separator, char *dst, size_t size) {
+    text_ctx_t ctx = { .separator = separator, .sep_len = strlen(separator), .dst = dst, .size = size, .len = 0 };
+
+    xSemaphoreTake(can_buffer_mutex, portMAX_DELAY);
+    history_walk(cursor, emit_text, &ctx);
+    xSemaphoreGive(can_buffer_mutex);
+
+    dst[ctx.len] = '\0';
+    return ctx.len;
+}
+
+void can_history_get_usage(can_history_usage_t *usage) {
+    memset(usage, 0, sizeof(can_history_usage_t));
+    xSemaphoreTake(can_buffer_mutex, portMAX_DELAY);
+    for (int n = 0, block = oldest_block(); n < block_count; n++, block = (block + 1) % HISTORY_BLOCKS) {
+        usage->frames += info[block].count;
+        usage->bytes += info[block].used;
+    }
+    usage->capacity = sizeof(blocks);
+    usage->ram = sizeof(blocks) + sizeof(info) + sizeof(dict) + sizeof(dict_ref) + sizeof(dict_hash) +
+                 sizeof(id_states) + sizeof(head_seen);
+    usage->identifiers = dict_count;
+    xSemaphoreGive(can_buffer_mutex);
+}
\ No newline at end of file
@@ -0,0 +1,90 @@
+// can_history.h
+#ifndef CAN_HISTORY_H
+#define CAN_HISTORY_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stddef.h>
+#include "esp_err.h"
+#include "can_ring.h"
+#include "can_format.h"
+
+// History of the most recent frames, sent to clients on request. Frames are
+// kept compactly encoded in CAN_HISTORY_BLOCK_SIZE blocks, the oldest block
+// being dropped whole when the store is full. Each block is a sequence of
+// records:
+//
+//   u8      key          bits 0-6 dictionary index of the identifier, or
+//                        CAN_HISTORY_LITERAL; bit 7 set when the DLC byte follows
+//   u32     identifier   only for CAN_HISTORY_LITERAL, bit 31 extended
+//   u8      dlc          bits 0-3 DLC, bit 4 RTR; present for a literal and
+//                        when the DLC differs from the reference frame's
+//   varint  delta        LEB128 time since the previous frame of the block,
+//                        in CAN_HISTORY_TICK_US units
+//   u8      mask         bit n set when data byte n differs from the
+//                        reference frame; only for a dictionary identifier
+//                        with data and the reference frame's DLC
+//   u8      data[]       the bytes flagged in mask, all DLC bytes without
+//                        one, none for remote frames
+//
+// The reference frame is the identifier's previous frame in the block, or
+// for its first one there the frame that created its dictionary entry.
+// Dictionary entries are never reassigned, so a block can be decoded on its
+// own. A per-block index keeps its distance in sequence numbers and time
+// from the previous block and a summary of the identifiers present. Frames
+// 100 to 1000 us apart take one byte of delta; timestamps read back are
+// rounded down to CAN_HISTORY_TICK_US. CONFIG_CAN_HISTORY_SIZE_KB is the
+// RAM for the blocks, the index, the dictionary and the reference frames.
+#define CAN_HISTORY_BLOCK_SIZE 512
+#define CAN_HISTORY_TICK_US 8
+#define CAN_HISTORY_DICT_SIZE 127
+#define CAN_HISTORY_LITERAL 0x7f
+#define CAN_HISTORY_KEY_DLC 0x80
+#define CAN_HISTORY_DLC_RTR 0x10
+
+// Export position. Covers the frames present when it was initialised;
+// frames dropped while the export runs are skipped.
+typedef struct {
+    uint32_t next;              // Sequence number of the next frame
+    uint32_t end;
+    bool filtered;              // Only frames with this identifier
+    bool extd;
+    uint32_t identifier;
+} can_history_cursor_t;
+
+typedef struct {
+    uint32_t frames;
+    uint32_t bytes;             // Encoded size of those frames
+    uint32_t capacity;          // Bytes of block storage
+    uint32_t ram;               // Bytes of RAM in total: blocks, index and dictionary
+    uint32_t identifiers;       // Dictionary entries in use
+} can_history_usage_t;
+
+esp_err_t can_history_init(void);
+
+// Appends a batch of frames under a single lock.
+void add_can_messages(const can_frame_record_t *records, size_t count);
+
+// Whole history.
+void can_history_cursor_init(can_history_cursor_t *cursor);
+
+// Frames with one identifier from sequence number since on. Blocks that do
+// not hold the identifier are skipped without being decoded.
+void can_history_cursor_init_query(can_history_cursor_t *cursor, uint32_t identifier, bool extd, uint32_t since);
+
+// Decodes up to max frames following the cursor into out. Returns the
+// number written, 0 once the export is complete.
+size_t can_history_read_frames(can_history_cursor_t *cursor, can_frame_record_t *out, size_t max);
+
+// Formats the next frames as text lines, each followed by separator, for as
+// long as a whole line fits in dst. The lock is held for this chunk only.
+// dst must hold CAN_HISTORY_CHUNK_MIN bytes. Returns the number of
+// characters written, 0 once the export is complete.
+size_t can_history_read(can_history_cursor_t *cursor, const char *separator, char *dst, size_t size);
+
+void can_history_get_usage(can_history_usage_t *usage);
+
+#define CAN_HISTORY_SEPARATOR_MAX 8
+#define CAN_HISTORY_CHUNK_MIN (CAN_FORMAT_MESSAGE_MAX + CAN_HISTORY_SEPARATOR_MAX)
+
+#endif // CAN_HISTORY_H
\ No newline at end of file
@@ -0,0 +1,358 @@
+#include "can_log.h"
+#include "can_ring.h"
+#include "storage.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+#include <dirent.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define TAG "CAN_LOG"
+#define SEGMENT_BYTES (CONFIG_CAN_LOG_SEGMENT_KB * 1024)
+#define SEGMENT_PREFIX "SEG"
+#define SEGMENT_SUFFIX ".BIN"
+#define PACK_BATCH 32
+#define PACK_IDLE_MS 10
+#define LOG_BUFFERS 2
+#define DOWNLOAD_WAIT_MS 100
+#define OPEN_RETRY_MS 5000
+
+typedef struct {
+    uint8_t index;              // Into page_buffers
+    uint16_t len;
+} log_page_t;
+
+// Pages are filled by the packer and handed to the writer through full_pages;
+// the writer returns them through free_pages once they are on flash.
+static uint8_t page_buffers[LOG_BUFFERS][CAN_LOG_PAGE_SIZE];
+static QueueHandle_t free_pages;
+static QueueHandle_t full_pages;
+static SemaphoreHandle_t segments_mutex;
+
+static uint32_t oldest_segment;
+static uint32_t active_segment;
+static bool have_segments;
+static FILE *active_file;
+static uint32_t active_size;
+static int64_t open_retry_us;  // No new segment attempt before this after a failure
+static uint32_t dropped_pages;
+static atomic_uint_least32_t lost_frames;
+static FILE *download_file;     // Segment open for download, rotation waits for it
+static uint32_t download_segment;
+
+static void segment_path(uint32_t index, char *dst, size_t size) {
+    snprintf(dst, size, STORAGE_BASE_PATH "/" SEGMENT_PREFIX "%05lu" SEGMENT_SUFFIX, (unsigned long)index);
+}
+
+static bool parse_segment_name(const char *name, uint32_t *index) {
+    unsigned long value;
+    char suffix[8];
+    if (sscanf(name, SEGMENT_PREFIX "%5lu%7s", &value, suffix) != 2 || strcasecmp(suffix, SEGMENT_SUFFIX) != 0) {
+        return false;
+    }
+    *index = value;
+    return true;
+}
+
+static void scan_segments(void) {
+    DIR *dir = opendir(STORAGE_BASE_PATH);
+    if (dir == NULL) {
+        return;
+    }
+
+    struct dirent *entry;
+    while ((entry = readdir(dir)) != NULL) {
+        uint32_t index;
+        if (!parse_segment_name(entry->d_name, &index)) {
+            continue;
+        }
+        if (!have_segments || index < oldest_segment) {
+            oldest_segment = index;
+        }
+        if (!have_segments || index > active_segment) {
+            active_segment = index;
+        }
+        have_segments = true;
+    }
+    closedir(dir);
+}
+
+// Starts the next segment, deleting the oldest ones until it fits.
+// Called with segments_mutex held.
+static esp_err_t open_next_segment(void) {
+    char path[32];
+
+    if (active_file != NULL) {
+        fclose(active_file);
+        active_file = NULL;
+    }
+    // The index only advances once the file exists, so failures leave no gaps
+    uint32_t next = have_segments ? active_segment + 1 : 0;
+
+    uint64_t total, free_bytes;
+    while (have_segments && oldest_segment < next &&
+           storage_info(&total, &free_bytes) == ESP_OK && free_bytes < 2 * SEGMENT_BYTES) {
+        if (download_file != NULL && download_segment == oldest_segment) {
+            // Frames arriving meanwhile wait in the ring, or are counted as lost
+            xSemaphoreGive(segments_mutex);
+            vTaskDelay(pdMS_TO_TICKS(DOWNLOAD_WAIT_MS));
+            xSemaphoreTake(segments_mutex, portMAX_DELAY);
+            continue;
+        }
+        segment_path(oldest_segment, path, sizeof(path));
+        unlink(path);
+        ESP_LOGI(TAG, "Deleted %s to make room", path);
+        oldest_segment++;
+    }
+
+    segment_path(next, path, sizeof(path));
+    active_file = fopen(path, "wb");
+    if (active_file == NULL) {
+        ESP_LOGE(TAG, "Failed to create %s, retrying in %d ms", path, OPEN_RETRY_MS);
+        open_retry_us = esp_timer_get_time() + OPEN_RETRY_MS * 1000LL;
+        return ESP_FAIL;
+    }
+    if (!have_segments) {
+        oldest_segment = next;
+        have_segments = true;
+    }
+    active_segment = next;
+    active_size = 0;
+    if (dropped_pages > 0) {
+        ESP_LOGW(TAG, "Dropped %lu pages while no segment was open", (unsigned long)dropped_pages);
+        dropped_pages = 0;
+    }
+    ESP_LOGI(TAG, "Logging to %s", path);
+    return ESP_OK;
+}
+
+// Low priority, so the receive and packer tasks run between page writes.
+// Writes and erases still disable the cache and stall every task while
+// they last; the TWAI ISR runs from IRAM and the driver queue holds the
+// frames received meanwhile (see can_driver_twai.c).
+static void log_writer_task(void *arg) {
+    log_page_t page;
+
+    while (1) {
+        xQueueReceive(full_pages, &page, portMAX_DELAY);
+
+        xSemaphoreTake(segments_mutex, portMAX_DELAY);
+        if ((active_file == NULL && esp_timer_get_time() >= open_retry_us) ||
+            (active_file != NULL && active_size + page.len > SEGMENT_BYTES)) {
+            open_next_segment();
+        }
+        if (active_file != NULL) {
+            size_t written = fwrite(page_buffers[page.index], 1, page.len, active_file);
+            fflush(active_file);
+            fsync(fileno(active_file));
+            active_size += written;
+            if (written != page.len) {
+                ESP_LOGE(TAG, "Short write on segment %lu", (unsigned long)active_segment);
+            }
+        } else {
+            dropped_pages++;
+        }
+        xSemaphoreGive(segments_mutex);
+
+        xQueueSend(free_pages, &page, portMAX_DELAY);
+    }
+}
+
+static inline void put_record_header(uint8_t *p, uint8_t kind, uint32_t delta_us, uint32_t identifier) {
+    p[0] = kind;
+    p[1] = delta_us;
+    p[2] = delta_us >> 8;
+    p[3] = delta_us >> 16;
+    p[4] = identifier;
+    p[5] = identifier >> 8;
+    p[6] = identifier >> 16;
+    p[7] = identifier >> 24;
+}
+
+typedef struct {
+    log_page_t page;
+    int64_t last_us;            // Timestamp the next delta is relative to
+    int64_t opened_us;          // When the first record went into this page
+} packer_t;
+
+static void submit_page(packer_t *pk) {
+    if (pk->page.len > 0) {
+        // A page flushed early is padded so the next one starts on a page boundary
+        uint8_t *page = page_buffers[pk->page.index];
+        memset(page + pk->page.len, 0, CAN_LOG_PAGE_SIZE - pk->page.len);
+        for (size_t off = pk->page.len; off < CAN_LOG_PAGE_SIZE; off += CAN_LOG_RECORD_SIZE) {
+            page[off] = CAN_LOG_MARKER_PAD;
+        }
+        pk->page.len = CAN_LOG_PAGE_SIZE;
+        xQueueSend(full_pages, &pk->page, portMAX_DELAY);
+        // Blocks only while both pages wait for flash; the ring absorbs the backlog
+        xQueueReceive(free_pages, &pk->page, portMAX_DELAY);
+        pk->page.len = 0;
+    }
+}
+
+static uint8_t *reserve_record(packer_t *pk, int64_t timestamp_us) {
+    bool need_marker = pk->page.len == 0 || timestamp_us - pk->last_us > CAN_LOG_MAX_DELTA_US ||
+                       timestamp_us < pk->last_us;
+    if (pk->page.len + (need_marker ? 2 : 1) * CAN_LOG_RECORD_SIZE > CAN_LOG_PAGE_SIZE) {
+        submit_page(pk);
+        need_marker = true;
+    }
+    if (need_marker) {
+        if (pk->page.len == 0) {
+            pk->opened_us = esp_timer_get_time();
+        }
+        uint8_t *marker = page_buffers[pk->page.index] + pk->page.len;
+        put_record_header(marker, CAN_LOG_MARKER_TIME, 0, 0);
+        for (int i = 0; i < 8; i++) {
+            marker[8 + i] = (uint64_t)timestamp_us >> (8 * i);
+        }
+        pk->page.len += CAN_LOG_RECORD_SIZE;
+        pk->last_us = timestamp_us;
+    }
+
+    uint8_t *record = page_buffers[pk->page.index] + pk->page.len;
+    pk->page.len += CAN_LOG_RECORD_SIZE;
+    return record;
+}
+
+static void pack_frame(packer_t *pk, const can_frame_record_t *rec) {
+    uint8_t *p = reserve_record(pk, rec->timestamp_us);
+    uint8_t dlc = rec->msg.data_length_code & CAN_LOG_KIND_DLC_MASK;
+    uint8_t kind = dlc | (rec->msg.extd ? CAN_LOG_KIND_EXTD : 0) | (rec->msg.rtr ? CAN_LOG_KIND_RTR : 0);
+
+    put_record_header(p, kind, (uint32_t)(rec->timestamp_us - pk->last_us), rec->msg.identifier);
+    memcpy(p + 8, rec->msg.data, 8);
+    pk->last_us = rec->timestamp_us;
+}
+
+static void pack_lost(packer_t *pk, uint32_t lost, int64_t timestamp_us) {
+    uint8_t *p = reserve_record(pk, timestamp_us);
+    put_record_header(p, CAN_LOG_MARKER_LOST, (uint32_t)(timestamp_us - pk->last_us), lost);
+    memset(p + 8, 0, 8);
+    pk->last_us = timestamp_us;
+}
+
+static void log_packer_task(void *arg) {
+    static can_frame_record_t batch[PACK_BATCH];
+    can_ring_cursor_t cursor;
+    packer_t pk = { 0 };
+
+    xQueueReceive(free_pages, &pk.page, portMAX_DELAY);
+    pk.page.len = 0;
+    can_ring_cursor_init(&cursor);
+
+    while (1) {
+        uint32_t lost;
+        size_t count = can_ring_read(&cursor, batch, PACK_BATCH, &lost);
+        if (lost > 0) {
+            atomic_fetch_add(&lost_frames, lost);
+            pack_lost(&pk, lost, count > 0 ? batch[0].timestamp_us : esp_timer_get_time());
+        }
+        for (size_t i = 0; i < count; i++) {
+            pack_frame(&pk, &batch[i]);
+        }
+
+        if (count < PACK_BATCH) {
+            if (pk.page.len > 0 &&
+                esp_timer_get_time() - pk.opened_us >= CONFIG_CAN_LOG_FLUSH_INTERVAL_MS * 1000LL) {
+                submit_page(&pk);
+            }
+            vTaskDelay(pdMS_TO_TICKS(PACK_IDLE_MS));
+        }
+    }
+}
+
+esp_err_t can_log_start(void) {
+    esp_err_t ret = storage_mount();
+    if (ret != ESP_OK) {
+        return ret;
+    }
+
+    segments_mutex = xSemaphoreCreateMutex();
+    free_pages = xQueueCreate(LOG_BUFFERS, sizeof(log_page_t));
+    full_pages = xQueueCreate(LOG_BUFFERS, sizeof(log_page_t));
+    if (segments_mutex == NULL || free_pages == NULL || full_pages == NULL) {
+        ESP_LOGE(TAG, "Failed to create logger queues");
+        return ESP_ERR_NO_MEM;
+    }
+    for (uint8_t i = 0; i < LOG_BUFFERS; i++) {
+        log_page_t page = { .index = i, .len = 0 };
+        xQueueSend(free_pages, &page, 0);
+    }
+
+    // Each boot starts a fresh segment after the newest one found
+    scan_segments();
+
+    if (xTaskCreate(log_writer_task, "log_writer_task", 4096, NULL, 2, NULL) != pdPASS ||
+        xTaskCreate(log_packer_task, "log_packer_task", 3072, NULL, 5, NULL) != pdPASS) {
+        ESP_LOGE(TAG, "Failed to create logger tasks");
+        return ESP_ERR_NO_MEM;
+    }
+    return ESP_OK;
+}
+
+size_t can_log_list(can_log_segment_t *out, size_t max) {
+    size_t count = 0;
+    char path[32];
+
+    if (segments_mutex == NULL) {
+        return 0;
+    }
+    xSemaphoreTake(segments_mutex, portMAX_DELAY);
+    for (uint32_t index = oldest_segment; have_segments && index <= active_segment && count < max; index++) {
+        struct stat st;
+        segment_path(index, path, sizeof(path));
+        if (stat(path, &st) != 0) {
+            continue;
+        }
+        out[count].index = index;
+        out[count].size = st.st_size;
+        out[count].active = (active_file != NULL && index == active_segment);
+        count++;
+    }
+    xSemaphoreGive(segments_mutex);
+    return count;
+}
+
+esp_err_t can_log_open_segment(uint32_t index, FILE **file) {
+    char path[32];
+    esp_err_t ret = ESP_OK;
+
+    if (segments_mutex == NULL) {
+        return ESP_ERR_NOT_FOUND;
+    }
+    xSemaphoreTake(segments_mutex, portMAX_DELAY);
+    if (download_file != NULL) {
+        ret = ESP_ERR_INVALID_STATE;
+    } else if (!have_segments || index < oldest_segment || index > active_segment) {
+        ret = ESP_ERR_NOT_FOUND;
+    } else {
+        segment_path(index, path, sizeof(path));
+        download_file = fopen(path, "rb");
+        download_segment = index;
+        ret = download_file != NULL ? ESP_OK : ESP_ERR_NOT_FOUND;
+    }
+    xSemaphoreGive(segments_mutex);
+    *file = download_file;
+    return ret;
+}
+
+void can_log_close_segment(FILE *file) {
+    xSemaphoreTake(segments_mutex, portMAX_DELAY);
+    fclose(file);
+    download_file = NULL;
+    xSemaphoreGive(segments_mutex);
+}
+
+uint32_t can_log_lost_frames(void) {
+    return atomic_load(&lost_frames);
+}
\ No newline at end of file
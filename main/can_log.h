@@ -0,0 +1,85 @@
+// can_log.h
+#ifndef CAN_LOG_H
+#define CAN_LOG_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include "esp_err.h"
+
+// Segment files are a sequence of 16-byte little-endian records:
+//
+//   u8  kind         bits 0-3 DLC, bit 4 extended, bit 5 RTR for frames;
+//                    CAN_LOG_MARKER_* when bit 7 is set
+//   u24 delta_us     time since the previous record
+//   u32 identifier   frame identifier, or the lost count of a LOST marker
+//   u8  data[8]      payload, or the absolute int64 timestamp of a TIME marker
+//
+// Every page written starts with a TIME marker and is CAN_LOG_PAGE_SIZE
+// long, a page flushed before it is full being padded with PAD markers, so
+// decoding can begin at any multiple of CAN_LOG_PAGE_SIZE in a segment.
+#define CAN_LOG_RECORD_SIZE 16
+#define CAN_LOG_PAGE_SIZE 4096
+
+#define CAN_LOG_KIND_DLC_MASK 0x0f
+#define CAN_LOG_KIND_EXTD 0x10
+#define CAN_LOG_KIND_RTR 0x20
+#define CAN_LOG_KIND_MARKER 0x80
+#define CAN_LOG_MARKER_TIME 0x80
+#define CAN_LOG_MARKER_LOST 0x81
+#define CAN_LOG_MARKER_PAD 0x82     // All other bytes zero
+#define CAN_LOG_MAX_DELTA_US 0xffffff
+
+typedef enum {
+    CAN_LOG_FORMAT_BINARY,
+    CAN_LOG_FORMAT_CANDUMP,     // (sec.usec) can0 ID#DATA
+    CAN_LOG_FORMAT_ASC,         // Vector ASCII trace
+} can_log_format_t;
+
+typedef struct {
+    uint32_t index;
+    uint32_t size;
+    bool active;                // Segment currently being written
+} can_log_segment_t;
+
+// Mounts the storage partition and starts the packer and writer tasks.
+esp_err_t can_log_start(void);
+
+// Lists segments from oldest to newest. Returns the number written to out.
+size_t can_log_list(can_log_segment_t *out, size_t max);
+
+// Opens a segment for download. While it is open, rotation waits before
+// deleting it. One download at a time: ESP_ERR_INVALID_STATE while another
+// is open, ESP_ERR_NOT_FOUND once the segment has been deleted.
+esp_err_t can_log_open_segment(uint32_t index, FILE **file);
+void can_log_close_segment(FILE *file);
+
+// Frames the logger could not keep up with.
+uint32_t can_log_lost_frames(void);
+
+// Per-download decoding state for can_log_format_record.
+typedef struct {
+    int64_t clock_us;           // Timestamp of the last record decoded
+    int64_t start_us;           // First timestamp seen, ASC times are relative to it
+    bool started;
+} can_log_decoder_t;
+
+// Header text written once before the records of a text download.
+const char *can_log_text_header(can_log_format_t format);
+
+// Decodes one record and appends its text form to dst. Markers update the
+// clock and produce no output. Candump lines come from can_format_candump,
+// so they match the trigger capture download and need size of at least
+// CAN_FORMAT_CANDUMP_MAX. Returns the number of characters written.
+size_t can_log_format_record(can_log_decoder_t *dec, const uint8_t *record, can_log_format_t format,
+                             char *dst, size_t size);
+
+// Receives the output of can_log_export, never an empty piece.
+typedef esp_err_t (*can_log_send_t)(void *ctx, const char *data, size_t len);
+
+// Converts a segment file to format page by page, so it is never held in
+// RAM, and hands the result to send. Stops at the first error of send.
+esp_err_t can_log_export(FILE *f, can_log_format_t format, can_log_send_t send, void *ctx);
+
+#endif // CAN_LOG_H
\ No newline at end of file
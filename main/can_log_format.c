@@ -0,0 +1,118 @@
+#include "can_log.h"
+#include "can_format.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define EXPORT_TEXT_SIZE 2048
+#define EXPORT_LINE_MAX 128
+
+const char *can_log_text_header(can_log_format_t format) {
+    if (format == CAN_LOG_FORMAT_ASC) {
+        return "date Thu Jan 1 00:00:00.000 am 1970\n"
+               "base hex  timestamps absolute\n"
+               "no internal events logged\n";
+    }
+    return "";
+}
+
+size_t can_log_format_record(can_log_decoder_t *dec, const uint8_t *record, can_log_format_t format,
+                             char *dst, size_t size) {
+    static const char hex_digits[] = "0123456789ABCDEF";
+    uint8_t kind = record[0];
+    uint32_t delta = record[1] | (record[2] << 8) | ((uint32_t)record[3] << 16);
+    uint32_t identifier = record[4] | (record[5] << 8) | ((uint32_t)record[6] << 16) | ((uint32_t)record[7] << 24);
+
+    if (kind == CAN_LOG_MARKER_TIME) {
+        uint64_t ts = 0;
+        for (int i = 7; i >= 0; i--) {
+            ts = (ts << 8) | record[8 + i];
+        }
+        dec->clock_us = (int64_t)ts;
+    } else {
+        dec->clock_us += delta;
+    }
+    if (!dec->started) {
+        dec->start_us = dec->clock_us;
+        dec->started = true;
+    }
+    if (kind & CAN_LOG_KIND_MARKER) {
+        return 0;
+    }
+
+    bool extd = kind & CAN_LOG_KIND_EXTD;
+    bool rtr = kind & CAN_LOG_KIND_RTR;
+    uint8_t dlc = kind & CAN_LOG_KIND_DLC_MASK;
+    uint8_t data_len = (rtr || dlc > 8) ? (rtr ? 0 : 8) : dlc;
+
+    if (format == CAN_LOG_FORMAT_CANDUMP) {
+        // Same line as the trigger capture download
+        twai_message_t msg = {
+            .extd = extd,
+            .rtr = rtr,
+            .identifier = identifier,
+            .data_length_code = dlc,
+        };
+        memcpy(msg.data, record + 8, data_len);
+        return can_format_candump(dst, size, dec->clock_us, &msg);
+    }
+
+    int64_t t = dec->clock_us - dec->start_us;
+    char id_text[12];
+    snprintf(id_text, sizeof(id_text), extd ? "%lXx" : "%lX", (unsigned long)identifier);
+    int len = snprintf(dst, size, "%4lld.%06lld 1  %-15s Rx   %c %d",
+                       (long long)(t / 1000000), (long long)(t % 1000000), id_text, rtr ? 'r' : 'd', dlc);
+    if (len < 0 || (size_t)len + 3 * data_len + 2 > size) {
+        return 0;
+    }
+
+    for (int i = 0; i < data_len; i++) {
+        dst[len++] = ' ';
+        dst[len++] = hex_digits[record[8 + i] >> 4];
+        dst[len++] = hex_digits[record[8 + i] & 0x0f];
+    }
+    dst[len++] = '\n';
+    dst[len] = '\0';
+    return len;
+}
+
+esp_err_t can_log_export(FILE *f, can_log_format_t format, can_log_send_t send, void *ctx) {
+    uint8_t *page = malloc(CAN_LOG_PAGE_SIZE);
+    char *text = malloc(EXPORT_TEXT_SIZE);
+    if (page == NULL || text == NULL) {
+        free(page);
+        free(text);
+        return ESP_ERR_NO_MEM;
+    }
+
+    // An empty piece would end a chunked HTTP response, so none is sent
+    esp_err_t ret = ESP_OK;
+    const char *header = can_log_text_header(format);
+    if (*header) {
+        ret = send(ctx, header, strlen(header));
+    }
+
+    can_log_decoder_t decoder = { 0 };
+    size_t len;
+    while (ret == ESP_OK && (len = fread(page, 1, CAN_LOG_PAGE_SIZE, f)) > 0) {
+        if (format == CAN_LOG_FORMAT_BINARY) {
+            ret = send(ctx, (const char *)page, len);
+            continue;
+        }
+        size_t text_len = 0;
+        for (size_t off = 0; off + CAN_LOG_RECORD_SIZE <= len && ret == ESP_OK; off += CAN_LOG_RECORD_SIZE) {
+            text_len += can_log_format_record(&decoder, page + off, format, text + text_len, EXPORT_TEXT_SIZE - text_len);
+            if (text_len > EXPORT_TEXT_SIZE - EXPORT_LINE_MAX) {
+                ret = send(ctx, text, text_len);
+                text_len = 0;
+            }
+        }
+        if (ret == ESP_OK && text_len > 0) {
+            ret = send(ctx, text, text_len);
+        }
+    }
+
+    free(page);
+    free(text);
+    return ret;
+}
\ No newline at end of file
@@ -0,0 +1,96 @@
+#include "can_metrics.h"
+
+typedef struct {
+    atomic_uint_least32_t buckets[CAN_HIST_BUCKETS + 1];
+    atomic_uint_least32_t count;
+    atomic_uint_least32_t sum_us;
+} can_hist_t;
+
+const uint32_t can_hist_bounds_us[CAN_HIST_BUCKETS] = {
+    10, 50, 100, 500, 1000, 5000, 10000, 25000, 50000, 100000, 500000, 1000000,
+};
+
+static const char *const counter_names[CAN_METRIC_COUNTER_COUNT] = {
+    [CAN_METRIC_RX_FRAMES] = "rx_frames_total",
+    [CAN_METRIC_RX_FILTERED] = "rx_filtered_total",
+    [CAN_METRIC_RX_ERRORS] = "rx_errors_total",
+    [CAN_METRIC_HISTORY_DROPPED] = "history_dropped_total",
+    [CAN_METRIC_WS_SKIPPED] = "ws_skipped_frames_total",
+    [CAN_METRIC_WS_QUEUE_FAILED] = "ws_queue_failed_total",
+    [CAN_METRIC_WS_BATCHES] = "ws_batches_total",
+    [CAN_METRIC_WS_BYTES] = "ws_bytes_total",
+    [CAN_METRIC_WS_SEND_ERRORS] = "ws_send_errors_total",
+    [CAN_METRIC_BRIDGE_FRAMES] = "bridge_frames_total",
+    [CAN_METRIC_BRIDGE_DROPPED] = "bridge_dropped_total",
+    [CAN_METRIC_BRIDGE_DATAGRAMS] = "bridge_datagrams_total",
+    [CAN_METRIC_BRIDGE_TX] = "bridge_tx_frames_total",
+    [CAN_METRIC_BRIDGE_TX_ERRORS] = "bridge_tx_errors_total",
+};
+
+static const char *const hist_names[CAN_HIST_COUNT] = {
+    [CAN_HIST_RING_INSERT] = "ring_insert_seconds",
+    [CAN_HIST_BATCH_WAIT] = "batch_wait_seconds",
+    [CAN_HIST_WS_QUEUE] = "ws_queue_seconds",
+    [CAN_HIST_WS_SEND] = "ws_send_seconds",
+    [CAN_HIST_END_TO_END] = "end_to_end_seconds",
+};
+
+atomic_uint_least32_t can_metric_counters[CAN_METRIC_COUNTER_COUNT];
+static can_hist_t hists[CAN_HIST_COUNT];
+
+static inline void bump(atomic_uint_least32_t *v, uint32_t n) {
+    atomic_store_explicit(v, atomic_load_explicit(v, memory_order_relaxed) + n, memory_order_relaxed);
+}
+
+void can_metrics_observe(can_metric_hist_t hist, int64_t us) {
+    uint32_t value = us < 0 ? 0 : (us > UINT32_MAX ? UINT32_MAX : (uint32_t)us);
+    size_t bucket = 0;
+    while (bucket < CAN_HIST_BUCKETS && value > can_hist_bounds_us[bucket]) {
+        bucket++;
+    }
+
+    can_hist_t *h = &hists[hist];
+    bump(&h->buckets[bucket], 1);
+    bump(&h->sum_us, value);
+    bump(&h->count, 1);
+}
+
+void can_metrics_snapshot(can_metric_hist_t hist, can_hist_snapshot_t *out) {
+    can_hist_t *h = &hists[hist];
+
+    // Count first: a sample landing meanwhile can only make the buckets
+    // larger than the count, which the renderer clamps.
+    out->count = atomic_load_explicit(&h->count, memory_order_relaxed);
+    out->sum_us = atomic_load_explicit(&h->sum_us, memory_order_relaxed);
+    for (size_t i = 0; i <= CAN_HIST_BUCKETS; i++) {
+        out->buckets[i] = atomic_load_explicit(&h->buckets[i], memory_order_relaxed);
+    }
+}
+
+const char *can_metrics_counter_name(can_metric_counter_t counter) {
+    return counter_names[counter];
+}
+
+const char *can_metrics_hist_name(can_metric_hist_t hist) {
+    return hist_names[hist];
+}
+
+uint32_t can_metrics_quantile_us(const can_hist_snapshot_t *snap, uint32_t permille) {
+    uint64_t total = 0;
+    for (size_t i = 0; i <= CAN_HIST_BUCKETS; i++) {
+        total += snap->buckets[i];
+    }
+    if (total == 0) {
+        return 0;
+    }
+
+    uint64_t target = (total * permille + 999) / 1000;
+    uint64_t seen = 0;
+    for (size_t i = 0; i < CAN_HIST_BUCKETS; i++) {
+        seen += snap->buckets[i];
+        if (seen >= target) {
+            return can_hist_bounds_us[i];
+        }
+    }
+    return UINT32_MAX;
+}
\ No newline at end of file
@@ -0,0 +1,75 @@
+// can_metrics.h
+#ifndef CAN_METRICS_H
+#define CAN_METRICS_H
+
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stddef.h>
+
+// Pipeline counters and latency histograms. Each metric is written by a
+// single task, so recording is a relaxed load and store: no lock, no
+// read-modify-write (the C3 has no atomic instructions, RMW atomics would
+// mask interrupts), and readers on other tasks see whole 32-bit values.
+
+typedef enum {
+    CAN_METRIC_RX_FRAMES,           // Receive task: frames that passed the software filter
+    CAN_METRIC_RX_FILTERED,         // Receive task: frames dropped by the software filter
+    CAN_METRIC_RX_ERRORS,           // Receive task: driver errors other than timeouts
+    CAN_METRIC_HISTORY_DROPPED,     // History consumer: frames overwritten before it read them
+    CAN_METRIC_WS_SKIPPED,          // Broadcaster: frames skipped for clients that fell behind
+    CAN_METRIC_WS_QUEUE_FAILED,     // Broadcaster: batches that could not be allocated or queued
+    CAN_METRIC_WS_BATCHES,          // httpd task: stream batches sent
+    CAN_METRIC_WS_BYTES,            // httpd task: WebSocket payload bytes sent
+    CAN_METRIC_WS_SEND_ERRORS,      // httpd task: failed WebSocket sends
+    CAN_METRIC_BRIDGE_FRAMES,       // Bridge: frames sent to network clients, per transport
+    CAN_METRIC_BRIDGE_DROPPED,      // Bridge: frames overwritten in the ring or refused by a full socket
+    CAN_METRIC_BRIDGE_DATAGRAMS,    // Bridge: cannelloni packets sent
+    CAN_METRIC_BRIDGE_TX,           // Bridge: frames from network clients handed to the driver
+    CAN_METRIC_BRIDGE_TX_ERRORS,    // Bridge: frames the driver refused
+    CAN_METRIC_COUNTER_COUNT,
+} can_metric_counter_t;
+
+typedef enum {
+    CAN_HIST_RING_INSERT,           // Driver return to ring publication
+    CAN_HIST_BATCH_WAIT,            // Oldest frame of a stream batch: reception to batch built
+    CAN_HIST_WS_QUEUE,              // Batch built to picked up by the httpd task
+    CAN_HIST_WS_SEND,               // Duration of one WebSocket send
+    CAN_HIST_END_TO_END,            // Oldest frame of a stream batch: reception to send completed
+    CAN_HIST_COUNT,
+} can_metric_hist_t;
+
+// Upper bounds of the finite buckets in microseconds; one more bucket counts the rest.
+#define CAN_HIST_BUCKETS 12
+extern const uint32_t can_hist_bounds_us[CAN_HIST_BUCKETS];
+
+typedef struct {
+    uint32_t buckets[CAN_HIST_BUCKETS + 1];    // Not cumulative
+    uint32_t count;
+    uint32_t sum_us;                            // Wraps like a counter
+} can_hist_snapshot_t;
+
+extern atomic_uint_least32_t can_metric_counters[CAN_METRIC_COUNTER_COUNT];
+
+static inline void can_metrics_add(can_metric_counter_t counter, uint32_t n) {
+    atomic_uint_least32_t *c = &can_metric_counters[counter];
+    atomic_store_explicit(c, atomic_load_explicit(c, memory_order_relaxed) + n, memory_order_relaxed);
+}
+
+static inline uint32_t can_metrics_counter(can_metric_counter_t counter) {
+    return atomic_load_explicit(&can_metric_counters[counter], memory_order_relaxed);
+}
+
+// Records one latency sample; negative values count as zero.
+void can_metrics_observe(can_metric_hist_t hist, int64_t us);
+
+void can_metrics_snapshot(can_metric_hist_t hist, can_hist_snapshot_t *out);
+
+// Prometheus metric names without the common prefix.
+const char *can_metrics_counter_name(can_metric_counter_t counter);
+const char *can_metrics_hist_name(can_metric_hist_t hist);
+
+// Smallest bucket bound below which at least permille / 1000 of the samples
+// fall, UINT32_MAX when that is beyond the last bound, 0 with no samples.
+uint32_t can_metrics_quantile_us(const can_hist_snapshot_t *snap, uint32_t permille);
+
+#endif // CAN_METRICS_H
\ No newline at end of file
@@ -0,0 +1,180 @@
+#include "can_monitor.h"
+#include "can_format.h"
+#include "freertos/FreeRTOS.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define CAN_MONITOR_MASK (CAN_MONITOR_MAX_IDS - 1)
+#define CAN_MONITOR_KEY_USED (1UL << 31)
+#define CAN_MONITOR_KEY_EXTD (1UL << 30)
+#define RATE_WINDOW_US 1000000
+#define JITTER_GAIN_SHIFT 4     // Jitter filter gain of 1/16, as in RFC 3550
+
+_Static_assert((CAN_MONITOR_MAX_IDS & CAN_MONITOR_MASK) == 0, "CAN_MONITOR_MAX_IDS must be a power of two");
+
+typedef struct {
+    uint32_t key;           // 0 while the slot is free
+    can_monitor_entry_t entry;
+} can_monitor_slot_t;
+
+static can_monitor_slot_t table[CAN_MONITOR_MAX_IDS];
+static uint32_t used_slots;
+static uint32_t overflow_count;
+static portMUX_TYPE monitor_lock = portMUX_INITIALIZER_UNLOCKED;
+
+static inline uint32_t monitor_key(const twai_message_t *msg) {
+    return CAN_MONITOR_KEY_USED | (msg->extd ? CAN_MONITOR_KEY_EXTD : 0) | (msg->identifier & TWAI_EXTD_ID_MASK);
+}
+
+static inline uint32_t monitor_hash(uint32_t key) {
+    return (uint32_t)(key * 2654435761u) >> 16;
+}
+
+// Linear probing; the table is never allowed to fill completely so the
+// probe always ends on either the key or a free slot.
+static can_monitor_slot_t *find_slot(uint32_t key) {
+    uint32_t i = monitor_hash(key) & CAN_MONITOR_MASK;
+    while (table[i].key != key && table[i].key != 0) {
+        i = (i + 1) & CAN_MONITOR_MASK;
+    }
+    return &table[i];
+}
+
+static void update_timing(can_monitor_entry_t *e, int64_t timestamp_us) {
+    int64_t delta = timestamp_us - e->last_seen_us;
+    uint32_t period = delta > UINT32_MAX ? UINT32_MAX : (uint32_t)delta;
+    uint32_t periods = e->count;    // Periods measured including this one
+
+    if (periods == 1 || period < e->period_min_us) {
+        e->period_min_us = period;
+    }
+    if (period > e->period_max_us) {
+        e->period_max_us = period;
+    }
+    e->period_sum_us += period;
+
+    int32_t deviation = (int32_t)(period - (uint32_t)(e->period_sum_us / periods));
+    int32_t abs_dev = abs(deviation);
+    e->jitter_us += (abs_dev - (int32_t)e->jitter_us) >> JITTER_GAIN_SHIFT;
+
+    int64_t window_elapsed = timestamp_us - e->window_start_us;
+    if (window_elapsed >= RATE_WINDOW_US) {
+        // Only a window that just ended is a valid rate; after a silence start over
+        e->rate = (window_elapsed < 2 * RATE_WINDOW_US) ? e->window_count : 0;
+        e->window_count = 0;
+        e->window_start_us += (window_elapsed / RATE_WINDOW_US) * RATE_WINDOW_US;
+    }
+}
+
+void can_monitor_update(const twai_message_t *msg, int64_t timestamp_us) {
+    uint32_t key = monitor_key(msg);
+    uint8_t dlc = msg->data_length_code > TWAI_FRAME_MAX_DLC ? TWAI_FRAME_MAX_DLC : msg->data_length_code;
+
+    taskENTER_CRITICAL(&monitor_lock);
+    can_monitor_slot_t *slot = find_slot(key);
+    if (slot->key == 0) {
+        if (used_slots >= CAN_MONITOR_MAX_IDS - 1) {
+            overflow_count++;
+            taskEXIT_CRITICAL(&monitor_lock);
+            return;
+        }
+        used_slots++;
+        slot->key = key;
+        memset(&slot->entry, 0, sizeof(can_monitor_entry_t));
+        slot->entry.identifier = msg->identifier;
+        slot->entry.extd = msg->extd;
+    }
+
+    can_monitor_entry_t *e = &slot->entry;
+    uint8_t changed = 0;
+    for (int i = 0; i < dlc; i++) {
+        if (i >= e->dlc || e->data[i] != msg->data[i]) {
+            changed |= 1 << i;
+        }
+    }
+    memcpy(e->data, msg->data, dlc);
+    memset(e->data + dlc, 0, TWAI_FRAME_MAX_DLC - dlc);
+    e->changed_mask = (e->count == 0) ? 0 : changed;
+    e->dlc = dlc;
+    e->rtr = msg->rtr;
+
+    if (e->count == 0) {
+        e->window_start_us = timestamp_us;
+    } else {
+        update_timing(e, timestamp_us);
+    }
+    e->window_count++;
+    e->count++;
+    e->last_seen_us = timestamp_us;
+    taskEXIT_CRITICAL(&monitor_lock);
+}
+
+void can_monitor_reset(void) {
+    taskENTER_CRITICAL(&monitor_lock);
+    memset(table, 0, sizeof(table));
+    used_slots = 0;
+    overflow_count = 0;
+    taskEXIT_CRITICAL(&monitor_lock);
+}
+
+bool can_monitor_get(size_t index, can_monitor_entry_t *out) {
+    if (index >= CAN_MONITOR_MAX_IDS) {
+        return false;
+    }
+
+    // One entry at a time so the receive task is never held off for long
+    taskENTER_CRITICAL(&monitor_lock);
+    bool used = table[index].key != 0;
+    if (used) {
+        *out = table[index].entry;
+    }
+    taskEXIT_CRITICAL(&monitor_lock);
+    return used;
+}
+
+uint32_t can_monitor_period_avg_us(const can_monitor_entry_t *e) {
+    return e->count > 1 ? (uint32_t)(e->period_sum_us / (e->count - 1)) : 0;
+}
+
+uint32_t can_monitor_rate(const can_monitor_entry_t *e, int64_t now_us) {
+    return (now_us - e->window_start_us < 2 * RATE_WINDOW_US) ? e->rate : 0;
+}
+
+uint32_t can_monitor_overflow_count(void) {
+    return overflow_count;
+}
+
+size_t can_monitor_format_json(char *dst, size_t size, int64_t now_us) {
+    size_t len = 0;
+    bool first = true;
+
+    if (size < 3) {
+        return 0;
+    }
+    dst[len++] = '[';
+
+    for (int i = 0; i < CAN_MONITOR_MAX_IDS; i++) {
+        can_monitor_entry_t e;
+        if (!can_monitor_get(i, &e)) {
+            continue;
+        }
+
+        char data_hex[2 * TWAI_FRAME_MAX_DLC + 1];
+        *can_format_hex(data_hex, e.data, e.dlc) = '\0';
+
+        int n = snprintf(dst + len, size - len, "%s[%lu,%d,%d,\"%s\",%d,%lu,%lu]",
+                         first ? "" : ",",
+                         (unsigned long)e.identifier, e.extd, e.dlc, data_hex, e.changed_mask,
+                         (unsigned long)e.count, (unsigned long)((now_us - e.last_seen_us) / 1000));
+        if (n < 0 || (size_t)n >= size - len - 1) {
+            break;  // Out of room: keep the array well-formed
+        }
+        len += n;
+        first = false;
+    }
+
+    dst[len++] = ']';
+    dst[len] = '\0';
+    return len;
+}
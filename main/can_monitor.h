@@ -0,0 +1,58 @@
+// can_monitor.h
+#ifndef CAN_MONITOR_H
+#define CAN_MONITOR_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stddef.h>
+#include "driver/twai.h"
+
+// Distinct identifiers tracked. Must be a power of two.
+#define CAN_MONITOR_MAX_IDS 256
+
+// Latest state of one identifier.
+typedef struct {
+    uint32_t identifier;
+    uint8_t extd;
+    uint8_t rtr;
+    uint8_t dlc;
+    uint8_t changed_mask;   // Bit n set when data[n] differs from the previous frame
+    uint8_t data[TWAI_FRAME_MAX_DLC];
+    uint32_t count;
+    int64_t last_seen_us;
+
+    // Inter-arrival timing, updated incrementally
+    uint32_t period_min_us;
+    uint32_t period_max_us;
+    uint32_t jitter_us;     // Mean deviation of the period from its average
+    uint64_t period_sum_us; // Sum of count - 1 periods
+    uint32_t rate;          // Frames seen in the last complete one-second window
+    uint32_t window_count;
+    int64_t window_start_us;
+} can_monitor_entry_t;
+
+// Records a frame. O(1), allocation-free; called from the receive task.
+void can_monitor_update(const twai_message_t *msg, int64_t timestamp_us);
+
+// Forgets every identifier.
+void can_monitor_reset(void);
+
+// Copies the entry held in table slot index (0 .. CAN_MONITOR_MAX_IDS - 1).
+// Returns false if the slot is free.
+bool can_monitor_get(size_t index, can_monitor_entry_t *out);
+
+// Average period of an entry in microseconds, 0 until two frames were seen.
+uint32_t can_monitor_period_avg_us(const can_monitor_entry_t *e);
+
+// Frame rate of an entry over the last complete second, 0 once it went silent.
+uint32_t can_monitor_rate(const can_monitor_entry_t *e, int64_t now_us);
+
+// Number of identifiers that could not be tracked because the table was full.
+uint32_t can_monitor_overflow_count(void);
+
+// Writes the table as a JSON array of
+// [identifier, extd, dlc, "hexdata", changed_mask, count, age_ms] rows.
+// Returns the number of characters written, excluding the terminator.
+size_t can_monitor_format_json(char *dst, size_t size, int64_t now_us);
+
+#endif // CAN_MONITOR_H
@@ -0,0 +1,43 @@
+#include "can_pipeline.h"
+#include "can_ring.h"
+#include "can_monitor.h"
+#include "can_stats.h"
+#include "can_metrics.h"
+#include "can_trigger.h"
+#include "esp_timer.h"
+
+static can_filter_compiled_t sw_filter = { .accept_all = true };
+
+void can_pipeline_set_filter(const can_filter_compiled_t *filter) {
+    sw_filter = *filter;
+}
+
+void can_pipeline_process(const twai_message_t *msg, int64_t timestamp_us) {
+    if (!can_filter_match(&sw_filter, msg)) {
+        can_metrics_add(CAN_METRIC_RX_FILTERED, 1);
+        return;
+    }
+    uint32_t seq = can_ring_push(msg, timestamp_us);
+    can_metrics_observe(CAN_HIST_RING_INSERT, esp_timer_get_time() - timestamp_us);
+    can_metrics_add(CAN_METRIC_RX_FRAMES, 1);
+    can_monitor_update(msg, timestamp_us);
+    can_stats_update(msg, timestamp_us);
+    can_trigger_process(seq, msg, timestamp_us);
+}
+
+esp_err_t can_pipeline_drain(const can_driver_t *driver, uint32_t timeout_ms, size_t *frames) {
+    twai_message_t rx_message;
+
+    esp_err_t result = driver->receive(&rx_message, timeout_ms);
+    while (result == ESP_OK) {
+        can_pipeline_process(&rx_message, esp_timer_get_time());
+        (*frames)++;
+        result = driver->receive(&rx_message, 0);
+    }
+    can_trigger_poll(esp_timer_get_time());
+    return result;
+}
+
+uint32_t can_pipeline_filtered_count(void) {
+    return can_metrics_counter(CAN_METRIC_RX_FILTERED);
+}
\ No newline at end of file
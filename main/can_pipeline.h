@@ -0,0 +1,28 @@
+// can_pipeline.h
+#ifndef CAN_PIPELINE_H
+#define CAN_PIPELINE_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "esp_err.h"
+#include "can_driver.h"
+#include "can_filter.h"
+
+// Receive path shared by the firmware and the host build: software filter,
+// frame ring, per-ID monitor, bus statistics and capture triggers.
+
+// Replaces the software filter. Must not run concurrently with the functions below.
+void can_pipeline_set_filter(const can_filter_compiled_t *filter);
+
+// Feeds one received frame through the pipeline.
+void can_pipeline_process(const twai_message_t *msg, int64_t timestamp_us);
+
+// Waits up to timeout_ms for a frame, then drains everything the driver has
+// queued without waiting. Returns the last driver result (ESP_ERR_TIMEOUT once
+// the queue is empty) and adds the number of frames received to *frames.
+esp_err_t can_pipeline_drain(const can_driver_t *driver, uint32_t timeout_ms, size_t *frames);
+
+// Frames dropped by the software filter.
+uint32_t can_pipeline_filtered_count(void);
+
+#endif // CAN_PIPELINE_H
\ No newline at end of file
@@ -0,0 +1,94 @@
+#include "can_ring.h"
+#include <stdatomic.h>
+#include <string.h>
+
+#define CAN_RING_MASK (CAN_RING_SIZE - 1)
+
+_Static_assert((CAN_RING_SIZE & CAN_RING_MASK) == 0, "CAN_RING_SIZE must be a power of two");
+
+// Each slot carries the sequence number of the frame it holds. The producer
+// updates it before touching the payload, so a reader that sees the same
+// value before and after copying knows the copy is not torn.
+typedef struct {
+    atomic_uint_least32_t stamp;
+    can_frame_record_t record;
+} can_ring_slot_t;
+
+static can_ring_slot_t slots[CAN_RING_SIZE];
+static atomic_uint_least32_t head;
+
+uint32_t can_ring_push(const twai_message_t *msg, int64_t timestamp_us) {
+    uint32_t seq = atomic_load_explicit(&head, memory_order_relaxed);
+    can_ring_slot_t *slot = &slots[seq & CAN_RING_MASK];
+
+    atomic_store_explicit(&slot->stamp, seq, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+
+    slot->record.timestamp_us = timestamp_us;
+    slot->record.seq = seq;
+    slot->record.msg = *msg;
+
+    atomic_store_explicit(&head, seq + 1, memory_order_release);
+    return seq;
+}
+
+uint32_t can_ring_head(void) {
+    return atomic_load_explicit(&head, memory_order_acquire);
+}
+
+void can_ring_cursor_init(can_ring_cursor_t *cursor) {
+    cursor->next_seq = can_ring_head();
+    cursor->dropped = 0;
+}
+
+void can_ring_cursor_init_oldest(can_ring_cursor_t *cursor) {
+    uint32_t h = can_ring_head();
+    cursor->next_seq = (h > CAN_RING_SIZE) ? h - CAN_RING_SIZE : 0;
+    cursor->dropped = 0;
+}
+
+size_t can_ring_read(can_ring_cursor_t *cursor, can_frame_record_t *out, size_t max, uint32_t *lost) {
+    uint32_t lost_now = 0;
+    size_t count = 0;
+
+    while (count < max) {
+        uint32_t h = can_ring_head();
+        uint32_t available = h - cursor->next_seq;
+        if (available == 0) {
+            break;
+        }
+
+        // The producer may have lapped us: jump to the oldest frame still held.
+        if (available > CAN_RING_SIZE) {
+            uint32_t skip = available - CAN_RING_SIZE;
+            lost_now += skip;
+            cursor->next_seq += skip;
+        }
+
+        uint32_t seq = cursor->next_seq;
+        const can_ring_slot_t *slot = &slots[seq & CAN_RING_MASK];
+
+        if (atomic_load_explicit(&slot->stamp, memory_order_acquire) != seq) {
+            lost_now++;
+            cursor->next_seq++;
+            continue;
+        }
+        memcpy(&out[count], &slot->record, sizeof(can_frame_record_t));
+        atomic_thread_fence(memory_order_acquire);
+        if (atomic_load_explicit(&slot->stamp, memory_order_relaxed) != seq) {
+            // Overwritten while copying
+            lost_now++;
+            cursor->next_seq++;
+            continue;
+        }
+
+        cursor->next_seq++;
+        count++;
+    }
+
+    cursor->dropped += lost_now;
+    if (lost != NULL) {
+        *lost = lost_now;
+    }
+    return count;
+}
\ No newline at end of file
@@ -0,0 +1,42 @@
+// can_ring.h
+#ifndef CAN_RING_H
+#define CAN_RING_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "driver/twai.h"
+
+// Number of frames kept in the ring. Must be a power of two.
+#define CAN_RING_SIZE 512
+
+// One received frame as stored in the ring.
+typedef struct {
+    int64_t timestamp_us;   // esp_timer_get_time() at reception
+    uint32_t seq;           // Monotonic sequence number (wraps at 2^32)
+    twai_message_t msg;
+} can_frame_record_t;
+
+// Read position of a single consumer.
+typedef struct {
+    uint32_t next_seq;      // Sequence number of the next frame to read
+    uint32_t dropped;       // Total frames this consumer lost to overwrites
+} can_ring_cursor_t;
+
+// Producer side. Only one task may call this.
+uint32_t can_ring_push(const twai_message_t *msg, int64_t timestamp_us);
+
+// Sequence number that the next pushed frame will receive.
+uint32_t can_ring_head(void);
+
+// Positions the cursor so that only frames pushed from now on are read.
+void can_ring_cursor_init(can_ring_cursor_t *cursor);
+
+// Positions the cursor on the oldest frame still held in the ring.
+void can_ring_cursor_init_oldest(can_ring_cursor_t *cursor);
+
+// Copies up to max frames following the cursor into out and advances it.
+// Frames overwritten before they could be read are skipped; their number is
+// added to cursor->dropped and, if lost is not NULL, returned there.
+size_t can_ring_read(can_ring_cursor_t *cursor, can_frame_record_t *out, size_t max, uint32_t *lost);
+
+#endif // CAN_RING_H
\ No newline at end of file
@@ -0,0 +1,152 @@
+#include "can_slcan.h"
+#include <string.h>
+
+static const char hex_digits[] = "0123456789ABCDEF";
+static const uint32_t bitrates[] = { 10000, 20000, 50000, 100000, 125000, 250000, 500000, 800000, 1000000 };
+
+static int hex_value(char c) {
+    if (c >= '0' && c <= '9') {
+        return c - '0';
+    }
+    if (c >= 'a' && c <= 'f') {
+        return c - 'a' + 10;
+    }
+    if (c >= 'A' && c <= 'F') {
+        return c - 'A' + 10;
+    }
+    return -1;
+}
+
+// Reads digits hexadecimal digits; false if one is not
+static bool parse_hex(const char *p, int digits, uint32_t *out) {
+    uint32_t v = 0;
+    for (int i = 0; i < digits; i++) {
+        int d = hex_value(p[i]);
+        if (d < 0) {
+            return false;
+        }
+        v = (v << 4) | d;
+    }
+    *out = v;
+    return true;
+}
+
+static esp_err_t parse_frame(const char *line, size_t len, twai_message_t *msg) {
+    bool extd = (line[0] == 'T' || line[0] == 'R');
+    bool rtr = (line[0] == 'r' || line[0] == 'R');
+    int id_digits = extd ? 8 : 3;
+    uint32_t id;
+    uint32_t dlc;
+
+    if (len < (size_t)id_digits + 2 || !parse_hex(line + 1, id_digits, &id) ||
+        !parse_hex(line + 1 + id_digits, 1, &dlc) || dlc > TWAI_FRAME_MAX_DLC ||
+        id > (extd ? TWAI_EXTD_ID_MASK : TWAI_STD_ID_MASK)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    // A trailing timestamp is allowed and ignored
+    size_t data_len = rtr ? 0 : 2 * dlc;
+    size_t rest = len - (id_digits + 2);
+    if (rest != data_len && rest != data_len + 4) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    memset(msg, 0, sizeof(twai_message_t));
+    msg->identifier = id;
+    msg->extd = extd;
+    msg->rtr = rtr;
+    msg->data_length_code = dlc;
+    const char *p = line + id_digits + 2;
+    for (uint32_t i = 0; i < data_len / 2; i++) {
+        uint32_t byte;
+        if (!parse_hex(p + 2 * i, 2, &byte)) {
+            return ESP_ERR_INVALID_ARG;
+        }
+        msg->data[i] = byte;
+    }
+    return ESP_OK;
+}
+
+esp_err_t can_slcan_parse(const char *line, size_t len, can_slcan_request_t *req) {
+    req->command = CAN_SLCAN_NOP;
+    req->arg = 0;
+    if (len == 0) {
+        return ESP_OK;
+    }
+
+    switch (line[0]) {
+    case 't':
+    case 'T':
+    case 'r':
+    case 'R':
+        req->command = CAN_SLCAN_FRAME;
+        return parse_frame(line, len, &req->msg);
+    case 'O':
+        req->command = CAN_SLCAN_OPEN;
+        return len == 1 ? ESP_OK : ESP_ERR_INVALID_ARG;
+    case 'L':
+        req->command = CAN_SLCAN_LISTEN;
+        return len == 1 ? ESP_OK : ESP_ERR_INVALID_ARG;
+    case 'C':
+        req->command = CAN_SLCAN_CLOSE;
+        return len == 1 ? ESP_OK : ESP_ERR_INVALID_ARG;
+    case 'V':
+        req->command = CAN_SLCAN_VERSION;
+        return ESP_OK;
+    case 'N':
+        req->command = CAN_SLCAN_SERIAL;
+        return ESP_OK;
+    case 'F':
+        req->command = CAN_SLCAN_STATUS;
+        return ESP_OK;
+    case 'S':
+    case 'Z':
+        req->command = line[0] == 'S' ? CAN_SLCAN_BITRATE : CAN_SLCAN_TIMESTAMP;
+        if (len != 2 || line[1] < '0' || line[1] > '9') {
+            return ESP_ERR_INVALID_ARG;
+        }
+        req->arg = line[1] - '0';
+        return ESP_OK;
+    case 'M':
+    case 'm':
+        // Acceptance code and mask: the web page owns the filters
+        return len == 9 ? ESP_OK : ESP_ERR_INVALID_ARG;
+    default:
+        return ESP_ERR_INVALID_ARG;
+    }
+}
+
+size_t can_slcan_encode(char *dst, const twai_message_t *msg, int timestamp_ms) {
+    char *p = dst;
+    uint32_t id = msg->identifier;
+    int id_digits = msg->extd ? 8 : 3;
+    uint8_t dlc = msg->data_length_code > TWAI_FRAME_MAX_DLC ? TWAI_FRAME_MAX_DLC : msg->data_length_code;
+
+    *p++ = msg->rtr ? (msg->extd ? 'R' : 'r') : (msg->extd ? 'T' : 't');
+    for (int shift = 4 * (id_digits - 1); shift >= 0; shift -= 4) {
+        *p++ = hex_digits[(id >> shift) & 0x0f];
+    }
+    *p++ = '0' + dlc;
+    if (!msg->rtr) {
+        for (int i = 0; i < dlc; i++) {
+            *p++ = hex_digits[msg->data[i] >> 4];
+            *p++ = hex_digits[msg->data[i] & 0x0f];
+        }
+    }
+    if (timestamp_ms >= 0) {
+        for (int shift = 12; shift >= 0; shift -= 4) {
+            *p++ = hex_digits[(timestamp_ms >> shift) & 0x0f];
+        }
+    }
+    *p++ = '\r';
+    return p - dst;
+}
+
+int can_slcan_bitrate_code(uint32_t bitrate) {
+    for (int i = 0; i < (int)(sizeof(bitrates) / sizeof(bitrates[0])); i++) {
+        if (bitrates[i] == bitrate) {
+            return i;
+        }
+    }
+    return -1;
+}
\ No newline at end of file
@@ -0,0 +1,52 @@
+// can_slcan.h
+#ifndef CAN_SLCAN_H
+#define CAN_SLCAN_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stddef.h>
+#include "esp_err.h"
+#include "driver/twai.h"
+
+// Lawicel / slcan ASCII protocol as spoken by Linux slcand. Frames are
+// "tIIILDD..", "TIIIIIIIILDD..", "rIIIL" or "RIIIIIIIIL", optionally followed
+// by a four digit millisecond timestamp, and every line ends in '\r'.
+
+// Longest line, extended frame with eight bytes and timestamp, plus terminator.
+#define CAN_SLCAN_LINE_MAX 32
+
+#define CAN_SLCAN_OK "\r"
+#define CAN_SLCAN_ERROR "\a"
+
+typedef enum {
+    CAN_SLCAN_NOP,              // Empty line, acceptance code/mask: acknowledged, no effect
+    CAN_SLCAN_FRAME,            // t/T/r/R: transmit msg
+    CAN_SLCAN_OPEN,             // O
+    CAN_SLCAN_LISTEN,           // L: open without transmitting
+    CAN_SLCAN_CLOSE,            // C
+    CAN_SLCAN_BITRATE,          // Sn, arg is n
+    CAN_SLCAN_VERSION,          // V
+    CAN_SLCAN_SERIAL,           // N
+    CAN_SLCAN_STATUS,           // F
+    CAN_SLCAN_TIMESTAMP,        // Zn, arg is n
+} can_slcan_command_t;
+
+typedef struct {
+    can_slcan_command_t command;
+    unsigned arg;
+    twai_message_t msg;
+} can_slcan_request_t;
+
+// Parses one line without its '\r'. ESP_ERR_INVALID_ARG for malformed or
+// unsupported commands, which get CAN_SLCAN_ERROR as the reply.
+esp_err_t can_slcan_parse(const char *line, size_t len, can_slcan_request_t *req);
+
+// Encodes a frame line, '\r' included, into dst (CAN_SLCAN_LINE_MAX bytes).
+// timestamp_ms below 0 omits the timestamp. Returns the length, no terminator
+// is written.
+size_t can_slcan_encode(char *dst, const twai_message_t *msg, int timestamp_ms);
+
+// Slcan bitrate code of a bit rate, -1 if it has none.
+int can_slcan_bitrate_code(uint32_t bitrate);
+
+#endif // CAN_SLCAN_H
\ No newline at end of file
@@ -0,0 +1,118 @@
+#include "can_stats.h"
+#include "CAN.h"
+#include "freertos/FreeRTOS.h"
+#include <stdbool.h>
+
+#define LOAD_BUCKET_US 100000
+#define LOAD_BUCKETS 10         // LOAD_BUCKETS * LOAD_BUCKET_US = one second
+#define CRC15_POLY 0x4599
+#define FRAME_TAIL_BITS 13      // CRC delimiter, ACK slot and delimiter, EOF, IFS
+
+typedef struct {
+    int64_t index;              // timestamp / LOAD_BUCKET_US this bucket belongs to
+    uint32_t bits;
+} load_bucket_t;
+
+// Serialises the stuffed part of a frame (SOF up to the CRC) one bit at a time
+typedef struct {
+    uint16_t crc;
+    uint8_t last_bit;
+    uint8_t run;
+    uint32_t bits;
+} frame_bits_t;
+
+// One spare bucket so the one being filled never evicts part of the window
+static load_bucket_t buckets[LOAD_BUCKETS + 1];
+static uint32_t total_frames;
+static portMUX_TYPE stats_lock = portMUX_INITIALIZER_UNLOCKED;
+
+static void put_bit(frame_bits_t *f, uint8_t bit) {
+    f->bits++;
+    if (bit == f->last_bit) {
+        if (++f->run == 5) {
+            // Stuff bit of opposite polarity, which starts a new run
+            f->bits++;
+            f->last_bit = !bit;
+            f->run = 1;
+        }
+    } else {
+        f->last_bit = bit;
+        f->run = 1;
+    }
+}
+
+static void put_bits(frame_bits_t *f, uint32_t value, int count, bool crc) {
+    for (int i = count - 1; i >= 0; i--) {
+        uint8_t bit = (value >> i) & 1;
+        if (crc) {
+            uint8_t feedback = bit ^ ((f->crc >> 14) & 1);
+            f->crc = (f->crc << 1) & 0x7fff;
+            if (feedback) {
+                f->crc ^= CRC15_POLY;
+            }
+        }
+        put_bit(f, bit);
+    }
+}
+
+uint32_t can_stats_frame_bits(const twai_message_t *msg) {
+    frame_bits_t f = { .crc = 0, .last_bit = 1, .run = 0, .bits = 0 };
+    uint8_t dlc = msg->data_length_code;
+    uint8_t data_bytes = (msg->rtr || dlc == 0) ? 0 : (dlc > TWAI_FRAME_MAX_DLC ? TWAI_FRAME_MAX_DLC : dlc);
+
+    put_bits(&f, 0, 1, true);                                  // SOF
+    if (msg->extd) {
+        put_bits(&f, (msg->identifier >> 18) & 0x7ff, 11, true);
+        put_bits(&f, 1, 1, true);                              // SRR
+        put_bits(&f, 1, 1, true);                              // IDE
+        put_bits(&f, msg->identifier & 0x3ffff, 18, true);
+        put_bits(&f, msg->rtr, 1, true);
+        put_bits(&f, 0, 2, true);                              // r1, r0
+    } else {
+        put_bits(&f, msg->identifier & 0x7ff, 11, true);
+        put_bits(&f, msg->rtr, 1, true);
+        put_bits(&f, 0, 2, true);                              // IDE, r0
+    }
+    put_bits(&f, dlc & 0x0f, 4, true);
+    for (int i = 0; i < data_bytes; i++) {
+        put_bits(&f, msg->data[i], 8, true);
+    }
+    put_bits(&f, f.crc, 15, false);
+
+    return f.bits + FRAME_TAIL_BITS;
+}
+
+void can_stats_update(const twai_message_t *msg, int64_t timestamp_us) {
+    uint32_t bits = can_stats_frame_bits(msg);
+    int64_t index = timestamp_us / LOAD_BUCKET_US;
+    load_bucket_t *bucket = &buckets[index % (LOAD_BUCKETS + 1)];
+
+    taskENTER_CRITICAL(&stats_lock);
+    if (bucket->index != index) {
+        bucket->index = index;
+        bucket->bits = 0;
+    }
+    bucket->bits += bits;
+    total_frames++;
+    taskEXIT_CRITICAL(&stats_lock);
+}
+
+uint32_t can_stats_bus_load_x100(int64_t now_us) {
+    int64_t current = now_us / LOAD_BUCKET_US;
+    uint64_t bits = 0;
+
+    // Sum the last LOAD_BUCKETS complete buckets; the current one is partial
+    taskENTER_CRITICAL(&stats_lock);
+    for (int i = 0; i < LOAD_BUCKETS + 1; i++) {
+        if (buckets[i].index < current && buckets[i].index >= current - LOAD_BUCKETS) {
+            bits += buckets[i].bits;
+        }
+    }
+    taskEXIT_CRITICAL(&stats_lock);
+
+    return (uint32_t)(bits * 10000 / CAN_BUS_BITRATE);
+}
+
+uint32_t can_stats_total_frames(void) {
+    return total_frames;
+}
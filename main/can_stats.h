@@ -0,0 +1,21 @@
+// can_stats.h
+#ifndef CAN_STATS_H
+#define CAN_STATS_H
+
+#include <stdint.h>
+#include "driver/twai.h"
+
+// Number of bits the frame occupies on the wire, from SOF to the end of the
+// interframe space, including the stuff bits actually inserted.
+uint32_t can_stats_frame_bits(const twai_message_t *msg);
+
+// Accounts a received frame in the bus load window. Called from the receive task.
+void can_stats_update(const twai_message_t *msg, int64_t timestamp_us);
+
+// Bus load over the last complete second in hundredths of a percent.
+uint32_t can_stats_bus_load_x100(int64_t now_us);
+
+// Frames accounted since boot.
+uint32_t can_stats_total_frames(void);
+
+#endif // CAN_STATS_H
@@ -0,0 +1,342 @@
+#include "can_trigger.h"
+#include "esp_timer.h"
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define DEFAULT_PRE 100
+#define DEFAULT_POST 100
+#define KEY_EXTD (1UL << 31)
+
+// The condition is compiled to two masked compares: the identifier with the
+// frame format folded into bit 31, and the eight data bytes as one word.
+typedef struct {
+    uint32_t id_mask;
+    uint32_t id_code;
+    uint64_t data_mask;
+    uint64_t data_code;
+    uint8_t min_dlc;            // Frames shorter than the pattern never match
+    bool absent;
+    int64_t timeout_us;
+    int64_t last_seen_us;       // Last matching frame, or arm time
+
+    // Written by the receive task while capturing, read by the server once done
+    atomic_uint_least32_t state;
+    atomic_uint_least32_t count;
+    uint32_t post_left;
+    uint32_t trigger_index;
+    int64_t trigger_us;
+    can_trigger_config_t config;
+    can_frame_record_t *frames;
+} trigger_slot_t;
+
+static trigger_slot_t slots[CAN_TRIGGER_SLOTS];
+
+static inline bool slot_matches(const trigger_slot_t *s, const twai_message_t *msg) {
+    uint32_t key = msg->identifier | (msg->extd ? KEY_EXTD : 0);
+    if ((key & s->id_mask) != s->id_code) {
+        return false;
+    }
+    if (s->data_mask == 0) {
+        return true;
+    }
+    if (msg->rtr || msg->data_length_code < s->min_dlc) {
+        return false;
+    }
+    uint64_t data;
+    memcpy(&data, msg->data, sizeof(data));
+    return (data & s->data_mask) == s->data_code;
+}
+
+// Freezes the pre-trigger window: the frames before seq are still in the
+// ring, which only this task writes.
+static void fire(trigger_slot_t *s, uint32_t seq, int64_t trigger_us) {
+    uint32_t pre = s->config.pre < seq ? s->config.pre : seq;
+    can_ring_cursor_t cursor = { .next_seq = seq - pre };
+    size_t n = can_ring_read(&cursor, s->frames, pre, NULL);
+
+    s->trigger_index = n;
+    s->trigger_us = trigger_us;
+    s->post_left = s->config.post;
+    atomic_store_explicit(&s->count, n, memory_order_relaxed);
+    atomic_store_explicit(&s->state, CAN_TRIGGER_STATE_CAPTURING, memory_order_relaxed);
+}
+
+static void append(trigger_slot_t *s, uint32_t seq, const twai_message_t *msg, int64_t timestamp_us) {
+    uint32_t n = atomic_load_explicit(&s->count, memory_order_relaxed);
+    can_frame_record_t *r = &s->frames[n];
+    r->timestamp_us = timestamp_us;
+    r->seq = seq;
+    r->msg = *msg;
+    atomic_store_explicit(&s->count, n + 1, memory_order_relaxed);
+    if (--s->post_left == 0) {
+        atomic_store_explicit(&s->state, CAN_TRIGGER_STATE_DONE, memory_order_release);
+    }
+}
+
+void can_trigger_process(uint32_t seq, const twai_message_t *msg, int64_t timestamp_us) {
+    for (int i = 0; i < CAN_TRIGGER_SLOTS; i++) {
+        trigger_slot_t *s = &slots[i];
+        uint32_t state = atomic_load_explicit(&s->state, memory_order_relaxed);
+
+        if (state == CAN_TRIGGER_STATE_ARMED) {
+            if (s->absent) {
+                if (timestamp_us - s->last_seen_us <= s->timeout_us) {
+                    if (slot_matches(s, msg)) {
+                        s->last_seen_us = timestamp_us;
+                    }
+                    continue;
+                }
+                // The silence ended before this frame, which opens the post window
+                fire(s, seq, s->last_seen_us + s->timeout_us);
+            } else if (slot_matches(s, msg)) {
+                fire(s, seq, timestamp_us);
+            } else {
+                continue;
+            }
+            state = CAN_TRIGGER_STATE_CAPTURING;
+        }
+        if (state == CAN_TRIGGER_STATE_CAPTURING) {
+            append(s, seq, msg, timestamp_us);
+        }
+    }
+}
+
+void can_trigger_poll(int64_t now_us) {
+    for (int i = 0; i < CAN_TRIGGER_SLOTS; i++) {
+        trigger_slot_t *s = &slots[i];
+        if (s->absent && atomic_load_explicit(&s->state, memory_order_relaxed) == CAN_TRIGGER_STATE_ARMED &&
+            now_us - s->last_seen_us > s->timeout_us) {
+            fire(s, can_ring_head(), s->last_seen_us + s->timeout_us);
+        }
+    }
+}
+
+esp_err_t can_trigger_arm(const can_trigger_config_t *config, int *slot) {
+    if (config->pre > CAN_TRIGGER_MAX_PRE || config->post == 0 ||
+        config->pre + config->post > CAN_TRIGGER_MAX_FRAMES ||
+        (config->kind == CAN_TRIGGER_ABSENT && config->absent_ms == 0)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    trigger_slot_t *s = NULL;
+    for (int i = 0; i < CAN_TRIGGER_SLOTS; i++) {
+        if (atomic_load_explicit(&slots[i].state, memory_order_acquire) == CAN_TRIGGER_STATE_FREE) {
+            s = &slots[i];
+            *slot = i;
+            break;
+        }
+    }
+    if (s == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    s->frames = malloc((config->pre + config->post) * sizeof(can_frame_record_t));
+    if (s->frames == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+
+    uint32_t id_bits = config->extd ? TWAI_EXTD_ID_MASK : TWAI_STD_ID_MASK;
+    s->config = *config;
+    s->id_mask = (config->id_mask & id_bits) | KEY_EXTD;
+    s->id_code = (config->id & s->id_mask) | (config->extd ? KEY_EXTD : 0);
+    memcpy(&s->data_mask, config->data_mask, sizeof(s->data_mask));
+    memcpy(&s->data_code, config->data, sizeof(s->data_code));
+    s->data_code &= s->data_mask;
+    s->min_dlc = 0;
+    for (int i = 0; i < TWAI_FRAME_MAX_DLC; i++) {
+        if (config->data_mask[i] != 0) {
+            s->min_dlc = i + 1;
+        }
+    }
+    s->absent = (config->kind == CAN_TRIGGER_ABSENT);
+    s->timeout_us = (int64_t)config->absent_ms * 1000;
+    s->last_seen_us = esp_timer_get_time();
+    s->trigger_index = 0;
+    s->trigger_us = 0;
+    atomic_store_explicit(&s->count, 0, memory_order_relaxed);
+    atomic_store_explicit(&s->state, CAN_TRIGGER_STATE_ARMED, memory_order_release);
+    return ESP_OK;
+}
+
+esp_err_t can_trigger_clear(int slot) {
+    if (slot < 0 || slot >= CAN_TRIGGER_SLOTS) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    trigger_slot_t *s = &slots[slot];
+    atomic_store_explicit(&s->state, CAN_TRIGGER_STATE_FREE, memory_order_release);
+    free(s->frames);
+    s->frames = NULL;
+    return ESP_OK;
+}
+
+bool can_trigger_get(int slot, can_trigger_info_t *info) {
+    if (slot < 0 || slot >= CAN_TRIGGER_SLOTS) {
+        return false;
+    }
+    const trigger_slot_t *s = &slots[slot];
+    info->state = atomic_load_explicit(&s->state, memory_order_acquire);
+    if (info->state == CAN_TRIGGER_STATE_FREE) {
+        return false;
+    }
+    info->config = s->config;
+    info->frames = atomic_load_explicit(&s->count, memory_order_relaxed);
+    info->trigger_index = info->state == CAN_TRIGGER_STATE_ARMED ? 0 : s->trigger_index;
+    info->trigger_us = info->state == CAN_TRIGGER_STATE_ARMED ? 0 : s->trigger_us;
+    return true;
+}
+
+const can_frame_record_t *can_trigger_frames(int slot, size_t *count) {
+    if (slot < 0 || slot >= CAN_TRIGGER_SLOTS ||
+        atomic_load_explicit(&slots[slot].state, memory_order_acquire) != CAN_TRIGGER_STATE_DONE) {
+        return NULL;
+    }
+    *count = atomic_load_explicit(&slots[slot].count, memory_order_relaxed);
+    return slots[slot].frames;
+}
+
+static int hex_value(char c) {
+    if (c >= '0' && c <= '9') {
+        return c - '0';
+    }
+    if (c >= 'a' && c <= 'f') {
+        return c - 'a' + 10;
+    }
+    if (c >= 'A' && c <= 'F') {
+        return c - 'A' + 10;
+    }
+    return -1;
+}
+
+esp_err_t can_trigger_parse(const char *text, can_trigger_config_t *config) {
+    const char *p = text;
+    char *end;
+
+    memset(config, 0, sizeof(can_trigger_config_t));
+    config->kind = CAN_TRIGGER_MATCH;
+    config->pre = DEFAULT_PRE;
+    config->post = DEFAULT_POST;
+
+    while (*p == ' ') {
+        p++;
+    }
+    unsigned long id = strtoul(p, &end, 16);
+    if (end == p) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    p = end;
+
+    bool has_mask = false;
+    unsigned long mask = 0;
+    if (*p == '/') {
+        mask = strtoul(p + 1, &end, 16);
+        if (end == p + 1) {
+            return ESP_ERR_INVALID_ARG;
+        }
+        has_mask = true;
+        p = end;
+    }
+    config->extd = id > TWAI_STD_ID_MASK;
+    if (*p == 'x' || *p == 'X') {
+        config->extd = true;
+        p++;
+    }
+    if (id > TWAI_EXTD_ID_MASK) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    uint32_t id_bits = config->extd ? TWAI_EXTD_ID_MASK : TWAI_STD_ID_MASK;
+    config->id = id & id_bits;
+    config->id_mask = has_mask ? (mask & id_bits) : id_bits;
+
+    if (*p == '#') {
+        int nibbles = 0;
+        for (p++; *p != '\0' && *p != ',' && *p != ' '; p++, nibbles++) {
+            int shift = (nibbles & 1) ? 0 : 4;
+            int v = hex_value(*p);
+            if (nibbles >= 2 * TWAI_FRAME_MAX_DLC || (v < 0 && *p != '.')) {
+                return ESP_ERR_INVALID_ARG;
+            }
+            if (v >= 0) {
+                config->data[nibbles / 2] |= v << shift;
+                config->data_mask[nibbles / 2] |= 0x0f << shift;
+            }
+        }
+        if (nibbles & 1) {
+            return ESP_ERR_INVALID_ARG;
+        }
+    }
+
+    while (*p == ',' || *p == ' ') {
+        while (*p == ',' || *p == ' ') {
+            p++;
+        }
+        const char *value;
+        if (strncmp(p, "absent=", 7) == 0) {
+            value = p + 7;
+            config->absent_ms = strtoul(value, &end, 10);
+            config->kind = CAN_TRIGGER_ABSENT;
+        } else if (strncmp(p, "pre=", 4) == 0) {
+            value = p + 4;
+            unsigned long n = strtoul(value, &end, 10);
+            if (n > CAN_TRIGGER_MAX_PRE) {
+                return ESP_ERR_INVALID_SIZE;
+            }
+            config->pre = n;
+        } else if (strncmp(p, "post=", 5) == 0) {
+            value = p + 5;
+            unsigned long n = strtoul(value, &end, 10);
+            if (n > CAN_TRIGGER_MAX_FRAMES) {
+                return ESP_ERR_INVALID_SIZE;
+            }
+            config->post = n;
+        } else if (*p == '\0') {
+            break;
+        } else {
+            return ESP_ERR_INVALID_ARG;
+        }
+        if (end == value) {
+            return ESP_ERR_INVALID_ARG;
+        }
+        p = end;
+    }
+    if (*p != '\0') {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (config->pre + config->post > CAN_TRIGGER_MAX_FRAMES) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    return ESP_OK;
+}
+
+size_t can_trigger_format(const can_trigger_config_t *config, char *dst, size_t size) {
+    static const char hex_digits[] = "0123456789ABCDEF";
+    uint32_t id_bits = config->extd ? TWAI_EXTD_ID_MASK : TWAI_STD_ID_MASK;
+    char data[2 * TWAI_FRAME_MAX_DLC + 2] = "";
+    int last = -1;
+
+    for (int i = 0; i < TWAI_FRAME_MAX_DLC; i++) {
+        if (config->data_mask[i] != 0) {
+            last = i;
+        }
+    }
+    if (last >= 0) {
+        char *p = data;
+        *p++ = '#';
+        for (int i = 0; i <= last; i++) {
+            *p++ = (config->data_mask[i] & 0xf0) ? hex_digits[config->data[i] >> 4] : '.';
+            *p++ = (config->data_mask[i] & 0x0f) ? hex_digits[config->data[i] & 0x0f] : '.';
+        }
+        *p = '\0';
+    }
+
+    int len = snprintf(dst, size, "%lX", (unsigned long)config->id);
+    if (config->id_mask != id_bits) {
+        len += snprintf(dst + len, size - len, "/%lX", (unsigned long)config->id_mask);
+    }
+    len += snprintf(dst + len, size - len, "%s%s", config->extd ? "x" : "", data);
+    if (config->kind == CAN_TRIGGER_ABSENT) {
+        len += snprintf(dst + len, size - len, ",absent=%lu", (unsigned long)config->absent_ms);
+    }
+    len += snprintf(dst + len, size - len, ",pre=%u,post=%u", config->pre, config->post);
+    return (size_t)len < size ? (size_t)len : size - 1;
+}
\ No newline at end of file
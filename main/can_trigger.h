@@ -0,0 +1,86 @@
+// can_trigger.h
+#ifndef CAN_TRIGGER_H
+#define CAN_TRIGGER_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stddef.h>
+#include "esp_err.h"
+#include "driver/twai.h"
+#include "can_ring.h"
+
+// Logic-analyzer style captures. Each armed slot freezes the frames around
+// its trigger: up to pre frames before it, taken from the frame ring, and post
+// frames from the trigger on. Slots are independent and live streaming is not
+// affected.
+#define CAN_TRIGGER_SLOTS 4
+#define CAN_TRIGGER_MAX_PRE (CAN_RING_SIZE - 1)
+#define CAN_TRIGGER_MAX_FRAMES 2048
+
+typedef enum {
+    CAN_TRIGGER_MATCH,          // A frame matches identifier and data pattern
+    CAN_TRIGGER_ABSENT,         // No matching frame for absent_ms
+} can_trigger_kind_t;
+
+// A frame matches when (identifier & id_mask) == (id & id_mask), the format
+// is the same and every data bit set in data_mask equals the one in data.
+typedef struct {
+    can_trigger_kind_t kind;
+    uint32_t id;
+    uint32_t id_mask;
+    bool extd;
+    uint8_t data[TWAI_FRAME_MAX_DLC];
+    uint8_t data_mask[TWAI_FRAME_MAX_DLC];
+    uint32_t absent_ms;
+    uint16_t pre;
+    uint16_t post;
+} can_trigger_config_t;
+
+typedef enum {
+    CAN_TRIGGER_STATE_FREE,
+    CAN_TRIGGER_STATE_ARMED,
+    CAN_TRIGGER_STATE_CAPTURING,
+    CAN_TRIGGER_STATE_DONE,
+} can_trigger_state_t;
+
+typedef struct {
+    can_trigger_state_t state;
+    can_trigger_config_t config;
+    uint32_t frames;            // Frames captured so far
+    uint32_t trigger_index;     // Position of the first frame at or after the trigger
+    int64_t trigger_us;
+} can_trigger_info_t;
+
+// Parses "ID[/MASK][x][#DATA][,absent=MS][,pre=N][,post=N]". ID, MASK and
+// DATA are hexadecimal; a '.' in DATA is a nibble that is not compared.
+// Defaults are 100 frames before and after the trigger.
+esp_err_t can_trigger_parse(const char *text, can_trigger_config_t *config);
+
+// Longest text can_trigger_format produces, terminator included.
+#define CAN_TRIGGER_TEXT_MAX 96
+
+// Inverse of can_trigger_parse.
+size_t can_trigger_format(const can_trigger_config_t *config, char *dst, size_t size);
+
+// Compiles the condition into a free slot and allocates its capture buffer.
+// Must not run concurrently with can_trigger_process and can_trigger_poll.
+esp_err_t can_trigger_arm(const can_trigger_config_t *config, int *slot);
+
+// Disarms a slot or discards its capture. Same restriction as can_trigger_arm.
+esp_err_t can_trigger_clear(int slot);
+
+// Evaluates the armed slots against a frame just pushed to the ring with
+// sequence number seq, and appends it to the slots that are capturing.
+// Called from the receive task; allocation-free.
+void can_trigger_process(uint32_t seq, const twai_message_t *msg, int64_t timestamp_us);
+
+// Fires absence triggers whose timeout passed while no frame arrived.
+void can_trigger_poll(int64_t now_us);
+
+bool can_trigger_get(int slot, can_trigger_info_t *info);
+
+// Frames of a completed capture, NULL unless the slot is in the DONE state.
+// They stay valid until the slot is cleared.
+const can_frame_record_t *can_trigger_frames(int slot, size_t *count);
+
+#endif // CAN_TRIGGER_H
\ No newline at end of file
@@ -0,0 +1,414 @@
+#include "can_tx.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define TAG "CAN_TX"
+
+typedef struct {
+    bool in_use;
+    esp_timer_handle_t timer;
+    can_tx_config_t config;
+    uint32_t counter;
+
+    // Written by the timer callback under tx_lock
+    int64_t last_us;
+    uint32_t intervals;
+    uint64_t jitter_sum_us;
+    can_tx_stats_t stats;
+} tx_entry_t;
+
+static const can_driver_t *driver;
+static tx_entry_t entries[CAN_TX_MAX_PERIODIC];
+static portMUX_TYPE tx_lock = portMUX_INITIALIZER_UNLOCKED;
+static SemaphoreHandle_t table_mutex;   // Serialises changes to the table
+
+static uint8_t crc8_j1850(const uint8_t *data, int len, int skip) {
+    uint8_t crc = 0xff;
+    for (int i = 0; i < len; i++) {
+        if (i == skip) {
+            continue;
+        }
+        crc ^= data[i];
+        for (int bit = 0; bit < 8; bit++) {
+            crc = (crc & 0x80) ? (crc << 1) ^ 0x1d : crc << 1;
+        }
+    }
+    return crc ^ 0xff;
+}
+
+// Writes the counter value and then the checksum, which covers the counter
+static void apply_updates(const can_tx_config_t *config, uint32_t counter, twai_message_t *msg) {
+    int dlc = msg->data_length_code > TWAI_FRAME_MAX_DLC ? TWAI_FRAME_MAX_DLC : msg->data_length_code;
+
+    if (config->counter_byte >= 0 && config->counter_mask != 0) {
+        uint8_t mask = config->counter_mask;
+        int shift = __builtin_ctz(mask);
+        uint8_t *b = &msg->data[config->counter_byte];
+        *b = (*b & ~mask) | ((counter << shift) & mask);
+    }
+    if (config->checksum_byte < 0 || config->checksum == CAN_TX_CHECKSUM_NONE) {
+        return;
+    }
+    uint8_t sum = 0;
+    switch (config->checksum) {
+    case CAN_TX_CHECKSUM_SUM8:
+    case CAN_TX_CHECKSUM_XOR8:
+        for (int i = 0; i < dlc; i++) {
+            if (i != config->checksum_byte) {
+                sum = config->checksum == CAN_TX_CHECKSUM_SUM8 ? sum + msg->data[i] : sum ^ msg->data[i];
+            }
+        }
+        break;
+    case CAN_TX_CHECKSUM_CRC8:
+        sum = crc8_j1850(msg->data, dlc, config->checksum_byte);
+        break;
+    case CAN_TX_CHECKSUM_NONE:
+        break;
+    }
+    msg->data[config->checksum_byte] = sum;
+}
+
+// Runs on the esp_timer task. The frame is copied under the lock and
+// completed outside it, so the critical sections stay a few dozen cycles.
+static void tx_timer_callback(void *arg) {
+    tx_entry_t *e = (tx_entry_t *)arg;
+    int64_t now_us = esp_timer_get_time();
+    can_tx_config_t config;
+    uint32_t counter;
+
+    taskENTER_CRITICAL(&tx_lock);
+    config = e->config;
+    counter = e->counter++;
+    taskEXIT_CRITICAL(&tx_lock);
+
+    apply_updates(&config, counter, &config.msg);
+    esp_err_t err = driver->transmit(&config.msg, 0);
+
+    taskENTER_CRITICAL(&tx_lock);
+    if (err == ESP_OK) {
+        e->stats.sent++;
+    } else {
+        e->stats.errors++;
+    }
+    if (e->last_us != 0) {
+        uint32_t period = now_us - e->last_us;
+        uint32_t jitter = period > config.period_us ? period - config.period_us : config.period_us - period;
+        if (e->intervals == 0 || period < e->stats.period_min_us) {
+            e->stats.period_min_us = period;
+        }
+        if (period > e->stats.period_max_us) {
+            e->stats.period_max_us = period;
+        }
+        if (jitter > e->stats.jitter_max_us) {
+            e->stats.jitter_max_us = jitter;
+        }
+        e->jitter_sum_us += jitter;
+        e->intervals++;
+    }
+    e->last_us = now_us;
+    taskEXIT_CRITICAL(&tx_lock);
+}
+
+esp_err_t can_tx_init(const can_driver_t *can_driver) {
+    driver = can_driver;
+    table_mutex = xSemaphoreCreateMutex();
+    if (table_mutex == NULL) {
+        ESP_LOGE(TAG, "Failed to create TX table mutex");
+        return ESP_ERR_NO_MEM;
+    }
+    return ESP_OK;
+}
+
+esp_err_t can_tx_send(const twai_message_t *msg, uint32_t timeout_ms) {
+    esp_err_t err = driver->transmit(msg, timeout_ms);
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "Failed to send 0x%lx: %s", (unsigned long)msg->identifier, esp_err_to_name(err));
+    }
+    return err;
+}
+
+static void reset_stats(tx_entry_t *e) {
+    e->last_us = 0;
+    e->intervals = 0;
+    e->jitter_sum_us = 0;
+    memset(&e->stats, 0, sizeof(e->stats));
+}
+
+static esp_err_t set_periodic(const can_tx_config_t *config, int *slot) {
+    tx_entry_t *e = NULL;
+    tx_entry_t *free_entry = NULL;
+    for (int i = 0; i < CAN_TX_MAX_PERIODIC; i++) {
+        if (!entries[i].in_use) {
+            free_entry = free_entry ? free_entry : &entries[i];
+        } else if (entries[i].config.msg.identifier == config->msg.identifier &&
+                   entries[i].config.msg.extd == config->msg.extd) {
+            e = &entries[i];
+        }
+    }
+
+    if (e != NULL) {
+        bool restart = e->config.period_us != config->period_us;
+        if (restart) {
+            esp_timer_stop(e->timer);
+        }
+        taskENTER_CRITICAL(&tx_lock);
+        e->config = *config;
+        if (restart) {
+            reset_stats(e);
+        }
+        taskEXIT_CRITICAL(&tx_lock);
+        *slot = e - entries;
+        return restart ? esp_timer_start_periodic(e->timer, config->period_us) : ESP_OK;
+    }
+
+    if (free_entry == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    e = free_entry;
+    e->config = *config;
+    e->counter = 0;
+    reset_stats(e);
+    esp_timer_create_args_t args = {
+        .callback = tx_timer_callback,
+        .arg = e,
+        .dispatch_method = ESP_TIMER_TASK,
+        .name = "can_tx",
+        .skip_unhandled_events = true,  // A late callback sends once, not a burst
+    };
+    esp_err_t err = esp_timer_create(&args, &e->timer);
+    if (err != ESP_OK) {
+        return err;
+    }
+    err = esp_timer_start_periodic(e->timer, config->period_us);
+    if (err != ESP_OK) {
+        esp_timer_delete(e->timer);
+        return err;
+    }
+    e->in_use = true;
+    *slot = e - entries;
+    return ESP_OK;
+}
+
+esp_err_t can_tx_request(const can_tx_config_t *config, int *slot) {
+    if (config->period_us == 0) {
+        twai_message_t msg = config->msg;
+        apply_updates(config, 0, &msg);
+        *slot = -1;
+        return can_tx_send(&msg, 0);
+    }
+    if (config->period_us < CAN_TX_MIN_PERIOD_US) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    xSemaphoreTake(table_mutex, portMAX_DELAY);
+    esp_err_t err = set_periodic(config, slot);
+    xSemaphoreGive(table_mutex);
+    return err;
+}
+
+// Timer callbacks run on the esp_timer task, which outranks every caller, so
+// once the timer is stopped none of them is still using the entry.
+static void stop_entry(tx_entry_t *e) {
+    esp_timer_stop(e->timer);
+    esp_timer_delete(e->timer);
+    e->in_use = false;
+}
+
+esp_err_t can_tx_stop(int slot) {
+    if (slot < 0 || slot >= CAN_TX_MAX_PERIODIC) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    esp_err_t err = ESP_ERR_NOT_FOUND;
+    xSemaphoreTake(table_mutex, portMAX_DELAY);
+    if (entries[slot].in_use) {
+        stop_entry(&entries[slot]);
+        err = ESP_OK;
+    }
+    xSemaphoreGive(table_mutex);
+    return err;
+}
+
+void can_tx_stop_all(void) {
+    xSemaphoreTake(table_mutex, portMAX_DELAY);
+    for (int i = 0; i < CAN_TX_MAX_PERIODIC; i++) {
+        if (entries[i].in_use) {
+            stop_entry(&entries[i]);
+        }
+    }
+    xSemaphoreGive(table_mutex);
+}
+
+bool can_tx_get(int slot, can_tx_config_t *config, can_tx_stats_t *stats) {
+    if (slot < 0 || slot >= CAN_TX_MAX_PERIODIC || !entries[slot].in_use) {
+        return false;
+    }
+    tx_entry_t *e = &entries[slot];
+    taskENTER_CRITICAL(&tx_lock);
+    *config = e->config;
+    *stats = e->stats;
+    uint64_t jitter_sum = e->jitter_sum_us;
+    uint32_t intervals = e->intervals;
+    taskEXIT_CRITICAL(&tx_lock);
+    stats->jitter_avg_us = intervals ? jitter_sum / intervals : 0;
+    return true;
+}
+
+static int hex_value(char c) {
+    if (c >= '0' && c <= '9') {
+        return c - '0';
+    }
+    if (c >= 'a' && c <= 'f') {
+        return c - 'a' + 10;
+    }
+    if (c >= 'A' && c <= 'F') {
+        return c - 'A' + 10;
+    }
+    return -1;
+}
+
+static bool parse_byte_index(const char **p, int8_t *index, int dlc) {
+    char *end;
+    unsigned long n = strtoul(*p, &end, 10);
+    if (end == *p || n >= (unsigned long)dlc) {
+        return false;
+    }
+    *index = n;
+    *p = end;
+    return true;
+}
+
+esp_err_t can_tx_parse(const char *text, can_tx_config_t *config) {
+    const char *p = text;
+    char *end;
+
+    memset(config, 0, sizeof(can_tx_config_t));
+    config->counter_byte = -1;
+    config->checksum_byte = -1;
+
+    while (*p == ' ') {
+        p++;
+    }
+    unsigned long id = strtoul(p, &end, 16);
+    if (end == p || id > TWAI_EXTD_ID_MASK) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    p = end;
+    config->msg.extd = id > TWAI_STD_ID_MASK;
+    if (*p == 'x' || *p == 'X') {
+        config->msg.extd = true;
+        p++;
+    }
+    config->msg.identifier = id;
+    if (*p++ != '#') {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    if (*p == 'R' || *p == 'r') {
+        config->msg.rtr = true;
+        p++;
+    } else {
+        int n = 0;
+        while (hex_value(p[0]) >= 0 && hex_value(p[1]) >= 0) {
+            if (n == TWAI_FRAME_MAX_DLC) {
+                return ESP_ERR_INVALID_SIZE;
+            }
+            config->msg.data[n++] = (hex_value(p[0]) << 4) | hex_value(p[1]);
+            p += 2;
+        }
+        config->msg.data_length_code = n;
+    }
+    int dlc = config->msg.data_length_code;
+
+    while (*p == ',') {
+        p++;
+        if (strncmp(p, "period=", 7) == 0) {
+            unsigned long n = strtoul(p + 7, &end, 10);
+            if (end == p + 7) {
+                return ESP_ERR_INVALID_ARG;
+            }
+            p = end;
+            if (strncmp(p, "us", 2) == 0) {
+                p += 2;
+            } else {
+                if (strncmp(p, "ms", 2) == 0) {
+                    p += 2;
+                }
+                n *= 1000;
+            }
+            config->period_us = n;
+        } else if (strncmp(p, "counter=", 8) == 0) {
+            p += 8;
+            if (!parse_byte_index(&p, &config->counter_byte, dlc)) {
+                return ESP_ERR_INVALID_ARG;
+            }
+            config->counter_mask = 0xff;
+            if (*p == '/') {
+                unsigned long mask = strtoul(p + 1, &end, 16);
+                if (end == p + 1 || mask == 0 || mask > 0xff) {
+                    return ESP_ERR_INVALID_ARG;
+                }
+                config->counter_mask = mask;
+                p = end;
+            }
+        } else if (strncmp(p, "checksum=", 9) == 0) {
+            p += 9;
+            if (!parse_byte_index(&p, &config->checksum_byte, dlc)) {
+                return ESP_ERR_INVALID_ARG;
+            }
+            config->checksum = CAN_TX_CHECKSUM_CRC8;
+            if (*p == '/') {
+                p++;
+                if (strncmp(p, "sum", 3) == 0) {
+                    config->checksum = CAN_TX_CHECKSUM_SUM8;
+                    p += 3;
+                } else if (strncmp(p, "xor", 3) == 0) {
+                    config->checksum = CAN_TX_CHECKSUM_XOR8;
+                    p += 3;
+                } else if (strncmp(p, "crc8", 4) == 0) {
+                    p += 4;
+                } else {
+                    return ESP_ERR_INVALID_ARG;
+                }
+            }
+        } else {
+            return ESP_ERR_INVALID_ARG;
+        }
+    }
+    while (*p == ' ') {
+        p++;
+    }
+    if (*p != '\0' || (config->counter_byte >= 0 && config->counter_byte == config->checksum_byte)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    return ESP_OK;
+}
+
+size_t can_tx_format(const can_tx_config_t *config, char *dst, size_t size) {
+    static const char *checksums[] = { "", "sum", "xor", "crc8" };
+    const twai_message_t *msg = &config->msg;
+    int len = snprintf(dst, size, msg->extd ? "%08lXx#" : "%03lX#", (unsigned long)msg->identifier);
+
+    if (msg->rtr) {
+        len += snprintf(dst + len, size - len, "R");
+    }
+    for (int i = 0; !msg->rtr && i < msg->data_length_code && i < TWAI_FRAME_MAX_DLC; i++) {
+        len += snprintf(dst + len, size - len, "%02X", msg->data[i]);
+    }
+    if (config->period_us % 1000 == 0) {
+        len += snprintf(dst + len, size - len, ",period=%lums", (unsigned long)config->period_us / 1000);
+    } else {
+        len += snprintf(dst + len, size - len, ",period=%luus", (unsigned long)config->period_us);
+    }
+    if (config->counter_byte >= 0) {
+        len += snprintf(dst + len, size - len, ",counter=%d/%02X", config->counter_byte, config->counter_mask);
+    }
+    if (config->checksum_byte >= 0 && config->checksum != CAN_TX_CHECKSUM_NONE) {
+        len += snprintf(dst + len, size - len, ",checksum=%d/%s", config->checksum_byte, checksums[config->checksum]);
+    }
+    return (size_t)len < size ? (size_t)len : size - 1;
+}
\ No newline at end of file
@@ -0,0 +1,72 @@
+// can_tx.h
+#ifndef CAN_TX_H
+#define CAN_TX_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stddef.h>
+#include "esp_err.h"
+#include "driver/twai.h"
+#include "can_driver.h"
+
+// Transmit subsystem: single frames, and a table of periodic messages each
+// driven by its own esp_timer, so cycle times are not tied to the 10 ms tick.
+#define CAN_TX_MAX_PERIODIC 16
+#define CAN_TX_MIN_PERIOD_US 500
+
+// Longest text can_tx_format produces, terminator included.
+#define CAN_TX_TEXT_MAX 112
+
+typedef enum {
+    CAN_TX_CHECKSUM_NONE,
+    CAN_TX_CHECKSUM_SUM8,       // Sum of the other data bytes, modulo 256
+    CAN_TX_CHECKSUM_XOR8,       // XOR of the other data bytes
+    CAN_TX_CHECKSUM_CRC8,       // SAE J1850 CRC-8 (poly 0x1D, init and xorout 0xFF)
+} can_tx_checksum_t;
+
+typedef struct {
+    twai_message_t msg;
+    uint32_t period_us;         // 0 sends the frame once
+    int8_t counter_byte;        // Data byte holding a rolling counter, -1 for none
+    uint8_t counter_mask;       // Bits of that byte the counter occupies
+    int8_t checksum_byte;       // Data byte holding the checksum, -1 for none
+    can_tx_checksum_t checksum;
+} can_tx_config_t;
+
+// Measured on the instants the timer fired, one sample per period.
+typedef struct {
+    uint32_t sent;
+    uint32_t errors;            // Frames the driver refused, e.g. TX queue full
+    uint32_t period_min_us;
+    uint32_t period_max_us;
+    uint32_t jitter_avg_us;     // Mean |period - nominal|
+    uint32_t jitter_max_us;
+} can_tx_stats_t;
+
+// driver is called from the esp_timer task and from callers of can_tx_send,
+// so on the device it is the one from can_get_tx_driver; frames it refuses
+// while the controller is restarted count as errors.
+esp_err_t can_tx_init(const can_driver_t *driver);
+
+// Queues one frame for transmission, waiting up to timeout_ms for room.
+esp_err_t can_tx_send(const twai_message_t *msg, uint32_t timeout_ms);
+
+// Parses "ID[x]#DATA|R[,period=N[ms|us]][,counter=BYTE[/MASK]][,checksum=BYTE[/sum|xor|crc8]]".
+// ID, DATA and MASK are hexadecimal, the period defaults to milliseconds.
+esp_err_t can_tx_parse(const char *text, can_tx_config_t *config);
+
+// Inverse of can_tx_parse.
+size_t can_tx_format(const can_tx_config_t *config, char *dst, size_t size);
+
+// Sends the frame once when config->period_us is 0 (*slot is then -1).
+// Otherwise starts it in the periodic table, replacing the entry that has
+// the same identifier; a running entry keeps its counter.
+esp_err_t can_tx_request(const can_tx_config_t *config, int *slot);
+
+esp_err_t can_tx_stop(int slot);
+void can_tx_stop_all(void);
+
+// Copies an entry of the periodic table. Returns false if the slot is free.
+bool can_tx_get(int slot, can_tx_config_t *config, can_tx_stats_t *stats);
+
+#endif // CAN_TX_H
\ No newline at end of file
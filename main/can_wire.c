@@ -0,0 +1,50 @@
+#include "can_wire.h"
+#include <string.h>
+
+static inline uint8_t *put_u16(uint8_t *p, uint16_t v) {
+    p[0] = v;
+    p[1] = v >> 8;
+    return p + 2;
+}
+
+static inline uint8_t *put_u32(uint8_t *p, uint32_t v) {
+    p[0] = v;
+    p[1] = v >> 8;
+    p[2] = v >> 16;
+    p[3] = v >> 24;
+    return p + 4;
+}
+
+static inline uint8_t *put_u64(uint8_t *p, uint64_t v) {
+    p = put_u32(p, (uint32_t)v);
+    return put_u32(p, (uint32_t)(v >> 32));
+}
+
+size_t can_wire_encode_batch(uint8_t *dst, const can_frame_record_t *records, size_t count, uint32_t gap) {
+    int64_t base_us = count > 0 ? records[0].timestamp_us : 0;
+    uint8_t *p = dst;
+
+    *p++ = CAN_WIRE_MAGIC;
+    *p++ = CAN_WIRE_VERSION;
+    p = put_u16(p, count);
+    p = put_u32(p, gap);
+    p = put_u64(p, base_us);
+
+    for (size_t i = 0; i < count; i++) {
+        const can_frame_record_t *rec = &records[i];
+        uint8_t dlc = rec->msg.data_length_code;
+        if (dlc > TWAI_FRAME_MAX_DLC) {
+            dlc = TWAI_FRAME_MAX_DLC;
+        }
+
+        p = put_u32(p, rec->seq);
+        p = put_u32(p, (uint32_t)(rec->timestamp_us - base_us));
+        p = put_u32(p, rec->msg.identifier);
+        *p++ = (rec->msg.extd ? CAN_WIRE_FLAG_EXTD : 0) | (rec->msg.rtr ? CAN_WIRE_FLAG_RTR : 0);
+        *p++ = dlc;
+        memcpy(p, rec->msg.data, dlc);
+        memset(p + dlc, 0, TWAI_FRAME_MAX_DLC - dlc);
+        p += TWAI_FRAME_MAX_DLC;
+    }
+    return p - dst;
+}
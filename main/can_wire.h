@@ -0,0 +1,41 @@
+// can_wire.h
+#ifndef CAN_WIRE_H
+#define CAN_WIRE_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "can_ring.h"
+
+// Binary batch sent over HTTPD_WS_TYPE_BINARY. All fields little-endian.
+//
+// Header (CAN_WIRE_HEADER_SIZE bytes):
+//   u8  magic        CAN_WIRE_MAGIC
+//   u8  version      CAN_WIRE_VERSION
+//   u16 count        number of records that follow
+//   u32 gap          frames skipped just before this batch
+//   u64 base_us      esp_timer timestamp the record deltas refer to
+//
+// Record (CAN_WIRE_RECORD_SIZE bytes):
+//   u32 seq          ring sequence number
+//   u32 delta_us     timestamp - base_us
+//   u32 identifier   11 or 29 bit identifier
+//   u8  flags        CAN_WIRE_FLAG_*
+//   u8  dlc          0-8, larger DLC values are clamped to 8
+//   u8  data[8]      unused bytes are zero
+#define CAN_WIRE_MAGIC 0x43
+#define CAN_WIRE_VERSION 1
+#define CAN_WIRE_HEADER_SIZE 16
+#define CAN_WIRE_RECORD_SIZE 22
+
+#define CAN_WIRE_FLAG_EXTD 0x01
+#define CAN_WIRE_FLAG_RTR  0x02
+
+static inline size_t can_wire_batch_size(size_t count) {
+    return CAN_WIRE_HEADER_SIZE + count * CAN_WIRE_RECORD_SIZE;
+}
+
+// Encodes count records into dst, which must hold can_wire_batch_size(count)
+// bytes. Returns the number of bytes written.
+size_t can_wire_encode_batch(uint8_t *dst, const can_frame_record_t *records, size_t count, uint32_t gap);
+
+#endif // CAN_WIRE_H
@@ -1,156 +1,326 @@
+#include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
+#include <unistd.h>
+#include <stdarg.h>
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include "esp_system.h"
 #include "esp_wifi.h"
 #include "esp_event.h"
 #include "esp_log.h"
+#include "esp_timer.h"
 #include "nvs_flash.h"
 #include "lwip/err.h"
 #include "lwip/sys.h"
 #include "esp_http_server.h"
 #include "esp_mac.h"
 #include "CAN.h"
+#include "can_history.h"
+#include "can_ring.h"
+#include "can_monitor.h"
+#include "can_stats.h"
+#include "can_log.h"
+#include "can_debug.h"
+#include "can_dbc.h"
+#include "can_trigger.h"
+#include "can_bridge.h"
+#include "can_tx.h"
+#include "can_format.h"
+#include "storage.h"
+#include "can_metrics.h"
+#include "ws_stream.h"
 
 #define EXAMPLE_ESP_WIFI_SSID      "ESP32_CAN_Viewer"
 #define EXAMPLE_ESP_WIFI_PASS      ""
 #define EXAMPLE_MAX_STA_CONN       4
-#define MAX_CAN_MESSAGES 100
+#define CAN_CONSUMER_BATCH 32
+#define CAN_CONSUMER_INTERVAL_MS 10
+#define MONITOR_JSON_SIZE (CAN_MONITOR_MAX_IDS * 64)
+#define STATS_CHUNK_SIZE 1024
+#define METRICS_CHUNK_SIZE 1024
+#define DBC_CHUNK_SIZE 1024
+#define HISTORY_CHUNK_SIZE 1024
+#define HISTORY_WS_SEPARATOR "<br><br>"
+#define HISTORY_WS_PREFIX "H:"
+#define METRICS_LINE_MAX 160
+#define LOG_MAX_SEGMENTS 64
+#define TRIGGER_CHUNK_SIZE 2048
+#define TX_JSON_SIZE (CAN_TX_MAX_PERIODIC * (CAN_TX_TEXT_MAX + 160) + 8)
+#define FILTER_TEXT_SIZE (CAN_FILTER_MAX_RULES * 24 + 32)
 
 static const char *TAG = "wifi softAP";
 static httpd_handle_t server = NULL;
 
-static char can_messages[MAX_CAN_MESSAGES][100];
-static int message_count = 0;
-static int message_index = 0;
-static SemaphoreHandle_t can_buffer_mutex;
+static void wifi_event_handler(void* arg, esp_event_base_t event_base,
+                               int32_t event_id, void* event_data)
+{
+    if (event_id == WIFI_EVENT_AP_STACONNECTED) {
+        wifi_event_ap_staconnected_t* event = (wifi_event_ap_staconnected_t*) event_data;
+        ESP_LOGI(TAG, "Station "MACSTR" joined, AID=%d",
+                 MAC2STR(event->mac), event->aid);
+    } else if (event_id == WIFI_EVENT_AP_STADISCONNECTED) {
+        wifi_event_ap_stadisconnected_t* event = (wifi_event_ap_stadisconnected_t*) event_data;
+        ESP_LOGI(TAG, "Station "MACSTR" left, AID=%d",
+                 MAC2STR(event->mac), event->aid);
+    }
+}
 
-void add_can_message(const char* message) {
-    xSemaphoreTake(can_buffer_mutex, portMAX_DELAY);
-    
-    // Verificar si el mensaje ya existe en el buffer
-    bool message_exists = false;
-    for (int i = 0; i < message_count; i++) {
-        int index = (message_index - message_count + i + MAX_CAN_MESSAGES) % MAX_CAN_MESSAGES;
-        if (strcmp(can_messages[index], message) == 0) {
-            message_exists = true;
-            break;
+// Web UI files from main/web, embedded gzip-compressed by main/CMakeLists.txt
+extern const uint8_t index_html_gz_start[] asm("_binary_index_html_gz_start");
+extern const uint8_t index_html_gz_end[] asm("_binary_index_html_gz_end");
+extern const uint8_t app_js_gz_start[] asm("_binary_app_js_gz_start");
+extern const uint8_t app_js_gz_end[] asm("_binary_app_js_gz_end");
+
+typedef struct {
+    const uint8_t *start;
+    const uint8_t *end;
+    const char *type;
+    const char *cache_control;
+    char etag[12];              // Quoted hash of the compressed file
+} web_asset_t;
+
+// index.html is revalidated on each load, so a firmware update shows at
+// once; it asks for app.js by content hash, so that one never expires.
+static web_asset_t web_index = {
+    index_html_gz_start, index_html_gz_end, "text/html", "no-cache"
+};
+static web_asset_t web_app_js = {
+    app_js_gz_start, app_js_gz_end, "application/javascript", "public, max-age=31536000, immutable"
+};
+
+static void web_asset_init(web_asset_t *asset)
+{
+    uint32_t hash = 2166136261u;    // FNV-1a
+    for (const uint8_t *p = asset->start; p < asset->end; p++) {
+        hash = (hash ^ *p) * 16777619u;
+    }
+    snprintf(asset->etag, sizeof(asset->etag), "\"%08lx\"", (unsigned long)hash);
+}
+
+static esp_err_t web_asset_handler(httpd_req_t *req)
+{
+    const web_asset_t *asset = req->user_ctx;
+    char if_none_match[sizeof(asset->etag)];
+
+    httpd_resp_set_hdr(req, "ETag", asset->etag);
+    httpd_resp_set_hdr(req, "Cache-Control", asset->cache_control);
+    if (httpd_req_get_hdr_value_str(req, "If-None-Match", if_none_match, sizeof(if_none_match)) == ESP_OK &&
+        strcmp(if_none_match, asset->etag) == 0) {
+        httpd_resp_set_status(req, "304 Not Modified");
+        return httpd_resp_send(req, NULL, 0);
+    }
+    httpd_resp_set_type(req, asset->type);
+    httpd_resp_set_hdr(req, "Content-Encoding", "gzip");
+    return httpd_resp_send(req, (const char *)asset->start, asset->end - asset->start);
+}
+
+static esp_err_t ws_send_text(httpd_req_t *req, const char *text)
+{
+    httpd_ws_frame_t ws_pkt = {
+        .final = true,
+        .type = HTTPD_WS_TYPE_TEXT,
+        .payload = (uint8_t *)text,
+        .len = strlen(text),
+    };
+
+    int64_t start_us = esp_timer_get_time();
+    esp_err_t ret = httpd_ws_send_frame(req, &ws_pkt);
+    can_metrics_observe(CAN_HIST_WS_SEND, esp_timer_get_time() - start_us);
+    if (ret != ESP_OK) {
+        can_metrics_add(CAN_METRIC_WS_SEND_ERRORS, 1);
+        ESP_LOGE(TAG, "httpd_ws_send_frame failed with %d", ret);
+    } else {
+        can_metrics_add(CAN_METRIC_WS_BYTES, ws_pkt.len);
+    }
+    return ret;
+}
+
+// Sends the history as one "H:" text message split into continuation
+// frames of HISTORY_CHUNK_SIZE, so it never has to be assembled in RAM. One
+// chunk is read ahead to know which frame is the final one.
+static esp_err_t ws_send_history(httpd_req_t *req)
+{
+    char *chunks = malloc(2 * HISTORY_CHUNK_SIZE);
+    if (chunks == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+
+    can_history_cursor_t cursor;
+    can_history_cursor_init(&cursor);
+    int current = 0;
+    size_t prefix = sizeof(HISTORY_WS_PREFIX) - 1;
+    memcpy(chunks, HISTORY_WS_PREFIX, prefix);
+    size_t len = prefix + can_history_read(&cursor, HISTORY_WS_SEPARATOR, chunks + prefix, HISTORY_CHUNK_SIZE - prefix);
+    httpd_ws_frame_t ws_pkt = {
+        .type = HTTPD_WS_TYPE_TEXT,
+        .fragmented = true,
+    };
+    esp_err_t ret = ESP_OK;
+    size_t total = 0;
+
+    int64_t start_us = esp_timer_get_time();
+    do {
+        char *next_chunk = chunks + (1 - current) * HISTORY_CHUNK_SIZE;
+        size_t next_len = len > 0 ? can_history_read(&cursor, HISTORY_WS_SEPARATOR, next_chunk, HISTORY_CHUNK_SIZE) : 0;
+
+        ws_pkt.payload = (uint8_t *)chunks + current * HISTORY_CHUNK_SIZE;
+        ws_pkt.len = len;
+        ws_pkt.final = next_len == 0;
+        if (ws_pkt.type == HTTPD_WS_TYPE_TEXT && ws_pkt.final) {
+            // Single frame: no need to announce fragmentation
+            ws_pkt.fragmented = false;
         }
+        ret = httpd_ws_send_frame(req, &ws_pkt);
+        total += len;
+        ws_pkt.type = HTTPD_WS_TYPE_CONTINUE;
+        current = 1 - current;
+        len = next_len;
+    } while (ret == ESP_OK && len > 0);
+    can_metrics_observe(CAN_HIST_WS_SEND, esp_timer_get_time() - start_us);
+    free(chunks);
+
+    if (ret != ESP_OK) {
+        can_metrics_add(CAN_METRIC_WS_SEND_ERRORS, 1);
+        ESP_LOGE(TAG, "History send failed with %d", ret);
+    } else {
+        can_metrics_add(CAN_METRIC_WS_BYTES, total);
     }
-    
-    // Si el mensaje no existe, agregarlo al buffer
-    if (!message_exists) {
-        strncpy(can_messages[message_index], message, 99);
-        can_messages[message_index][99] = '\0';
-        message_index = (message_index + 1) % MAX_CAN_MESSAGES;
-        if (message_count < MAX_CAN_MESSAGES) {
-            message_count++;
+    return ret;
+}
+
+// "filter:<rules>" sets the list (empty accepts everything), "filter?" queries it.
+// The reply is "filter:ok:<active rules>" or "filter:error:<reason>".
+static esp_err_t ws_handle_filter(httpd_req_t *req, const char *rules_text)
+{
+    can_filter_rule_t rules[CAN_FILTER_MAX_RULES];
+    char reply[FILTER_TEXT_SIZE];
+    size_t count;
+    esp_err_t err = ESP_OK;
+
+    if (rules_text != NULL) {
+        err = can_filter_parse(rules_text, rules, &count);
+        if (err == ESP_OK) {
+            err = can_set_filters(rules, count, true);
         }
     }
-    
-    xSemaphoreGive(can_buffer_mutex);
+
+    if (err != ESP_OK) {
+        snprintf(reply, sizeof(reply), "filter:error:%s", esp_err_to_name(err));
+    } else {
+        count = can_get_filters(rules);
+        int len = snprintf(reply, sizeof(reply), "filter:ok:");
+        can_filter_format(rules, count, reply + len, sizeof(reply) - len);
+    }
+    return ws_send_text(req, reply);
 }
 
-char* get_all_can_messages() {
-    static char all_messages[MAX_CAN_MESSAGES * 200];
-    all_messages[0] = '\0';
+// "debug:<lines per second>[/<sample>]" sets the console trace, 0 turns it
+// off; "debug?" queries it. The reply is "debug:ok:<rate>/<sample>".
+static esp_err_t ws_handle_debug(httpd_req_t *req, const char *args)
+{
+    char reply[48];
+    uint32_t rate;
+    uint32_t sample;
 
-    xSemaphoreTake(can_buffer_mutex, portMAX_DELAY);
-    for (int i = 0; i < message_count; i++) {
-        int index = (message_index - message_count + i + MAX_CAN_MESSAGES) % MAX_CAN_MESSAGES;
-        strcat(all_messages, can_messages[index]);
-        strcat(all_messages, "<br><br>");
+    if (args != NULL) {
+        char *end;
+        rate = strtoul(args, &end, 10);
+        sample = (*end == '/') ? strtoul(end + 1, &end, 10) : 1;
+        if (end == args || *end != '\0') {
+            return ws_send_text(req, "debug:error:ESP_ERR_INVALID_ARG");
+        }
+        can_debug_set(rate, sample);
     }
-    xSemaphoreGive(can_buffer_mutex);
 
-    return all_messages;
+    can_debug_get(&rate, &sample);
+    snprintf(reply, sizeof(reply), "debug:ok:%lu/%lu", rate, sample);
+    return ws_send_text(req, reply);
 }
 
-static void wifi_event_handler(void* arg, esp_event_base_t event_base,
-                               int32_t event_id, void* event_data)
+// Periodic table with the measured timing of each entry, as JSON
+static size_t tx_format_json(char *dst, size_t size)
 {
-    if (event_id == WIFI_EVENT_AP_STACONNECTED) {
-        wifi_event_ap_staconnected_t* event = (wifi_event_ap_staconnected_t*) event_data;
-        ESP_LOGI(TAG, "Station "MACSTR" joined, AID=%d",
-                 MAC2STR(event->mac), event->aid);
-    } else if (event_id == WIFI_EVENT_AP_STADISCONNECTED) {
-        wifi_event_ap_stadisconnected_t* event = (wifi_event_ap_stadisconnected_t*) event_data;
-        ESP_LOGI(TAG, "Station "MACSTR" left, AID=%d",
-                 MAC2STR(event->mac), event->aid);
+    char spec[CAN_TX_TEXT_MAX];
+    size_t len = snprintf(dst, size, "{\"periodic\":[");
+    bool first = true;
+
+    for (int i = 0; i < CAN_TX_MAX_PERIODIC && len < size; i++) {
+        can_tx_config_t config;
+        can_tx_stats_t stats;
+        if (!can_tx_get(i, &config, &stats)) {
+            continue;
+        }
+        can_tx_format(&config, spec, sizeof(spec));
+        len += snprintf(dst + len, size - len,
+                        "%s{\"slot\":%d,\"spec\":\"%s\",\"sent\":%lu,\"errors\":%lu,\"period_min_us\":%lu,"
+                        "\"period_max_us\":%lu,\"jitter_avg_us\":%lu,\"jitter_max_us\":%lu}",
+                        first ? "" : ",", i, spec, stats.sent, stats.errors, stats.period_min_us,
+                        stats.period_max_us, stats.jitter_avg_us, stats.jitter_max_us);
+        first = false;
     }
+    if (len < size) {
+        len += snprintf(dst + len, size - len, "]}");
+    }
+    return len < size ? len : size - 1;
 }
 
-static esp_err_t http_server_handler(httpd_req_t *req)
-{
-    const char* resp_str = "<!DOCTYPE html>"
-                           "<html>"
-                           "<head>"
-                           "<title>ESP32 WebSocket CAN Viewer</title>"
-                           "<style>"
-                           "body { font-family: Arial, sans-serif; margin: 0; padding: 20px; background-color: #f0f0f0; }"
-                           "h1 { color: #333; }"
-                           ".message-window { "
-                           "    background-color: #fff; "
-                           "    border: 1px solid #ddd; "
-                           "    border-radius: 5px; "
-                           "    height: 400px; "
-                           "    overflow-y: auto; "
-                           "    padding: 10px; "
-                           "    margin-bottom: 20px; "
-                           "}"
-                           "#can-messages { white-space: pre-wrap; }"
-                           "</style>"
-                           "<script>"
-                           "var socket;"
-                           "function initWebSocket() {"
-                           "    console.log('Trying to open a WebSocket connection...');"
-                           "    socket = new WebSocket('ws://' + window.location.host + '/ws');"
-                           "    socket.onopen = function(event) {"
-                           "        console.log('WebSocket connection opened');"
-                           "        socket.send('Hello Server!');"
-                           "    };"
-                           "    socket.onmessage = function(event) {"
-                           "        console.log('Received message:', event.data);"
-                           "        document.getElementById('can-messages').innerHTML = event.data;"
-                           "        var messageWindow = document.querySelector('.message-window');"
-                           "        messageWindow.scrollTop = messageWindow.scrollHeight;"
-                           "    };"
-                           "    socket.onerror = function(error) {"
-                           "        console.error('WebSocket error:', error);"
-                           "    };"
-                           "    socket.onclose = function(event) {"
-                           "        console.log('WebSocket connection closed');"
-                           "        setTimeout(initWebSocket, 2000);"
-                           "    };"
-                           "}"
-                           "function requestLatestMessages() {"
-                           "    if (socket && socket.readyState === WebSocket.OPEN) {"
-                           "        socket.send('get_messages');"
-                           "    }"
-                           "}"
-                           "window.addEventListener('load', function() {"
-                           "    initWebSocket();"
-                           "    setInterval(requestLatestMessages, 1000);"
-                           "});"
-                           "</script>"
-                           "</head>"
-                           "<body>"
-                           "<h1>ESP32 CAN Message Viewer</h1>"
-                           "<div class='message-window'>"
-                           "    <div id='can-messages'>Waiting for messages...</div>"
-                           "</div>"
-                           "</body>"
-                           "</html>";
-    httpd_resp_set_type(req, "text/html");
-    httpd_resp_send(req, resp_str, strlen(resp_str));
-    return ESP_OK;
+// "stop" clears the periodic table, "stop:<slot>" removes one entry, anything
+// else is a frame spec for can_tx_request. *slot is the entry started, or -1.
+static esp_err_t tx_command(const char *args, int *slot)
+{
+    *slot = -1;
+    if (strcmp(args, "stop") == 0) {
+        can_tx_stop_all();
+        return ESP_OK;
+    }
+    if (strncmp(args, "stop:", 5) == 0) {
+        return can_tx_stop(atoi(args + 5));
+    }
+
+    can_tx_config_t config;
+    esp_err_t err = can_tx_parse(args, &config);
+    if (err == ESP_OK) {
+        err = can_tx_request(&config, slot);
+    }
+    return err;
+}
+
+// "tx:<command>" runs tx_command and replies "tx:ok[:<slot>]" or
+// "tx:error:<reason>"; "tx?" replies "tx:list:<json>".
+static esp_err_t ws_handle_tx(httpd_req_t *req, const char *args)
+{
+    char reply[48];
+    int slot;
+
+    if (args == NULL) {
+        char *json = malloc(TX_JSON_SIZE + 8);
+        if (json == NULL) {
+            return ESP_ERR_NO_MEM;
+        }
+        memcpy(json, "tx:list:", 8);
+        tx_format_json(json + 8, TX_JSON_SIZE);
+        esp_err_t ret = ws_send_text(req, json);
+        free(json);
+        return ret;
+    }
+
+    esp_err_t err = tx_command(args, &slot);
+    if (err != ESP_OK) {
+        snprintf(reply, sizeof(reply), "tx:error:%s", esp_err_to_name(err));
+    } else if (slot >= 0) {
+        snprintf(reply, sizeof(reply), "tx:ok:%d", slot);
+    } else {
+        snprintf(reply, sizeof(reply), "tx:ok");
+    }
+    return ws_send_text(req, reply);
 }
 
 static esp_err_t websocket_handler(httpd_req_t *req)
 {
     if (req->method == HTTP_GET) {
         ESP_LOGI(TAG, "Handshake done, the new connection was opened");
+        ws_stream_add_client(httpd_req_to_sockfd(req));
         return ESP_OK;
     }
 
@@ -181,19 +351,606 @@ static esp_err_t websocket_handler(httpd_req_t *req)
         ESP_LOGI(TAG, "Received packet with message: %s", ws_pkt.payload);
     }
 
-    const char* all_messages = get_all_can_messages();
-    ws_pkt.payload = (uint8_t*)all_messages;
-    ws_pkt.len = strlen(all_messages);
+    const char *command = buf ? (const char *)buf : "";
+    if (strcmp(command, "caps:bin") == 0) {
+        // Capability handshake: from now on this client gets can_wire.h batches
+        ret = ws_stream_set_binary(httpd_req_to_sockfd(req), true);
+        ret = ws_send_text(req, ret == ESP_OK ? "caps:bin:ok" : "caps:bin:error");
+    } else if (strncmp(command, "filter:", 7) == 0) {
+        ret = ws_handle_filter(req, command + 7);
+    } else if (strcmp(command, "filter?") == 0) {
+        ret = ws_handle_filter(req, NULL);
+    } else if (strncmp(command, "debug:", 6) == 0) {
+        ret = ws_handle_debug(req, command + 6);
+    } else if (strcmp(command, "debug?") == 0) {
+        ret = ws_handle_debug(req, NULL);
+    } else if (strncmp(command, "tx:", 3) == 0) {
+        ret = ws_handle_tx(req, command + 3);
+    } else if (strcmp(command, "tx?") == 0) {
+        ret = ws_handle_tx(req, NULL);
+    } else if (strcmp(command, "get_monitor") == 0) {
+        char *json = malloc(MONITOR_JSON_SIZE);
+        if (json == NULL) {
+            free(buf);
+            return ESP_ERR_NO_MEM;
+        }
+        memcpy(json, "M:", 2);
+        can_monitor_format_json(json + 2, MONITOR_JSON_SIZE - 2, esp_timer_get_time());
+        ret = ws_send_text(req, json);
+        free(json);
+    } else {
+        ret = ws_send_history(req);
+    }
+
+    free(buf);
+    return ret;
+}
+
+static esp_err_t stats_handler(httpd_req_t *req)
+{
+    char chunk[STATS_CHUNK_SIZE];
+    int64_t now = esp_timer_get_time();
+    uint32_t load = can_stats_bus_load_x100(now);
+    int len = snprintf(chunk, sizeof(chunk),
+                       "{\"bitrate\":%d,\"bus_load_pct\":%lu.%02lu,\"frames\":%lu,\"untracked_ids\":%lu,\"ids\":[",
+                       CAN_BUS_BITRATE, load / 100, load % 100, can_stats_total_frames(), can_monitor_overflow_count());
+
+    httpd_resp_set_type(req, "application/json");
+    httpd_resp_set_hdr(req, "Cache-Control", "no-store");
+
+    bool first = true;
+    for (size_t i = 0; i < CAN_MONITOR_MAX_IDS; i++) {
+        can_monitor_entry_t e;
+        if (!can_monitor_get(i, &e)) {
+            continue;
+        }
+        if (len > STATS_CHUNK_SIZE - 192) {
+            if (httpd_resp_send_chunk(req, chunk, len) != ESP_OK) {
+                return ESP_FAIL;
+            }
+            len = 0;
+        }
+        len += snprintf(chunk + len, sizeof(chunk) - len,
+                        "%s{\"id\":%lu,\"extd\":%d,\"count\":%lu,\"rate\":%lu,"
+                        "\"period_min_us\":%lu,\"period_avg_us\":%lu,\"period_max_us\":%lu,\"jitter_us\":%lu}",
+                        first ? "" : ",", e.identifier, e.extd, e.count, can_monitor_rate(&e, now),
+                        e.period_min_us, can_monitor_period_avg_us(&e), e.period_max_us, e.jitter_us);
+        first = false;
+    }
+    len += snprintf(chunk + len, sizeof(chunk) - len, "]}");
+
+    if (httpd_resp_send_chunk(req, chunk, len) != ESP_OK) {
+        return ESP_FAIL;
+    }
+    return httpd_resp_send_chunk(req, NULL, 0);
+}
+
+typedef struct {
+    httpd_req_t *req;
+    esp_err_t err;
+    int len;
+    char chunk[METRICS_CHUNK_SIZE];
+} metrics_writer_t;
+
+static void metrics_printf(metrics_writer_t *w, const char *format, ...)
+{
+    if (w->err != ESP_OK) {
+        return;
+    }
+    if (w->len > METRICS_CHUNK_SIZE - METRICS_LINE_MAX) {
+        w->err = httpd_resp_send_chunk(w->req, w->chunk, w->len);
+        w->len = 0;
+    }
+
+    va_list args;
+    va_start(args, format);
+    int n = vsnprintf(w->chunk + w->len, METRICS_CHUNK_SIZE - w->len, format, args);
+    va_end(args);
+    if (n > 0) {
+        w->len += n < METRICS_CHUNK_SIZE - w->len ? n : METRICS_CHUNK_SIZE - w->len - 1;
+    }
+}
+
+static void metrics_value(metrics_writer_t *w, const char *name, const char *type, uint32_t value)
+{
+    metrics_printf(w, "# TYPE canviewer_%s %s\ncanviewer_%s %lu\n", name, type, name, value);
+}
+
+static void metrics_histogram(metrics_writer_t *w, can_metric_hist_t hist)
+{
+    const char *name = can_metrics_hist_name(hist);
+    can_hist_snapshot_t snap;
+    can_metrics_snapshot(hist, &snap);
+
+    // Buckets may be ahead of the count read before them; clamp so the
+    // series stays monotonic and ends at _count.
+    uint32_t cumulative = 0;
+    metrics_printf(w, "# TYPE canviewer_%s histogram\n", name);
+    for (size_t i = 0; i < CAN_HIST_BUCKETS; i++) {
+        cumulative += snap.buckets[i];
+        uint32_t bound = can_hist_bounds_us[i];
+        metrics_printf(w, "canviewer_%s_bucket{le=\"%lu.%06lu\"} %lu\n", name,
+                       bound / 1000000, bound % 1000000, cumulative < snap.count ? cumulative : snap.count);
+    }
+    metrics_printf(w, "canviewer_%s_bucket{le=\"+Inf\"} %lu\n", name, snap.count);
+    metrics_printf(w, "canviewer_%s_sum %lu.%06lu\n", name, snap.sum_us / 1000000, snap.sum_us % 1000000);
+    metrics_printf(w, "canviewer_%s_count %lu\n", name, snap.count);
+}
+
+static void metrics_tasks(metrics_writer_t *w)
+{
+#if CONFIG_FREERTOS_USE_TRACE_FACILITY
+    UBaseType_t capacity = uxTaskGetNumberOfTasks() + 2;
+    TaskStatus_t *tasks = malloc(capacity * sizeof(TaskStatus_t));
+    if (tasks == NULL) {
+        return;
+    }
+    configRUN_TIME_COUNTER_TYPE total_runtime;
+    UBaseType_t count = uxTaskGetSystemState(tasks, capacity, &total_runtime);
+
+    metrics_printf(w, "# TYPE canviewer_task_stack_free_min_bytes gauge\n");
+    for (UBaseType_t i = 0; i < count; i++) {
+        metrics_printf(w, "canviewer_task_stack_free_min_bytes{task=\"%s\"} %lu\n",
+                       tasks[i].pcTaskName, (uint32_t)tasks[i].usStackHighWaterMark);
+    }
+#if CONFIG_FREERTOS_GENERATE_RUN_TIME_STATS
+    // Run time is counted in esp_timer microseconds and wraps like a counter
+    metrics_printf(w, "# TYPE canviewer_task_cpu_seconds_total counter\n");
+    for (UBaseType_t i = 0; i < count; i++) {
+        uint32_t runtime = tasks[i].ulRunTimeCounter;
+        metrics_printf(w, "canviewer_task_cpu_seconds_total{task=\"%s\"} %lu.%06lu\n",
+                       tasks[i].pcTaskName, runtime / 1000000, runtime % 1000000);
+    }
+#endif
+    free(tasks);
+#endif
+}
+
+// Prometheus text exposition of the pipeline counters, stage latencies,
+// controller error counters and per-task stack and CPU usage.
+static esp_err_t metrics_handler(httpd_req_t *req)
+{
+    metrics_writer_t *w = malloc(sizeof(metrics_writer_t));
+    if (w == NULL) {
+        return httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Out of memory");
+    }
+    w->req = req;
+    w->err = ESP_OK;
+    w->len = 0;
+
+    httpd_resp_set_type(req, "text/plain; version=0.0.4");
+    httpd_resp_set_hdr(req, "Cache-Control", "no-store");
+
+    for (int i = 0; i < CAN_METRIC_COUNTER_COUNT; i++) {
+        metrics_value(w, can_metrics_counter_name(i), "counter", can_metrics_counter(i));
+    }
+    metrics_value(w, "ring_frames_total", "counter", can_ring_head());
+    metrics_value(w, "monitor_untracked_ids_total", "counter", can_monitor_overflow_count());
+#if CONFIG_CAN_LOG_ENABLE
+    metrics_value(w, "log_lost_frames_total", "counter", can_log_lost_frames());
+#endif
+    uint32_t load = can_stats_bus_load_x100(esp_timer_get_time());
+    metrics_printf(w, "# TYPE canviewer_bus_load_ratio gauge\ncanviewer_bus_load_ratio %lu.%04lu\n",
+                   load / 10000, load % 10000);
+
+    for (int i = 0; i < CAN_HIST_COUNT; i++) {
+        metrics_histogram(w, i);
+    }
+
+    twai_status_info_t status;
+    if (can_get_status(&status) == ESP_OK) {
+        metrics_value(w, "twai_state", "gauge", status.state);
+        metrics_value(w, "twai_rx_queued", "gauge", status.msgs_to_rx);
+        metrics_value(w, "twai_tx_queued", "gauge", status.msgs_to_tx);
+        metrics_value(w, "twai_tx_error_counter", "gauge", status.tx_error_counter);
+        metrics_value(w, "twai_rx_error_counter", "gauge", status.rx_error_counter);
+        metrics_value(w, "twai_rx_missed_total", "counter", status.rx_missed_count);
+        metrics_value(w, "twai_rx_overrun_total", "counter", status.rx_overrun_count);
+        metrics_value(w, "twai_tx_failed_total", "counter", status.tx_failed_count);
+        metrics_value(w, "twai_arb_lost_total", "counter", status.arb_lost_count);
+        metrics_value(w, "twai_bus_errors_total", "counter", status.bus_error_count);
+    }
+
+    metrics_value(w, "heap_free_bytes", "gauge", esp_get_free_heap_size());
+    metrics_value(w, "heap_free_min_bytes", "gauge", esp_get_minimum_free_heap_size());
+    metrics_tasks(w);
 
-    ret = httpd_ws_send_frame(req, &ws_pkt);
+    esp_err_t ret = w->err;
+    if (ret == ESP_OK && w->len > 0) {
+        ret = httpd_resp_send_chunk(req, w->chunk, w->len);
+    }
+    free(w);
     if (ret != ESP_OK) {
-        ESP_LOGE(TAG, "httpd_ws_send_frame failed with %d", ret);
+        return ret;
     }
-    
-    free(buf);
+    return httpd_resp_send_chunk(req, NULL, 0);
+}
+
+static esp_err_t dbc_send_info(httpd_req_t *req)
+{
+    char json[96];
+    size_t messages, signals, bytes;
+
+    if (can_dbc_info(&messages, &signals, &bytes)) {
+        snprintf(json, sizeof(json), "{\"messages\":%u,\"signals\":%u,\"bytes\":%u}", messages, signals, bytes);
+    } else {
+        snprintf(json, sizeof(json), "{\"messages\":0}");
+    }
+    httpd_resp_set_type(req, "application/json");
+    return httpd_resp_sendstr(req, json);
+}
+
+static esp_err_t dbc_get_handler(httpd_req_t *req)
+{
+    return dbc_send_info(req);
+}
+
+// POST /dbc with a DBC file as the body compiles it while it is received,
+// activates it and saves the compiled table. An empty body removes it.
+static esp_err_t dbc_post_handler(httpd_req_t *req)
+{
+    if (req->content_len == 0) {
+        can_dbc_install(NULL, true);
+        return dbc_send_info(req);
+    }
+
+    char *chunk = malloc(DBC_CHUNK_SIZE);
+    can_dbc_parser_t *parser = can_dbc_parser_new();
+    if (chunk == NULL || parser == NULL) {
+        free(chunk);
+        can_dbc_parser_free(parser);
+        return httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Out of memory");
+    }
+
+    size_t remaining = req->content_len;
+    esp_err_t ret = ESP_OK;
+    while (remaining > 0 && ret == ESP_OK) {
+        int n = httpd_req_recv(req, chunk, remaining < DBC_CHUNK_SIZE ? remaining : DBC_CHUNK_SIZE);
+        if (n == HTTPD_SOCK_ERR_TIMEOUT) {
+            continue;
+        }
+        if (n <= 0) {
+            free(chunk);
+            can_dbc_parser_free(parser);
+            return ESP_FAIL;
+        }
+        remaining -= n;
+        ret = can_dbc_parser_feed(parser, chunk, n);
+    }
+    free(chunk);
+
+    can_dbc_table_t *table = NULL;
+    if (ret == ESP_OK) {
+        ret = can_dbc_parser_finish(parser, &table);
+    }
+    if (ret != ESP_OK) {
+        char reason[80];
+        char json[112];
+        can_dbc_parser_error(parser, reason, sizeof(reason));
+        can_dbc_parser_free(parser);
+        snprintf(json, sizeof(json), "{\"error\":\"%s\"}", reason);
+        httpd_resp_set_status(req, "400 Bad Request");
+        httpd_resp_set_type(req, "application/json");
+        return httpd_resp_sendstr(req, json);
+    }
+    can_dbc_parser_free(parser);
+
+    if (can_dbc_install(table, true) != ESP_OK) {
+        ESP_LOGW(TAG, "DBC active but not saved");
+    }
+    return dbc_send_info(req);
+}
+
+// GET /history: the same frames as the WebSocket history, one per line.
+// GET /history?id=7E8[x][&since=N] only returns the frames with that
+// identifier from sequence number N on. X-History-Next is the sequence
+// number to ask from next time.
+static esp_err_t history_handler(httpd_req_t *req)
+{
+    char query[48];
+    char value[16];
+    char next[12];
+    can_history_cursor_t cursor;
+
+    if (httpd_req_get_url_query_str(req, query, sizeof(query)) == ESP_OK &&
+        httpd_query_key_value(query, "id", value, sizeof(value)) == ESP_OK) {
+        char *end;
+        unsigned long id = strtoul(value, &end, 16);
+        bool extd = id > TWAI_STD_ID_MASK || *end == 'x' || *end == 'X';
+        if (end == value || id > TWAI_EXTD_ID_MASK) {
+            return httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Invalid id");
+        }
+        uint32_t since = 0;
+        if (httpd_query_key_value(query, "since", value, sizeof(value)) == ESP_OK) {
+            since = strtoul(value, NULL, 10);
+        }
+        can_history_cursor_init_query(&cursor, id, extd, since);
+    } else {
+        can_history_cursor_init(&cursor);
+    }
+
+    char *chunk = malloc(HISTORY_CHUNK_SIZE);
+    if (chunk == NULL) {
+        return httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Out of memory");
+    }
+
+    httpd_resp_set_type(req, "text/plain");
+    httpd_resp_set_hdr(req, "Cache-Control", "no-store");
+    snprintf(next, sizeof(next), "%lu", cursor.end);
+    httpd_resp_set_hdr(req, "X-History-Next", next);
+    esp_err_t ret = ESP_OK;
+    size_t len;
+    while (ret == ESP_OK && (len = can_history_read(&cursor, "\n", chunk, HISTORY_CHUNK_SIZE)) > 0) {
+        ret = httpd_resp_send_chunk(req, chunk, len);
+    }
+    free(chunk);
+    if (ret != ESP_OK) {
+        return ret;
+    }
+    return httpd_resp_send_chunk(req, NULL, 0);
+}
+
+static esp_err_t trigger_send_list(httpd_req_t *req)
+{
+    static const char *states[] = { "free", "armed", "capturing", "done" };
+    char condition[CAN_TRIGGER_TEXT_MAX];
+    char chunk[CAN_TRIGGER_TEXT_MAX + 128];
+    bool first = true;
+
+    httpd_resp_set_type(req, "application/json");
+    httpd_resp_set_hdr(req, "Cache-Control", "no-store");
+    httpd_resp_sendstr_chunk(req, "{\"slots\":[");
+    for (int i = 0; i < CAN_TRIGGER_SLOTS; i++) {
+        can_trigger_info_t info;
+        if (!can_trigger_get(i, &info)) {
+            continue;
+        }
+        can_trigger_format(&info.config, condition, sizeof(condition));
+        snprintf(chunk, sizeof(chunk),
+                 "%s{\"slot\":%d,\"state\":\"%s\",\"condition\":\"%s\",\"frames\":%lu,\"trigger_index\":%lu,\"trigger_us\":%lld}",
+                 first ? "" : ",", i, states[info.state], condition, info.frames, info.trigger_index, info.trigger_us);
+        httpd_resp_sendstr_chunk(req, chunk);
+        first = false;
+    }
+    httpd_resp_sendstr_chunk(req, "]}");
+    return httpd_resp_send_chunk(req, NULL, 0);
+}
+
+// GET /trigger lists the slots; /trigger?slot=N downloads a completed
+// capture as a candump -l file.
+static esp_err_t trigger_get_handler(httpd_req_t *req)
+{
+    char query[32];
+    char value[8];
+
+    if (httpd_req_get_url_query_str(req, query, sizeof(query)) != ESP_OK ||
+        httpd_query_key_value(query, "slot", value, sizeof(value)) != ESP_OK) {
+        return trigger_send_list(req);
+    }
+    int slot = atoi(value);
+    size_t count;
+    const can_frame_record_t *frames = can_trigger_frames(slot, &count);
+    if (frames == NULL) {
+        return httpd_resp_send_err(req, HTTPD_404_NOT_FOUND, "No completed capture in this slot");
+    }
+    char *text = malloc(TRIGGER_CHUNK_SIZE);
+    if (text == NULL) {
+        return httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Out of memory");
+    }
+
+    char disposition[64];
+    snprintf(disposition, sizeof(disposition), "attachment; filename=\"trigger_%d.log\"", slot);
+    httpd_resp_set_type(req, "text/plain");
+    httpd_resp_set_hdr(req, "Content-Disposition", disposition);
+
+    esp_err_t ret = ESP_OK;
+    size_t len = 0;
+    for (size_t i = 0; i < count && ret == ESP_OK; i++) {
+        len += can_format_candump(text + len, TRIGGER_CHUNK_SIZE - len, frames[i].timestamp_us, &frames[i].msg);
+        if (len > TRIGGER_CHUNK_SIZE - CAN_FORMAT_CANDUMP_MAX || i + 1 == count) {
+            ret = httpd_resp_send_chunk(req, text, len);
+            len = 0;
+        }
+    }
+    free(text);
+    if (ret != ESP_OK) {
+        return ret;
+    }
+    return httpd_resp_send_chunk(req, NULL, 0);
+}
+
+// Reads the whole body into buf and terminates it. httpd_req_recv may
+// return less than asked for, or time out before the client has sent
+// everything.
+static esp_err_t recv_body(httpd_req_t *req, char *buf, size_t size)
+{
+    if (req->content_len >= size) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    size_t received = 0;
+    while (received < req->content_len) {
+        int n = httpd_req_recv(req, buf + received, req->content_len - received);
+        if (n == HTTPD_SOCK_ERR_TIMEOUT) {
+            continue;
+        }
+        if (n <= 0) {
+            return ESP_FAIL;
+        }
+        received += n;
+    }
+    buf[received] = '\0';
+    return ESP_OK;
+}
+
+// POST /trigger arms a slot with the condition in the body (see
+// can_trigger_parse); POST /trigger?clear=N frees a slot. Both reply with the list.
+static esp_err_t trigger_post_handler(httpd_req_t *req)
+{
+    char query[32];
+    char value[8];
+    esp_err_t ret;
+
+    if (httpd_req_get_url_query_str(req, query, sizeof(query)) == ESP_OK &&
+        httpd_query_key_value(query, "clear", value, sizeof(value)) == ESP_OK) {
+        ret = can_clear_trigger(atoi(value));
+    } else {
+        char text[CAN_TRIGGER_TEXT_MAX];
+        if (req->content_len == 0 || req->content_len >= sizeof(text)) {
+            return httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Condition missing or too long");
+        }
+        if (recv_body(req, text, sizeof(text)) != ESP_OK) {
+            return ESP_FAIL;
+        }
+
+        can_trigger_config_t config;
+        int slot;
+        ret = can_trigger_parse(text, &config);
+        if (ret == ESP_OK) {
+            ret = can_arm_trigger(&config, &slot);
+        }
+        if (ret == ESP_OK) {
+            ESP_LOGI(TAG, "Trigger armed in slot %d: %s", slot, text);
+        }
+    }
+
+    if (ret != ESP_OK) {
+        return httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, esp_err_to_name(ret));
+    }
+    return trigger_send_list(req);
+}
+
+static esp_err_t tx_send_list(httpd_req_t *req)
+{
+    char *json = malloc(TX_JSON_SIZE);
+    if (json == NULL) {
+        return httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Out of memory");
+    }
+    size_t len = tx_format_json(json, TX_JSON_SIZE);
+    httpd_resp_set_type(req, "application/json");
+    httpd_resp_set_hdr(req, "Cache-Control", "no-store");
+    esp_err_t ret = httpd_resp_send(req, json, len);
+    free(json);
     return ret;
 }
 
+// GET /tx lists the periodic table
+static esp_err_t tx_get_handler(httpd_req_t *req)
+{
+    return tx_send_list(req);
+}
+
+// POST /tx sends the frame spec in the body (see can_tx_parse), periodic
+// specs join the table; POST /tx?stop=N removes an entry and ?stop=all
+// empties the table. All reply with the table.
+static esp_err_t tx_post_handler(httpd_req_t *req)
+{
+    char query[32];
+    char value[8];
+    esp_err_t ret = ESP_OK;
+    int slot;
+
+    if (httpd_req_get_url_query_str(req, query, sizeof(query)) == ESP_OK &&
+        httpd_query_key_value(query, "stop", value, sizeof(value)) == ESP_OK) {
+        if (strcmp(value, "all") == 0) {
+            can_tx_stop_all();
+        } else {
+            ret = can_tx_stop(atoi(value));
+        }
+    } else {
+        char text[CAN_TX_TEXT_MAX];
+        if (req->content_len == 0 || req->content_len >= sizeof(text)) {
+            return httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Frame missing or too long");
+        }
+        if (recv_body(req, text, sizeof(text)) != ESP_OK) {
+            return ESP_FAIL;
+        }
+        ret = tx_command(text, &slot);
+    }
+
+    if (ret != ESP_OK) {
+        return httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, esp_err_to_name(ret));
+    }
+    return tx_send_list(req);
+}
+
+static esp_err_t log_list_handler(httpd_req_t *req)
+{
+    can_log_segment_t *segments = calloc(LOG_MAX_SEGMENTS, sizeof(can_log_segment_t));
+    char chunk[128];
+    if (segments == NULL) {
+        return httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Out of memory");
+    }
+    size_t count = can_log_list(segments, LOG_MAX_SEGMENTS);
+
+    httpd_resp_set_type(req, "application/json");
+    httpd_resp_set_hdr(req, "Cache-Control", "no-store");
+    snprintf(chunk, sizeof(chunk), "{\"lost\":%lu,\"segments\":[", can_log_lost_frames());
+    httpd_resp_sendstr_chunk(req, chunk);
+    for (size_t i = 0; i < count; i++) {
+        snprintf(chunk, sizeof(chunk), "%s{\"index\":%lu,\"size\":%lu,\"active\":%s}",
+                 i ? "," : "", segments[i].index, segments[i].size, segments[i].active ? "true" : "false");
+        httpd_resp_sendstr_chunk(req, chunk);
+    }
+    free(segments);
+    httpd_resp_sendstr_chunk(req, "]}");
+    return httpd_resp_send_chunk(req, NULL, 0);
+}
+
+static esp_err_t send_log_chunk(void *ctx, const char *data, size_t len)
+{
+    return httpd_resp_send_chunk((httpd_req_t *)ctx, data, len);
+}
+
+// GET /log lists the segments; /log?seg=N[&fmt=bin|candump|asc] downloads one,
+// converting it page by page so the file is never held in RAM.
+static esp_err_t log_handler(httpd_req_t *req)
+{
+    char query[64];
+    char value[16];
+
+    if (httpd_req_get_url_query_str(req, query, sizeof(query)) != ESP_OK ||
+        httpd_query_key_value(query, "seg", value, sizeof(value)) != ESP_OK) {
+        return log_list_handler(req);
+    }
+    uint32_t index = strtoul(value, NULL, 10);
+
+    can_log_format_t format = CAN_LOG_FORMAT_BINARY;
+    if (httpd_query_key_value(query, "fmt", value, sizeof(value)) == ESP_OK) {
+        if (strcmp(value, "candump") == 0) {
+            format = CAN_LOG_FORMAT_CANDUMP;
+        } else if (strcmp(value, "asc") == 0) {
+            format = CAN_LOG_FORMAT_ASC;
+        } else if (strcmp(value, "bin") != 0) {
+            return httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "fmt must be bin, candump or asc");
+        }
+    }
+
+    FILE *f;
+    esp_err_t err = can_log_open_segment(index, &f);
+    if (err == ESP_ERR_INVALID_STATE) {
+        httpd_resp_set_status(req, "409 Conflict");
+        return httpd_resp_sendstr(req, "Another segment download is in progress");
+    } else if (err != ESP_OK) {
+        return httpd_resp_send_err(req, HTTPD_404_NOT_FOUND, "No such segment");
+    }
+
+    static const char *extensions[] = { "bin", "log", "asc" };
+    char disposition[64];
+    snprintf(disposition, sizeof(disposition), "attachment; filename=\"can_%05lu.%s\"", index, extensions[format]);
+    httpd_resp_set_type(req, format == CAN_LOG_FORMAT_BINARY ? "application/octet-stream" : "text/plain");
+    httpd_resp_set_hdr(req, "Content-Disposition", disposition);
+
+    esp_err_t ret = can_log_export(f, format, send_log_chunk, req);
+    can_log_close_segment(f);
+    if (ret == ESP_ERR_NO_MEM) {
+        return httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Out of memory");
+    }
+    if (ret != ESP_OK) {
+        return ret;
+    }
+    return httpd_resp_send_chunk(req, NULL, 0);
+}
+
 static const httpd_uri_t ws = {
     .uri        = "/ws",
     .method     = HTTP_GET,
@@ -205,22 +962,124 @@ static const httpd_uri_t ws = {
 static const httpd_uri_t root = {
     .uri       = "/",
     .method    = HTTP_GET,
-    .handler   = http_server_handler,
+    .handler   = web_asset_handler,
+    .user_ctx  = &web_index
+};
+
+static const httpd_uri_t app_js = {
+    .uri       = "/app.js",
+    .method    = HTTP_GET,
+    .handler   = web_asset_handler,
+    .user_ctx  = &web_app_js
+};
+
+static const httpd_uri_t stats = {
+    .uri       = "/stats",
+    .method    = HTTP_GET,
+    .handler   = stats_handler,
+    .user_ctx  = NULL
+};
+
+static const httpd_uri_t metrics = {
+    .uri       = "/metrics",
+    .method    = HTTP_GET,
+    .handler   = metrics_handler,
+    .user_ctx  = NULL
+};
+
+static const httpd_uri_t dbc_get = {
+    .uri       = "/dbc",
+    .method    = HTTP_GET,
+    .handler   = dbc_get_handler,
+    .user_ctx  = NULL
+};
+
+static const httpd_uri_t dbc_post = {
+    .uri       = "/dbc",
+    .method    = HTTP_POST,
+    .handler   = dbc_post_handler,
     .user_ctx  = NULL
 };
 
+static const httpd_uri_t log_uri = {
+    .uri       = "/log",
+    .method    = HTTP_GET,
+    .handler   = log_handler,
+    .user_ctx  = NULL
+};
+
+static const httpd_uri_t history_uri = {
+    .uri       = "/history",
+    .method    = HTTP_GET,
+    .handler   = history_handler,
+    .user_ctx  = NULL
+};
+
+static const httpd_uri_t trigger_get = {
+    .uri       = "/trigger",
+    .method    = HTTP_GET,
+    .handler   = trigger_get_handler,
+    .user_ctx  = NULL
+};
+
+static const httpd_uri_t trigger_post = {
+    .uri       = "/trigger",
+    .method    = HTTP_POST,
+    .handler   = trigger_post_handler,
+    .user_ctx  = NULL
+};
+
+static const httpd_uri_t tx_get = {
+    .uri       = "/tx",
+    .method    = HTTP_GET,
+    .handler   = tx_get_handler,
+    .user_ctx  = NULL
+};
+
+static const httpd_uri_t tx_post = {
+    .uri       = "/tx",
+    .method    = HTTP_POST,
+    .handler   = tx_post_handler,
+    .user_ctx  = NULL
+};
+
+static void http_session_closed(httpd_handle_t hd, int sockfd)
+{
+    ws_stream_remove_client(sockfd);
+    close(sockfd);
+}
+
 static httpd_handle_t start_webserver(void)
 {
     httpd_config_t config = HTTPD_DEFAULT_CONFIG();
-    config.max_open_sockets = 4;
+    config.max_open_sockets = WS_STREAM_MAX_CLIENTS;
     config.lru_purge_enable = true;
+    config.close_fn = http_session_closed;
+    config.max_uri_handlers = 16;
+
+    web_asset_init(&web_index);
+    web_asset_init(&web_app_js);
 
     ESP_LOGI(TAG, "Starting server on port: '%d'", config.server_port);
     esp_err_t ret = httpd_start(&server, &config);
     if (ret == ESP_OK) {
+        if (ws_stream_start(server) != ESP_OK) {
+            ESP_LOGE(TAG, "Failed to start WebSocket broadcaster");
+        }
         ESP_LOGI(TAG, "Registering URI handlers");
         httpd_register_uri_handler(server, &root);
+        httpd_register_uri_handler(server, &app_js);
         httpd_register_uri_handler(server, &ws);
+        httpd_register_uri_handler(server, &stats);
+        httpd_register_uri_handler(server, &metrics);
+        httpd_register_uri_handler(server, &dbc_get);
+        httpd_register_uri_handler(server, &dbc_post);
+        httpd_register_uri_handler(server, &log_uri);
+        httpd_register_uri_handler(server, &history_uri);
+        httpd_register_uri_handler(server, &trigger_get);
+        httpd_register_uri_handler(server, &trigger_post);
+        httpd_register_uri_handler(server, &tx_get);
+        httpd_register_uri_handler(server, &tx_post);
         return server;
     }
 
@@ -266,12 +1125,23 @@ void wifi_init_softap(void)
 }
 
 void can_message_task(void *pvParameters) {
+    static can_frame_record_t batch[CAN_CONSUMER_BATCH];
+    can_ring_cursor_t cursor;
+
+    can_ring_cursor_init(&cursor);
     while (1) {
-        const char* latest_message = get_latest_can_message();
-        if (strlen(latest_message) > 0) {
-            add_can_message(latest_message);
+        uint32_t lost;
+        size_t count = can_ring_read(&cursor, batch, CAN_CONSUMER_BATCH, &lost);
+        if (lost > 0) {
+            can_metrics_add(CAN_METRIC_HISTORY_DROPPED, lost);
+            ESP_LOGW(TAG, "Consumer fell behind, %lu frames dropped (%lu total)", lost, cursor.dropped);
+        }
+        if (count > 0) {
+            add_can_messages(batch, count);
+        }
+        if (count < CAN_CONSUMER_BATCH) {
+            vTaskDelay(pdMS_TO_TICKS(CAN_CONSUMER_INTERVAL_MS)); // Ring drained, wait for more frames
         }
-        vTaskDelay(pdMS_TO_TICKS(100)); // Wait 100ms before checking for the next message
     }
 }
 
@@ -284,9 +1154,7 @@ void app_main(void)
     }
     ESP_ERROR_CHECK(ret);
 
-    can_buffer_mutex = xSemaphoreCreateMutex();
-    if (can_buffer_mutex == NULL) {
-        ESP_LOGE(TAG, "Failed to create CAN buffer mutex");
+    if (can_history_init() != ESP_OK) {
         return;
     }
 
@@ -295,6 +1163,17 @@ void app_main(void)
     
     init_can();
     start_can_tasks();
+    can_tx_init(can_get_tx_driver());
+    can_debug_start();
+    if (storage_mount() != ESP_OK) {
+        ESP_LOGE(TAG, "Flash storage unavailable");
+    }
+    can_dbc_init();
+#if CONFIG_CAN_LOG_ENABLE
+    if (can_log_start() != ESP_OK) {
+        ESP_LOGE(TAG, "Flash capture log disabled");
+    }
+#endif
     
     server = start_webserver();
 
@@ -303,14 +1182,21 @@ void app_main(void)
         esp_restart();
     }
 
-    xTaskCreate(can_message_task, "can_message_task", 2048, NULL, 5, NULL);
-    // Enviar el mensaje CAN con ID 199 después de que todo esté inicializado
-    vTaskDelay(pdMS_TO_TICKS(1000));  // Esperar un segundo para asegurarse de que todo está listo
-    esp_err_t send_result = send_can_message_id_199();
-    if (send_result != ESP_OK) {
-        ESP_LOGE(TAG, "Failed to send initial CAN message with ID 199");
-    } else {
-        ESP_LOGI(TAG, "Initial CAN message with ID 199 sent successfully");
+#if CONFIG_CAN_BRIDGE_ENABLE
+    can_bridge_config_t bridge_config = CAN_BRIDGE_CONFIG_DEFAULT();
+    bridge_config.bitrate = CAN_BUS_BITRATE;
+    if (can_bridge_start(&bridge_config, can_get_tx_driver()) != ESP_OK) {
+        ESP_LOGE(TAG, "Network bridge disabled");
+    }
+#endif
+
+    xTaskCreate(can_message_task, "can_message_task", 4096, NULL, 5, NULL);
+    // Mensaje de arranque opcional, con la misma sintaxis que el comando "tx:"
+    if (CONFIG_CAN_TX_STARTUP_MESSAGE[0] != '\0') {
+        int slot;
+        if (tx_command(CONFIG_CAN_TX_STARTUP_MESSAGE, &slot) != ESP_OK) {
+            ESP_LOGE(TAG, "Failed to send startup message %s", CONFIG_CAN_TX_STARTUP_MESSAGE);
+        }
     }
 
 }
\ No newline at end of file
@@ -0,0 +1,40 @@
+#include "storage.h"
+#include "esp_log.h"
+#include "esp_vfs_fat.h"
+#include "wear_levelling.h"
+
+#define TAG "STORAGE"
+#define STORAGE_PARTITION_LABEL "storage"
+
+static wl_handle_t wl_handle = WL_INVALID_HANDLE;
+
+esp_err_t storage_mount(void) {
+    if (wl_handle != WL_INVALID_HANDLE) {
+        return ESP_OK;
+    }
+
+    const esp_vfs_fat_mount_config_t mount_config = {
+        .max_files = 4,
+        .format_if_mount_failed = true,
+        .allocation_unit_size = CONFIG_WL_SECTOR_SIZE,
+    };
+    esp_err_t ret = esp_vfs_fat_spiflash_mount_rw_wl(STORAGE_BASE_PATH, STORAGE_PARTITION_LABEL, &mount_config, &wl_handle);
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to mount FAT partition: %s", esp_err_to_name(ret));
+        wl_handle = WL_INVALID_HANDLE;
+        return ret;
+    }
+
+    uint64_t total = 0, free_bytes = 0;
+    storage_info(&total, &free_bytes);
+    ESP_LOGI(TAG, "Mounted %s: %llu KB total, %llu KB free", STORAGE_BASE_PATH, total / 1024, free_bytes / 1024);
+    return ESP_OK;
+}
+
+bool storage_is_mounted(void) {
+    return wl_handle != WL_INVALID_HANDLE;
+}
+
+esp_err_t storage_info(uint64_t *total_bytes, uint64_t *free_bytes) {
+    return esp_vfs_fat_info(STORAGE_BASE_PATH, total_bytes, free_bytes);
+}
@@ -0,0 +1,18 @@
+// storage.h
+#ifndef STORAGE_H
+#define STORAGE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "esp_err.h"
+
+// VFS path of the wear-levelled FAT partition labelled "storage"
+#define STORAGE_BASE_PATH "/data"
+
+esp_err_t storage_mount(void);
+bool storage_is_mounted(void);
+
+// Total and free bytes of the mounted partition.
+esp_err_t storage_info(uint64_t *total_bytes, uint64_t *free_bytes);
+
+#endif // STORAGE_H
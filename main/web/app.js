@@ -0,0 +1,282 @@
+var socket;
+var monitorTimer;
+var signals = {};
+
+// Frame list. Frames are kept in a ring of typed arrays and only formatted
+// when scrolled into view; the DOM holds one pool of rows, updated at most
+// once per animation frame however fast frames arrive.
+var ROW_HEIGHT = 18;
+var MAX_ROWS = 20000;
+var OVERSCAN = 8;
+var FLAG_EXTD = 0x01;
+var FLAG_RTR = 0x02;
+var FLAG_GAP = 0x80;
+var rowIds = new Uint32Array(MAX_ROWS);
+var rowFlags = new Uint8Array(MAX_ROWS);    // can_wire.h flags, or FLAG_GAP with the count in rowIds
+var rowDlcs = new Uint8Array(MAX_ROWS);
+var rowData = new Uint8Array(MAX_ROWS * 8);
+var rowTexts = new Array(MAX_ROWS);         // Rows that arrived as text
+var rowTotal = 0;                           // Rows appended, the oldest MAX_ROWS are kept
+var shownBase = 0;
+var follow = true;
+var renderPending = false;
+var pool = [];
+
+function hex(v, width) {
+    var s = v.toString(16);
+    while (s.length < width) s = '0' + s;
+    return s;
+}
+function nextSlot() {
+    var slot = rowTotal % MAX_ROWS;
+    rowTexts[slot] = null;
+    rowTotal++;
+    return slot;
+}
+function appendText(line) {
+    if (line) rowTexts[nextSlot()] = line.replace(/<\/?i>/g, '');
+}
+function appendGap(count) {
+    var slot = nextSlot();
+    rowFlags[slot] = FLAG_GAP;
+    rowIds[slot] = count;
+}
+function resetRows() {
+    rowTotal = 0;
+    shownBase = 0;
+    follow = true;
+    pool.forEach(function(row) { row.row = -1; });
+}
+function formatRow(slot) {
+    if (rowTexts[slot] != null) return rowTexts[slot];
+    if (rowFlags[slot] & FLAG_GAP) return '-- ' + rowIds[slot] + ' frames skipped --';
+    // Extended identifiers are marked X as in the monitor; remote frames carry no data
+    var flags = rowFlags[slot];
+    var line = 'ID: 0x' + rowIds[slot].toString(16) + (flags & FLAG_EXTD ? ' X' : '') + ', DLC: ' + rowDlcs[slot];
+    if (flags & FLAG_RTR) return line + ', RTR';
+    line += ', Data:';
+    for (var b = 0; b < Math.min(rowDlcs[slot], 8); b++) line += ' 0x' + hex(rowData[slot * 8 + b], 2);
+    return line;
+}
+function decodeBatch(buffer) {
+    var view = new DataView(buffer);
+    if (view.getUint8(0) !== 0x43 || view.getUint8(1) !== 1) return;
+    var count = view.getUint16(2, true);
+    var gap = view.getUint32(4, true);
+    var bytes = new Uint8Array(buffer);
+    if (gap) appendGap(gap);
+    for (var i = 0, off = 16; i < count; i++, off += 22) {
+        var slot = nextSlot();
+        rowIds[slot] = view.getUint32(off + 8, true);
+        rowFlags[slot] = view.getUint8(off + 12);
+        rowDlcs[slot] = view.getUint8(off + 13);
+        rowData.set(bytes.subarray(off + 14, off + 22), slot * 8);
+    }
+}
+function scheduleRender() {
+    if (!renderPending) {
+        renderPending = true;
+        requestAnimationFrame(renderRows);
+    }
+}
+function renderRows() {
+    renderPending = false;
+    var view = document.getElementById('stream');
+    var list = document.getElementById('can-messages');
+    var count = Math.min(rowTotal, MAX_ROWS);
+    var base = rowTotal - count;
+
+    document.getElementById('stream-empty').style.display = count ? 'none' : '';
+    list.style.height = count * ROW_HEIGHT + 'px';
+    if (follow) {
+        view.scrollTop = view.scrollHeight;
+    } else if (base > shownBase) {
+        // Rows dropped from the top: keep the rows in view where they are
+        view.scrollTop -= (base - shownBase) * ROW_HEIGHT;
+    }
+    shownBase = base;
+
+    var visible = Math.ceil(view.clientHeight / ROW_HEIGHT) + 2 * OVERSCAN;
+    var first = Math.max(0, Math.floor((view.scrollTop - list.offsetTop) / ROW_HEIGHT) - OVERSCAN);
+    while (pool.length < visible) {
+        var div = document.createElement('div');
+        div.row = -1;
+        list.appendChild(div);
+        pool.push(div);
+    }
+    for (var i = 0; i < pool.length; i++) {
+        var row = pool[i];
+        var index = first + i;
+        if (i >= visible || index >= count) {
+            if (row.row !== -1) {
+                row.style.display = 'none';
+                row.row = -1;
+            }
+            continue;
+        }
+        var n = base + index;
+        if (row.row !== n) {
+            var slot = n % MAX_ROWS;
+            row.textContent = formatRow(slot);
+            row.className = rowFlags[slot] & FLAG_GAP && rowTexts[slot] == null ? 'gap' : '';
+            row.style.display = '';
+            row.row = n;
+        }
+        row.style.top = index * ROW_HEIGHT + 'px';
+    }
+}
+function onStreamScroll() {
+    var view = document.getElementById('stream');
+    follow = view.scrollTop + view.clientHeight >= view.scrollHeight - ROW_HEIGHT;
+    scheduleRender();
+}
+function renderMonitor(rows) {
+    rows.sort(function(a, b) { return a[1] - b[1] || a[0] - b[0]; });
+    var html = '';
+    rows.forEach(function(r) {
+        var data = '';
+        for (var b = 0; b < r[2]; b++) {
+            var cls = (r[4] >> b) & 1 ? ' class=chg' : '';
+            data += '<span' + cls + '>' + r[3].substr(2 * b, 2) + '</span> ';
+        }
+        html += '<tr><td>0x' + r[0].toString(16) + (r[1] ? ' X' : '') + '</td><td>' + r[2] +
+                '</td><td>' + data + '</td><td>' + r[5] + '</td><td>' + r[6] + '</td></tr>';
+    });
+    document.getElementById('monitor-rows').innerHTML = html;
+}
+function showView(monitor) {
+    document.getElementById('stream').style.display = monitor ? 'none' : 'block';
+    document.getElementById('monitor-window').style.display = monitor ? 'block' : 'none';
+    clearInterval(monitorTimer);
+    if (monitor) {
+        monitorTimer = setInterval(function() {
+            if (socket && socket.readyState === WebSocket.OPEN) socket.send('get_monitor');
+        }, 250);
+    } else {
+        scheduleRender();
+    }
+}
+function loadSegments() {
+    fetch('/log').then(function(r) { return r.json(); }).then(function(log) {
+        var html = 'Frames lost by logger: ' + log.lost + '<br>';
+        log.segments.forEach(function(s) {
+            var base = '/log?seg=' + s.index + '&fmt=';
+            html += 'Segment ' + s.index + ' (' + s.size + ' bytes' + (s.active ? ', active' : '') + '): ' +
+                    '<a href=\'' + base + 'bin\'>bin</a> ' +
+                    '<a href=\'' + base + 'candump\'>candump</a> ' +
+                    '<a href=\'' + base + 'asc\'>asc</a><br>';
+        });
+        document.getElementById('segments').innerHTML = html;
+    });
+}
+function renderTriggers(list) {
+    var html = '';
+    list.slots.forEach(function(t) {
+        html += 'Slot ' + t.slot + ': ' + t.condition + ' (' + t.state + ', ' + t.frames + ' frames) ';
+        if (t.state === 'done') html += '<a href=\'/trigger?slot=' + t.slot + '\'>candump</a> ';
+        html += '<button onclick=\'clearTrigger(' + t.slot + ')\'>Clear</button><br>';
+    });
+    document.getElementById('triggers').innerHTML = html;
+}
+function triggerRequest(url, body) {
+    fetch(url, { method: body === undefined ? 'GET' : 'POST', body: body }).then(function(r) {
+        if (!r.ok) return r.text().then(function(t) { document.getElementById('triggers').textContent = 'Error: ' + t; });
+        return r.json().then(renderTriggers);
+    });
+}
+function armTrigger() { triggerRequest('/trigger', document.getElementById('trigger').value); }
+function clearTrigger(slot) { triggerRequest('/trigger?clear=' + slot, ''); }
+function renderTx(list) {
+    var html = '';
+    list.periodic.forEach(function(t) {
+        html += 'Slot ' + t.slot + ': ' + t.spec + ' (' + t.sent + ' sent, ' + t.errors + ' errors, period ' +
+                t.period_min_us + '..' + t.period_max_us + ' us, jitter avg ' + t.jitter_avg_us + ' max ' +
+                t.jitter_max_us + ' us) ';
+        html += '<button onclick=\'stopTx(' + t.slot + ')\'>Stop</button><br>';
+    });
+    document.getElementById('tx-list').innerHTML = html;
+}
+function txRequest(url, body) {
+    fetch(url, { method: body === undefined ? 'GET' : 'POST', body: body }).then(function(r) {
+        if (!r.ok) return r.text().then(function(t) { document.getElementById('tx-list').textContent = 'Error: ' + t; });
+        return r.json().then(renderTx);
+    });
+}
+function sendTx() { txRequest('/tx', document.getElementById('tx').value); }
+function stopTx(slot) { txRequest('/tx?stop=' + slot, ''); }
+function renderSignals(rows) {
+    rows.forEach(function(r) { signals[r[0] + '.' + r[1]] = r; });
+    // Names and units come from the uploaded DBC: set as text, never as HTML
+    var body = document.createElement('tbody');
+    body.id = 'signal-rows';
+    Object.keys(signals).sort().forEach(function(k) {
+        var tr = body.insertRow();
+        signals[k].forEach(function(v) { tr.insertCell().textContent = v; });
+    });
+    var old = document.getElementById('signal-rows');
+    old.parentNode.replaceChild(body, old);
+}
+function showDbc(text) {
+    var info = JSON.parse(text);
+    document.getElementById('dbc-status').textContent = info.error ? 'Error: ' + info.error :
+        info.messages ? info.messages + ' messages, ' + info.signals + ' signals' : 'No DBC loaded';
+}
+function uploadDbc() {
+    var file = document.getElementById('dbc-file').files[0];
+    if (!file) return;
+    signals = {};
+    fetch('/dbc', { method: 'POST', body: file }).then(function(r) { return r.text(); }).then(showDbc);
+}
+function applyFilter() {
+    socket.send('filter:' + document.getElementById('filter').value);
+}
+function initWebSocket() {
+    console.log('Trying to open a WebSocket connection...');
+    socket = new WebSocket('ws://' + window.location.host + '/ws');
+    socket.binaryType = 'arraybuffer';
+    socket.onopen = function(event) {
+        console.log('WebSocket connection opened');
+        socket.send('caps:bin');
+        socket.send('get_messages');
+        socket.send('filter?');
+    };
+    socket.onmessage = function(event) {
+        if (event.data instanceof ArrayBuffer) {
+            decodeBatch(event.data);
+        } else if (event.data.startsWith('F:')) {
+            event.data.substring(2).split('<br><br>').forEach(appendText);
+        } else if (event.data.startsWith('D:')) {
+            renderSignals(JSON.parse(event.data.substring(2)));
+            return;
+        } else if (event.data.startsWith('M:')) {
+            renderMonitor(JSON.parse(event.data.substring(2)));
+            return;
+        } else if (event.data.startsWith('filter:')) {
+            var parts = event.data.split(':');
+            document.getElementById('filter-status').textContent = parts[1] === 'ok' ?
+                'Active: ' + (parts[2] || 'all frames') : 'Error: ' + parts[2];
+            if (parts[1] === 'ok') document.getElementById('filter').value = parts[2];
+            return;
+        } else if (event.data.startsWith('H:')) {
+            resetRows();
+            event.data.substring(2).split('<br><br>').forEach(appendText);
+        } else {
+            // caps:, tx:, debug: and other command replies
+            console.log('Reply:', event.data);
+            return;
+        }
+        scheduleRender();
+    };
+    socket.onerror = function(error) {
+        console.error('WebSocket error:', error);
+    };
+    socket.onclose = function(event) {
+        console.log('WebSocket connection closed');
+        setTimeout(initWebSocket, 2000);
+    };
+}
+window.addEventListener('load', function() {
+    document.getElementById('stream').addEventListener('scroll', onStreamScroll, { passive: true });
+    initWebSocket();
+    fetch('/dbc').then(function(r) { return r.text(); }).then(showDbc);
+});
\ No newline at end of file
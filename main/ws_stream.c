@@ -0,0 +1,321 @@
+#include "ws_stream.h"
+#include "can_format.h"
+#include "can_ring.h"
+#include "can_wire.h"
+#include "can_metrics.h"
+#include "can_dbc.h"
+#include "esp_timer.h"
+#include "esp_log.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define TAG "WS_STREAM"
+#define WS_FRAME_TEXT_MAX CAN_FORMAT_MESSAGE_MAX
+#define WS_PUSH_PREFIX "F:"
+#define WS_LINE_SEPARATOR "<br><br>"
+#define WS_DECODED_PREFIX "D:"
+#define WS_DECODED_MAX 4096
+
+typedef struct {
+    bool in_use;
+    bool in_flight;         // A batch is queued on the httpd task and not sent yet
+    bool binary;            // Client negotiated the can_wire.h binary format
+    int fd;
+    can_ring_cursor_t cursor;
+    uint32_t gap;           // Frames skipped since the last batch that was sent
+} ws_client_t;
+
+typedef struct ws_job {
+    int fd;
+    httpd_ws_type_t type;
+    struct ws_job *decoded; // Optional "D:" message sent right after the batch
+    int refs;               // Of a "D:" message: batches it is attached to
+    int64_t oldest_us;      // Reception time of the first frame, 0 for a gap-only batch
+    int64_t queued_us;
+    size_t len;
+    uint8_t payload[];
+} ws_job_t;
+
+static httpd_handle_t ws_server;
+static ws_client_t clients[WS_STREAM_MAX_CLIENTS];
+static SemaphoreHandle_t clients_mutex;
+static can_frame_record_t frames[CONFIG_CAN_WS_MAX_BATCH_FRAMES];
+static can_ring_cursor_t decode_cursor;     // Frames decoded once per tick for all clients
+static char decoded_text[WS_DECODED_MAX];
+
+static ws_client_t *find_client(int fd) {
+    for (int i = 0; i < WS_STREAM_MAX_CLIENTS; i++) {
+        if (clients[i].in_use && clients[i].fd == fd) {
+            return &clients[i];
+        }
+    }
+    return NULL;
+}
+
+esp_err_t ws_stream_add_client(int fd) {
+    esp_err_t ret = ESP_ERR_NO_MEM;
+
+    xSemaphoreTake(clients_mutex, portMAX_DELAY);
+    ws_client_t *client = find_client(fd);
+    for (int i = 0; client == NULL && i < WS_STREAM_MAX_CLIENTS; i++) {
+        if (!clients[i].in_use) {
+            client = &clients[i];
+        }
+    }
+    if (client != NULL) {
+        memset(client, 0, sizeof(ws_client_t));
+        client->in_use = true;
+        client->fd = fd;
+        can_ring_cursor_init(&client->cursor);
+        ret = ESP_OK;
+    }
+    xSemaphoreGive(clients_mutex);
+
+    if (ret != ESP_OK) {
+        ESP_LOGW(TAG, "No free stream slot for socket %d", fd);
+    }
+    return ret;
+}
+
+esp_err_t ws_stream_set_binary(int fd, bool enable) {
+    esp_err_t ret = ESP_ERR_NOT_FOUND;
+
+    xSemaphoreTake(clients_mutex, portMAX_DELAY);
+    ws_client_t *client = find_client(fd);
+    if (client != NULL) {
+        client->binary = enable;
+        ret = ESP_OK;
+    }
+    xSemaphoreGive(clients_mutex);
+    return ret;
+}
+
+void ws_stream_remove_client(int fd) {
+    xSemaphoreTake(clients_mutex, portMAX_DELAY);
+    ws_client_t *client = find_client(fd);
+    if (client != NULL) {
+        client->in_use = false;
+    }
+    xSemaphoreGive(clients_mutex);
+}
+
+// Runs on the httpd task
+static void ws_send_job(void *arg) {
+    ws_job_t *job = (ws_job_t *)arg;
+    int64_t start_us = esp_timer_get_time();
+    httpd_ws_frame_t ws_pkt = {
+        .final = true,
+        .type = job->type,
+        .payload = job->payload,
+        .len = job->len,
+    };
+
+    esp_err_t ret = httpd_ws_send_frame_async(ws_server, job->fd, &ws_pkt);
+    if (ret == ESP_OK && job->decoded != NULL) {
+        ws_pkt.type = job->decoded->type;
+        ws_pkt.payload = job->decoded->payload;
+        ws_pkt.len = job->decoded->len;
+        ret = httpd_ws_send_frame_async(ws_server, job->fd, &ws_pkt);
+        if (ret == ESP_OK) {
+            can_metrics_add(CAN_METRIC_WS_BYTES, job->decoded->len);
+        }
+    }
+    int64_t done_us = esp_timer_get_time();
+    can_metrics_observe(CAN_HIST_WS_QUEUE, start_us - job->queued_us);
+    can_metrics_observe(CAN_HIST_WS_SEND, done_us - start_us);
+    if (ret == ESP_OK) {
+        can_metrics_add(CAN_METRIC_WS_BATCHES, 1);
+        can_metrics_add(CAN_METRIC_WS_BYTES, job->len);
+        if (job->oldest_us != 0) {
+            can_metrics_observe(CAN_HIST_END_TO_END, done_us - job->oldest_us);
+        }
+    } else {
+        can_metrics_add(CAN_METRIC_WS_SEND_ERRORS, 1);
+        ESP_LOGW(TAG, "Push to socket %d failed: %s", job->fd, esp_err_to_name(ret));
+    }
+
+    xSemaphoreTake(clients_mutex, portMAX_DELAY);
+    ws_client_t *client = find_client(job->fd);
+    if (client != NULL) {
+        client->in_flight = false;
+    }
+    if (job->decoded != NULL && --job->decoded->refs == 0) {
+        free(job->decoded);
+    }
+    xSemaphoreGive(clients_mutex);
+    free(job);
+}
+
+static ws_job_t *build_text_batch(const can_frame_record_t *batch, size_t count, uint32_t gap) {
+    size_t capacity = sizeof(WS_PUSH_PREFIX) + 64 + count * (WS_FRAME_TEXT_MAX + sizeof(WS_LINE_SEPARATOR));
+    ws_job_t *job = malloc(sizeof(ws_job_t) + capacity);
+    if (job == NULL) {
+        return NULL;
+    }
+
+    char *start = (char *)job->payload;
+    char *p = start;
+    char *end = start + capacity;
+    p += snprintf(p, end - p, WS_PUSH_PREFIX);
+    if (gap > 0) {
+        p += snprintf(p, end - p, "<i>-- %lu frames skipped --</i>" WS_LINE_SEPARATOR, gap);
+    }
+    for (size_t i = 0; i < count; i++) {
+        p += can_format_message(p, WS_FRAME_TEXT_MAX, &batch[i].msg);
+        memcpy(p, WS_LINE_SEPARATOR, sizeof(WS_LINE_SEPARATOR) - 1);
+        p += sizeof(WS_LINE_SEPARATOR) - 1;
+    }
+    job->type = HTTPD_WS_TYPE_TEXT;
+    job->decoded = NULL;
+    job->len = p - start;
+    return job;
+}
+
+static ws_job_t *build_binary_batch(const can_frame_record_t *batch, size_t count, uint32_t gap) {
+    ws_job_t *job = malloc(sizeof(ws_job_t) + can_wire_batch_size(count));
+    if (job == NULL) {
+        return NULL;
+    }
+    job->type = HTTPD_WS_TYPE_BINARY;
+    job->decoded = NULL;
+    job->len = can_wire_encode_batch(job->payload, batch, count, gap);
+    return job;
+}
+
+// Signal values of the batch when a DBC is loaded, as a "D:" text message
+static ws_job_t *build_decoded(const can_frame_record_t *batch, size_t count) {
+    size_t prefix = sizeof(WS_DECODED_PREFIX) - 1;
+    size_t len = can_dbc_format_batch_json(batch, count, decoded_text + prefix, sizeof(decoded_text) - prefix);
+    if (len == 0) {
+        return NULL;
+    }
+
+    ws_job_t *job = malloc(sizeof(ws_job_t) + prefix + len);
+    if (job == NULL) {
+        return NULL;
+    }
+    memcpy(job->payload, WS_DECODED_PREFIX, prefix);
+    memcpy(job->payload + prefix, decoded_text + prefix, len);
+    job->type = HTTPD_WS_TYPE_TEXT;
+    job->decoded = NULL;
+    job->refs = 0;
+    job->len = prefix + len;
+    return job;
+}
+
+// Decodes the frames received since the previous tick, newest first when
+// there are more than a batch, into one "D:" message shared by all clients.
+static ws_job_t *decode_new_frames(void) {
+    uint32_t lag = can_ring_head() - decode_cursor.next_seq;
+    if (lag > CONFIG_CAN_WS_MAX_BATCH_FRAMES) {
+        decode_cursor.next_seq += lag - CONFIG_CAN_WS_MAX_BATCH_FRAMES;
+    }
+
+    uint32_t lost;
+    size_t count = can_ring_read(&decode_cursor, frames, CONFIG_CAN_WS_MAX_BATCH_FRAMES, &lost);
+    return count > 0 ? build_decoded(frames, count) : NULL;
+}
+
+static void push_to_client(ws_client_t *client, ws_job_t *decoded) {
+    if (httpd_ws_get_fd_info(ws_server, client->fd) != HTTPD_WS_CLIENT_WEBSOCKET) {
+        client->in_use = false;
+        return;
+    }
+    if (client->in_flight) {
+        // Previous batch still queued: let this client lag, it is caught up below
+        return;
+    }
+
+    // A client that fell too far behind resumes from the newest frames.
+    uint32_t lag = can_ring_head() - client->cursor.next_seq;
+    if (lag > CONFIG_CAN_WS_MAX_BATCH_FRAMES) {
+        uint32_t skip = lag - CONFIG_CAN_WS_MAX_BATCH_FRAMES;
+        client->cursor.next_seq += skip;
+        client->cursor.dropped += skip;
+        client->gap += skip;
+        can_metrics_add(CAN_METRIC_WS_SKIPPED, skip);
+    }
+
+    uint32_t lost;
+    size_t count = can_ring_read(&client->cursor, frames, CONFIG_CAN_WS_MAX_BATCH_FRAMES, &lost);
+    client->gap += lost;
+    if (count == 0 && client->gap == 0) {
+        return;
+    }
+
+    ws_job_t *job = client->binary ? build_binary_batch(frames, count, client->gap)
+                                   : build_text_batch(frames, count, client->gap);
+    if (job == NULL) {
+        client->gap += count;
+        can_metrics_add(CAN_METRIC_WS_QUEUE_FAILED, 1);
+        return;
+    }
+    job->fd = client->fd;
+    job->queued_us = esp_timer_get_time();
+    job->oldest_us = count > 0 ? frames[0].timestamp_us : 0;
+    if (count > 0) {
+        can_metrics_observe(CAN_HIST_BATCH_WAIT, job->queued_us - job->oldest_us);
+        job->decoded = decoded;
+    }
+
+    if (httpd_queue_work(ws_server, ws_send_job, job) != ESP_OK) {
+        client->gap += count;
+        can_metrics_add(CAN_METRIC_WS_QUEUE_FAILED, 1);
+        free(job);
+        return;
+    }
+    if (job->decoded != NULL) {
+        job->decoded->refs++;
+    }
+    client->gap = 0;
+    client->in_flight = true;
+}
+
+static void ws_broadcast_task(void *arg) {
+    TickType_t last_wake = xTaskGetTickCount();
+    TickType_t period = pdMS_TO_TICKS(CONFIG_CAN_WS_BATCH_INTERVAL_MS);
+    if (period == 0) {
+        period = 1;
+    }
+
+    while (1) {
+        vTaskDelayUntil(&last_wake, period);
+
+        xSemaphoreTake(clients_mutex, portMAX_DELAY);
+        bool any_client = false;
+        for (int i = 0; i < WS_STREAM_MAX_CLIENTS; i++) {
+            any_client |= clients[i].in_use;
+        }
+        ws_job_t *decoded = any_client ? decode_new_frames() : NULL;
+        for (int i = 0; i < WS_STREAM_MAX_CLIENTS; i++) {
+            if (clients[i].in_use) {
+                push_to_client(&clients[i], decoded);
+            }
+        }
+        // Sends release it under clients_mutex, so no reference yet means none will come
+        if (decoded != NULL && decoded->refs == 0) {
+            free(decoded);
+        }
+        xSemaphoreGive(clients_mutex);
+    }
+}
+
+esp_err_t ws_stream_start(httpd_handle_t server) {
+    ws_server = server;
+    can_ring_cursor_init(&decode_cursor);
+    clients_mutex = xSemaphoreCreateMutex();
+    if (clients_mutex == NULL) {
+        ESP_LOGE(TAG, "Failed to create clients mutex");
+        return ESP_ERR_NO_MEM;
+    }
+
+    if (xTaskCreate(ws_broadcast_task, "ws_broadcast_task", 4096, NULL, 4, NULL) != pdPASS) {
+        ESP_LOGE(TAG, "Failed to create broadcaster task");
+        return ESP_ERR_NO_MEM;
+    }
+    return ESP_OK;
+}
\ No newline at end of file
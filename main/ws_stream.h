@@ -0,0 +1,24 @@
+// ws_stream.h
+#ifndef WS_STREAM_H
+#define WS_STREAM_H
+
+#include <stdbool.h>
+#include "esp_err.h"
+#include "esp_http_server.h"
+
+// One slot per socket the HTTP server may keep open.
+#define WS_STREAM_MAX_CLIENTS 4
+
+// Starts the broadcaster task that pushes new frames to the registered clients.
+esp_err_t ws_stream_start(httpd_handle_t server);
+
+// Registers a WebSocket session. Only frames received from now on are pushed.
+esp_err_t ws_stream_add_client(int fd);
+
+// Switches a session between the text batches and the binary format of can_wire.h.
+esp_err_t ws_stream_set_binary(int fd, bool enable);
+
+// Forgets a session; safe to call for descriptors that were never added.
+void ws_stream_remove_client(int fd);
+
+#endif // WS_STREAM_H
\ No newline at end of file